@@ -3,6 +3,8 @@
  * Connects to an Intel RealSense D435, reads left IR, right IR, depth, and
  * color streams, and displays them in five ViewPortal viewports.
  * Viewport 4 shows a snapshot of the current color frame when 's' is pressed.
+ * IR and color frames are handed to ViewPortal without copying: each rs2::frame
+ * reference is kept until the display thread has uploaded it.
  */
 
 #include "viewportal.h"
@@ -10,6 +12,7 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <vector>
+#include <memory>
 #include <cstring>
 
 namespace {
@@ -18,26 +21,46 @@ using namespace viewportal;
 
 constexpr int kWidth = 640;
 constexpr int kHeight = 480;
-constexpr float kDepthMaxMeters = 1.50f;
+// Depth is quantised to 8 bits over [0, kDepthMaxMeters], about 2.4 cm per level
+// (four times coarser than clipping at 1.5 m, but nothing is cut off); the
+// ColoredDepth viewport's auto range then stretches the colormap over the scene.
+constexpr float kDepthMaxMeters = 6.0f;
 
 struct RealsenseCapture {
-    rs2::frameset frameset;
     std::vector<unsigned char> depth_buffer;
 
-    FrameData left_ir;
-    FrameData right_ir;
+    rs2::video_frame left_ir{rs2::frame()};
+    rs2::video_frame right_ir{rs2::frame()};
+    rs2::video_frame color{rs2::frame()};
     FrameData depth;
-    FrameData color_rgb;
 
     RealsenseCapture() {
         depth_buffer.resize(kWidth * kHeight);
-        left_ir.data = nullptr;
-        right_ir.data = nullptr;
         depth.data = nullptr;
-        color_rgb.data = nullptr;
     }
 };
 
+/**
+ * Describe a RealSense video frame in place (no copy).
+ */
+FrameData describeFrame(const rs2::video_frame& frame, ImageFormat format) {
+    FrameData fd;
+    fd.width = frame.get_width();
+    fd.height = frame.get_height();
+    fd.format = format;
+    fd.data = frame.get_data();
+    fd.row_stride = frame.get_stride_in_bytes();
+    return fd;
+}
+
+/**
+ * Submit a frame zero-copy: ViewPortal holds a reference to the rs2::frame until
+ * the frame is uploaded, then lets librealsense recycle it.
+ */
+void submitFrame(ViewPortal& portal, size_t index, const rs2::video_frame& frame, ImageFormat format) {
+    portal.updateFrame(index, describeFrame(frame, format), std::make_shared<rs2::frame>(frame));
+}
+
 bool initRealsense(rs2::pipeline& pipe) {
     rs2::config cfg;
     cfg.enable_stream(RS2_STREAM_DEPTH, kWidth, kHeight, RS2_FORMAT_Z16, 30);
@@ -55,31 +78,18 @@ bool initRealsense(rs2::pipeline& pipe) {
 }
 
 bool captureFrames(rs2::pipeline& pipe, RealsenseCapture& out) {
+    rs2::frameset frameset;
     try {
-        out.frameset = pipe.wait_for_frames();
+        frameset = pipe.wait_for_frames();
     } catch (const rs2::error&) {
         return false;
     }
 
-    rs2::video_frame ir_left = out.frameset.get_infrared_frame(1);
-    if (ir_left) {
-        out.left_ir.width = ir_left.get_width();
-        out.left_ir.height = ir_left.get_height();
-        out.left_ir.format = ImageFormat::Luminance8;
-        out.left_ir.data = ir_left.get_data();
-        out.left_ir.row_stride = 0;
-    }
-
-    rs2::video_frame ir_right = out.frameset.get_infrared_frame(2);
-    if (ir_right) {
-        out.right_ir.width = ir_right.get_width();
-        out.right_ir.height = ir_right.get_height();
-        out.right_ir.format = ImageFormat::Luminance8;
-        out.right_ir.data = ir_right.get_data();
-        out.right_ir.row_stride = 0;
-    }
+    out.left_ir = frameset.get_infrared_frame(1);
+    out.right_ir = frameset.get_infrared_frame(2);
+    out.color = frameset.get_color_frame();
 
-    rs2::depth_frame depth = out.frameset.get_depth_frame();
+    rs2::depth_frame depth = frameset.get_depth_frame();
     if (depth) {
         const int dw = depth.get_width();
         const int dh = depth.get_height();
@@ -103,17 +113,6 @@ bool captureFrames(rs2::pipeline& pipe, RealsenseCapture& out) {
         out.depth.row_stride = 0;
     }
 
-    rs2::video_frame color_frame = out.frameset.get_color_frame();
-    if (color_frame) {
-        const int cw = color_frame.get_width();
-        const int ch = color_frame.get_height();
-        out.color_rgb.width = cw;
-        out.color_rgb.height = ch;
-        out.color_rgb.format = ImageFormat::RGB8;
-        out.color_rgb.row_stride = 0;
-        out.color_rgb.data = color_frame.get_data();
-    }
-
     return true;
 }
 
@@ -140,21 +139,24 @@ int main(int /*argc*/, char* /*argv*/[])
     params.window_title = "ViewPortal RealSense (Example)";
     ViewPortal portal(1, 5, types, params);
     portal.setKeysToWatch({' '});
+    ColormapParams depth_colormap;
+    depth_colormap.auto_range = true;
+    portal.setColormap(2, depth_colormap);
 
     RealsenseCapture capture;
     while (!portal.shouldQuit()) {
         if (!captureFrames(pipe, capture))
             continue;
-        if (capture.left_ir.data)
-            portal.updateFrame(0, capture.left_ir);
-        if (capture.right_ir.data)
-            portal.updateFrame(1, capture.right_ir);
+        if (capture.left_ir)
+            submitFrame(portal, 0, capture.left_ir, ImageFormat::Luminance8);
+        if (capture.right_ir)
+            submitFrame(portal, 1, capture.right_ir, ImageFormat::Luminance8);
         if (capture.depth.data)
-            portal.updateFrame(2, capture.depth);
-        if (capture.color_rgb.data)
-            portal.updateFrame(3, capture.color_rgb);
-        if (portal.checkKey('s') && capture.color_rgb.data)
-            portal.updateFrame(4, capture.color_rgb);
+            portal.updateFrame(2, capture.depth);  // converted on the CPU; copied
+        if (capture.color)
+            submitFrame(portal, 3, capture.color, ImageFormat::RGB8);
+        if (portal.checkKey('s') && capture.color)
+            submitFrame(portal, 4, capture.color, ImageFormat::RGB8);
     }
 
     pipe.stop();
@@ -0,0 +1,59 @@
+/*
+ * Writes a moving test pattern into a shared-memory frame ring at 30 fps.
+ * Start shm_viewer in another terminal; either process can be stopped and
+ * restarted at any time.
+ *
+ * Usage: shm_producer [ring_name]
+ */
+
+#include "viewportal_shm.h"
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+volatile std::sig_atomic_t g_stop = 0;
+void onSignal(int) { g_stop = 1; }
+}
+
+int main(int argc, char* argv[])
+{
+    using namespace viewportal;
+
+    const std::string name = argc > 1 ? argv[1] : "viewportal_demo";
+    const int width = 640, height = 480;
+
+    ShmRingParams params;
+    params.slot_bytes = static_cast<size_t>(width) * height * 3;
+    ShmFrameProducer producer;
+    std::string error;
+    if (!producer.open(name, params, &error)) {
+        std::cerr << "shm_producer: " << error << std::endl;
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int n = 0; !g_stop; ++n) {
+        // Render straight into the ring slot: no intermediate buffer
+        auto* px = static_cast<std::uint8_t*>(producer.beginFrame(width, height, ImageFormat::RGB8));
+        if (px) {
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x, px += 3) {
+                    px[0] = static_cast<std::uint8_t>(x + n * 4);
+                    px[1] = static_cast<std::uint8_t>(y + n * 2);
+                    px[2] = static_cast<std::uint8_t>((x ^ y) + n);
+                }
+            }
+            const auto now = std::chrono::steady_clock::now();
+            producer.commitFrame(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count()));
+        }
+        std::this_thread::sleep_until(start + std::chrono::milliseconds(33) * (n + 1));
+    }
+    return 0;
+}
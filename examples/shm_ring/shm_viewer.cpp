@@ -0,0 +1,32 @@
+/*
+ * Shows the frames of a shared-memory ring written by shm_producer (or any
+ * ShmFrameProducer). The viewer can start before the producer and keeps
+ * running when the producer exits or restarts.
+ *
+ * Usage: shm_viewer [ring_name]
+ */
+
+#include "viewportal.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char* argv[])
+{
+    using namespace viewportal;
+
+    const std::string name = argc > 1 ? argv[1] : "viewportal_demo";
+
+    ViewPortalParams params;
+    params.window_title = "ViewPortal Shared-Memory Viewer";
+    ViewPortal portal(1, 1, {ViewportType::RGB8}, params);
+    if (!portal.attachSharedMemory(0, name)) {
+        std::cerr << "shm_viewer: shared-memory rings are not available on this platform" << std::endl;
+        return 1;
+    }
+
+    while (!portal.shouldQuit())
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    return 0;
+}
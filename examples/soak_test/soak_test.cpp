@@ -0,0 +1,361 @@
+/*
+ * Load and soak test: N synthetic streams at a given resolution, format and
+ * rate feed one ViewPortal for a set duration. Reports ingest throughput,
+ * displayed FPS, replaced and dropped frames, publish-to-display latency
+ * percentiles, CPU per thread and RSS growth, and writes them as JSON for
+ * sizing hardware and comparing ViewPortal versions. CPU and RSS are read
+ * from /proc (Linux).
+ *
+ * Usage: soak_test [--streams 16] [--width 1920] [--height 1080] [--format rgb8]
+ *                  [--rate 60] [--duration 60] [--warmup 5] [--policy latest]
+ *                  [--pool-threads 0] [--gallery] [--headless] [--output soak_report.json]
+ * format: rgb8, rgba8, g8, float32, float16 or flow; policy: latest, block or drop.
+ */
+
+#include "viewportal.h"
+#include "viewportal_source.h"
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace viewportal;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int streams = 16;
+    int width = 1920;
+    int height = 1080;
+    std::string format = "rgb8";
+    double rate = 60.0;
+    double duration_s = 60.0;
+    double warmup_s = 5.0;
+    std::string policy = "latest";
+    int pool_threads = 0;
+    bool gallery = false;
+    bool headless = false;
+    std::string output = "soak_report.json";
+};
+
+bool parseOptions(int argc, char* argv[], Options& o) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--gallery") o.gallery = true;
+        else if (arg == "--headless") o.headless = true;
+        else if (arg == "--streams" && has_value) o.streams = std::atoi(argv[++i]);
+        else if (arg == "--width" && has_value) o.width = std::atoi(argv[++i]);
+        else if (arg == "--height" && has_value) o.height = std::atoi(argv[++i]);
+        else if (arg == "--format" && has_value) o.format = argv[++i];
+        else if (arg == "--rate" && has_value) o.rate = std::atof(argv[++i]);
+        else if (arg == "--duration" && has_value) o.duration_s = std::atof(argv[++i]);
+        else if (arg == "--warmup" && has_value) o.warmup_s = std::atof(argv[++i]);
+        else if (arg == "--policy" && has_value) o.policy = argv[++i];
+        else if (arg == "--pool-threads" && has_value) o.pool_threads = std::atoi(argv[++i]);
+        else if (arg == "--output" && has_value) o.output = argv[++i];
+        else return false;
+    }
+    return o.streams > 0 && o.width > 0 && o.height > 0 && o.rate > 0.0 && o.duration_s > 0.0;
+}
+
+bool parseFormat(const std::string& name, ImageFormat& format, ViewportType& type) {
+    if (name == "rgb8") { format = ImageFormat::RGB8; type = ViewportType::RGB8; }
+    else if (name == "rgba8") { format = ImageFormat::RGBA8; type = ViewportType::RGB8; }
+    else if (name == "g8") { format = ImageFormat::Luminance8; type = ViewportType::G8; }
+    else if (name == "float32") { format = ImageFormat::Float32; type = ViewportType::ColoredDepth; }
+    else if (name == "float16") { format = ImageFormat::Float16; type = ViewportType::ColoredDepth; }
+    else if (name == "flow") { format = ImageFormat::Float32x2; type = ViewportType::Flow; }
+    else return false;
+    return true;
+}
+
+int bytesPerPixel(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::RGB8: return 3;
+        case ImageFormat::RGBA8: return 4;
+        case ImageFormat::Luminance8: return 1;
+        case ImageFormat::Float32: return 4;
+        case ImageFormat::Float16: return 2;
+        case ImageFormat::Float32x2: return 8;
+    }
+    return 3;
+}
+
+/** Resident set size in MiB, 0 where /proc is missing. */
+double readRssMb() {
+    std::ifstream f("/proc/self/status");
+    std::string line;
+    while (std::getline(f, line)) {
+        if (line.compare(0, 6, "VmRSS:") == 0) return std::atof(line.c_str() + 6) / 1024.0;
+    }
+    return 0.0;
+}
+
+struct ThreadCpu {
+    std::string name;
+    double cpu_s = 0.0;  // user + system
+};
+
+/** CPU time of each thread of this process, by thread id. */
+std::map<long, ThreadCpu> readThreadCpu() {
+    std::map<long, ThreadCpu> threads;
+    const double ticks = static_cast<double>(sysconf(_SC_CLK_TCK));
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return threads;
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        const std::string base = std::string("/proc/self/task/") + entry->d_name;
+        std::ifstream stat(base + "/stat");
+        std::string content;
+        std::getline(stat, content);
+        // Fields after the parenthesized name; utime and stime are the 12th and 13th
+        const size_t close = content.rfind(')');
+        if (close == std::string::npos) continue;
+        std::istringstream fields(content.substr(close + 2));
+        std::string field;
+        double utime = 0.0, stime = 0.0;
+        for (int i = 0; i < 13 && fields >> field; ++i) {
+            if (i == 11) utime = std::atof(field.c_str());
+            if (i == 12) stime = std::atof(field.c_str());
+        }
+        ThreadCpu& t = threads[std::atol(entry->d_name)];
+        std::ifstream comm(base + "/comm");
+        std::getline(comm, t.name);
+        t.cpu_s = (utime + stime) / ticks;
+    }
+    closedir(dir);
+    return threads;
+}
+
+struct Snapshot {
+    Clock::time_point time;
+    DisplayStats display;
+    std::vector<SourceStats> sources;
+    std::map<long, ThreadCpu> threads;
+};
+
+Snapshot takeSnapshot(ViewPortal& portal, SourceManager& sources, const std::vector<int>& ids, bool reset_latency) {
+    Snapshot s;
+    s.time = Clock::now();
+    portal.displayStats(s.display, reset_latency);
+    for (int id : ids) {
+        SourceStats stats;
+        sources.sourceStats(id, stats);
+        s.sources.push_back(stats);
+    }
+    s.threads = readThreadCpu();
+    return s;
+}
+
+/** Least-squares slope of RSS over time, in MiB per minute. */
+double rssSlopeMbPerMin(const std::vector<std::pair<double, double>>& samples) {
+    if (samples.size() < 2) return 0.0;
+    double st = 0.0, sr = 0.0;
+    for (const auto& p : samples) {
+        st += p.first;
+        sr += p.second;
+    }
+    const double n = static_cast<double>(samples.size());
+    const double mt = st / n, mr = sr / n;
+    double num = 0.0, den = 0.0;
+    for (const auto& p : samples) {
+        num += (p.first - mt) * (p.second - mr);
+        den += (p.first - mt) * (p.first - mt);
+    }
+    return den > 0.0 ? num / den * 60.0 : 0.0;
+}
+
+std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20) out += c;
+    }
+    return out + "\"";
+}
+
+void writeLatency(std::ostream& out, const LatencyStats& l) {
+    out << "{\"count\": " << l.count << ", \"p50_ms\": " << l.p50_ms << ", \"p90_ms\": " << l.p90_ms
+        << ", \"p99_ms\": " << l.p99_ms << ", \"max_ms\": " << l.max_ms << "}";
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    ImageFormat format = ImageFormat::RGB8;
+    ViewportType type = ViewportType::RGB8;
+    if (!parseOptions(argc, argv, opt) || !parseFormat(opt.format, format, type)) {
+        std::cerr << "usage: soak_test [--streams N] [--width W] [--height H] [--format rgb8|rgba8|g8|float32|float16|flow]\n"
+                     "                 [--rate HZ] [--duration S] [--warmup S] [--policy latest|block|drop]\n"
+                     "                 [--pool-threads N] [--gallery] [--headless] [--output FILE]" << std::endl;
+        return 1;
+    }
+    DeliveryParams delivery;
+    if (opt.policy == "block") delivery.policy = DeliveryPolicy::BlockWhenFull;
+    else if (opt.policy == "drop") delivery.policy = DeliveryPolicy::DropOldest;
+    else if (opt.policy != "latest") {
+        std::cerr << "soak_test: unknown policy " << opt.policy << std::endl;
+        return 1;
+    }
+
+    const int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(opt.streams))));
+    const int rows = (opt.streams + cols - 1) / cols;
+    std::vector<ViewportType> types(static_cast<size_t>(opt.streams), type);
+
+    ViewPortalParams params;
+    params.window_title = "ViewPortal Soak Test";
+    params.gallery_mode = opt.gallery;
+    params.headless = opt.headless;
+    ViewportSpec spec;
+    spec.width = opt.width;
+    spec.height = opt.height;
+    spec.format = format;
+    if (type == ViewportType::ColoredDepth) {
+        ColormapParams colormap;
+        colormap.auto_range = true;  // the float patterns are not in the default 0-255 range
+        spec.colormap = colormap;
+    }
+    params.viewport_specs.assign(types.size(), spec);
+    ViewPortal portal(rows, cols, types, params);
+
+    SourceManagerParams source_params;
+    source_params.pool_threads = opt.pool_threads;
+    SourceManager sources(portal, source_params);
+    std::vector<int> ids;
+    const TestPattern patterns[] = {TestPattern::ColorBars, TestPattern::Gradient, TestPattern::Checker};
+    for (int i = 0; i < opt.streams; ++i) {
+        portal.setDeliveryPolicy(static_cast<size_t>(i), delivery);
+        TestPatternParams pattern;
+        pattern.width = opt.width;
+        pattern.height = opt.height;
+        pattern.format = format;
+        pattern.pattern = patterns[i % 3];
+        pattern.frame_rate = opt.rate;
+        ids.push_back(sources.addSource(createTestPatternSource(pattern), static_cast<size_t>(i)));
+    }
+
+    std::cout << "soak_test: " << opt.streams << " x " << opt.width << "x" << opt.height << " " << opt.format
+              << " at " << opt.rate << " Hz, " << opt.duration_s << " s after " << opt.warmup_s << " s warm-up"
+              << std::endl;
+    const auto warmup_end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                               std::chrono::duration<double>(opt.warmup_s));
+    while (Clock::now() < warmup_end && !portal.shouldQuit())
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    const Snapshot start = takeSnapshot(portal, sources, ids, true);
+    const double rss_start = readRssMb();
+    double rss_peak = rss_start;
+    std::vector<std::pair<double, double>> rss_samples{{0.0, rss_start}};
+    const auto end = start.time + std::chrono::duration_cast<Clock::duration>(
+                                      std::chrono::duration<double>(opt.duration_s));
+    auto next_sample = start.time;
+    while (Clock::now() < end && !portal.shouldQuit()) {
+        next_sample += std::chrono::seconds(1);
+        std::this_thread::sleep_until(std::min(next_sample, end));
+        const double t = std::chrono::duration<double>(Clock::now() - start.time).count();
+        const double rss = readRssMb();
+        rss_peak = std::max(rss_peak, rss);
+        rss_samples.emplace_back(t, rss);
+        std::cout << "  " << std::fixed << std::setprecision(0) << t << " s  rss " << std::setprecision(1) << rss
+                  << " MiB" << std::endl;
+    }
+    const Snapshot stop = takeSnapshot(portal, sources, ids, false);
+    sources.stop();
+
+    // Ingest and display
+    const double seconds = std::chrono::duration<double>(stop.time - start.time).count();
+    const double frame_mb = static_cast<double>(opt.width) * opt.height * bytesPerPixel(format) / (1024.0 * 1024.0);
+    std::uint64_t grabbed = 0, grabs = 0, published = 0, displayed = 0, replaced = 0, dropped = 0;
+    double grab_total_ms = 0.0;
+    double min_display_fps = -1.0;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        grabbed += stop.sources[i].frames - start.sources[i].frames;
+        grabs += stop.sources[i].grabs - start.sources[i].grabs;
+        grab_total_ms += stop.sources[i].grab_total_ms - start.sources[i].grab_total_ms;
+        const ViewportStats& a = start.display.viewports[i];
+        const ViewportStats& b = stop.display.viewports[i];
+        published += b.published - a.published;
+        displayed += b.displayed - a.displayed;
+        replaced += b.replaced - a.replaced;
+        dropped += b.dropped - a.dropped;
+        const double fps = static_cast<double>(b.displayed - a.displayed) / seconds;
+        min_display_fps = min_display_fps < 0.0 ? fps : std::min(min_display_fps, fps);
+    }
+    const double offered = static_cast<double>(grabbed);
+    const double grab_ms = grabs > 0 ? grab_total_ms / static_cast<double>(grabs) : 0.0;  // over the window only
+
+    std::ofstream out(opt.output);
+    out << std::setprecision(6);
+    out << "{\n";
+    out << "  \"config\": {\"streams\": " << opt.streams << ", \"width\": " << opt.width << ", \"height\": "
+        << opt.height << ", \"format\": " << jsonString(opt.format) << ", \"rate_hz\": " << opt.rate
+        << ", \"duration_s\": " << seconds << ", \"warmup_s\": " << opt.warmup_s
+        << ", \"policy\": " << jsonString(opt.policy) << ", \"gallery\": " << (opt.gallery ? "true" : "false")
+        << ", \"headless\": " << (opt.headless ? "true" : "false") << "},\n";
+    out << "  \"ingest\": {\"frames\": " << grabbed << ", \"fps\": " << offered / seconds
+        << ", \"mb_per_s\": " << offered * frame_mb / seconds << ", \"mean_grab_ms\": " << grab_ms << "},\n";
+    out << "  \"display\": {\"steps_per_s\": "
+        << static_cast<double>(stop.display.steps - start.display.steps) / seconds
+        << ", \"frames_per_s\": " << static_cast<double>(displayed) / seconds
+        << ", \"min_viewport_fps\": " << std::max(0.0, min_display_fps) << "},\n";
+    out << "  \"drops\": {\"published\": " << published << ", \"displayed\": " << displayed
+        << ", \"replaced\": " << replaced << ", \"dropped\": " << dropped
+        << ", \"replaced_rate\": " << (offered > 0 ? static_cast<double>(replaced) / offered : 0.0)
+        << ", \"dropped_rate\": " << (offered > 0 ? static_cast<double>(dropped) / offered : 0.0) << "},\n";
+    out << "  \"latency\": ";
+    writeLatency(out, stop.display.latency);
+    out << ",\n  \"viewports\": [";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const ViewportStats& a = start.display.viewports[i];
+        const ViewportStats& b = stop.display.viewports[i];
+        out << (i ? "," : "") << "\n    {\"index\": " << i
+            << ", \"displayed_fps\": " << static_cast<double>(b.displayed - a.displayed) / seconds
+            << ", \"replaced\": " << b.replaced - a.replaced << ", \"dropped\": " << b.dropped - a.dropped
+            << ", \"latency\": ";
+        writeLatency(out, b.latency);
+        out << "}";
+    }
+    out << "\n  ],\n  \"threads\": [";
+    bool first = true;
+    for (const auto& kv : stop.threads) {
+        auto it = start.threads.find(kv.first);
+        const double cpu_s = kv.second.cpu_s - (it != start.threads.end() ? it->second.cpu_s : 0.0);
+        out << (first ? "" : ",") << "\n    {\"tid\": " << kv.first << ", \"name\": " << jsonString(kv.second.name)
+            << ", \"cpu_percent\": " << 100.0 * cpu_s / seconds << "}";
+        first = false;
+    }
+    const FrameMemoryStats memory = frameMemoryStats();
+    const double rss_end = rss_samples.back().second;
+    out << "\n  ],\n  \"memory\": {\"rss_start_mb\": " << rss_start << ", \"rss_end_mb\": " << rss_end
+        << ", \"rss_peak_mb\": " << rss_peak << ", \"rss_growth_mb\": " << rss_end - rss_start
+        << ", \"rss_slope_mb_per_min\": " << rssSlopeMbPerMin(rss_samples)
+        << ", \"frame_pool_in_use_mb\": " << memory.in_use_bytes / (1024.0 * 1024.0)
+        << ", \"frame_pool_cached_mb\": " << memory.cached_bytes / (1024.0 * 1024.0) << "}\n";
+    out << "}\n";
+    out.close();
+
+    std::cout << std::setprecision(1)
+              << "ingest " << offered / seconds << " fps (" << offered * frame_mb / seconds << " MiB/s), displayed "
+              << static_cast<double>(displayed) / seconds << " fps, replaced "
+              << (offered > 0 ? 100.0 * static_cast<double>(replaced) / offered : 0.0) << "%, dropped "
+              << (offered > 0 ? 100.0 * static_cast<double>(dropped) / offered : 0.0) << "%, latency p50/p99 "
+              << std::setprecision(2) << stop.display.latency.p50_ms << "/" << stop.display.latency.p99_ms
+              << " ms, rss +" << std::setprecision(1) << rss_end - rss_start << " MiB" << std::endl;
+    std::cout << "report written to " << opt.output << std::endl;
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Remote viewer for a ViewPortal window that called startStreaming().
+ * Connects to the server, rebuilds its grid locally and shows the received
+ * frames. Non-image cells (Reconstruction, Plot, Histogram, Compare) are not streamed and stay blank.
+ *
+ * Usage: stream_viewer [tcp:HOST:PORT | unix:PATH] [--composite]
+ */
+
+#include "viewportal.h"
+#include "viewportal_stream.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    using namespace viewportal;
+
+    std::string address = "tcp:127.0.0.1:7070";
+    bool composite = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--composite")
+            composite = true;
+        else
+            address = arg;
+    }
+
+    StreamClient client;
+    std::string error;
+    if (!client.connect(address, &error)) {
+        std::cerr << "stream_viewer: " << error << std::endl;
+        return 1;
+    }
+
+    // Mirror the remote grid, or a single cell for the composite window
+    int rows = 1, cols = 1;
+    std::vector<ViewportType> types = {ViewportType::RGB8};
+    if (!composite && !client.types().empty()) {
+        rows = client.rows();
+        cols = client.cols();
+        types = client.types();
+        if (static_cast<size_t>(rows * cols) != types.size()) {
+            rows = 1;
+            cols = static_cast<int>(types.size());
+        }
+        for (ViewportType& t : types) {
+            if (t == ViewportType::Reconstruction || t == ViewportType::Plot || t == ViewportType::Histogram ||
+                t == ViewportType::Compare)
+                t = ViewportType::RGB8;  // placeholder cell
+        }
+    }
+
+    ViewPortalParams params;
+    params.window_title = "ViewPortal Stream Viewer";
+    ViewPortal portal(rows, cols, types, params);
+
+    // Receive on a separate thread; ViewPortal copies each frame on updateFrame()
+    std::atomic<bool> connected{true};
+    std::thread receiver([&]() {
+        int viewport = 0;
+        FrameData frame;
+        while (client.receive(viewport, frame)) {
+            if (composite && viewport == -1)
+                portal.updateFrame(0, frame);
+            else if (!composite && viewport >= 0)
+                portal.updateFrame(static_cast<size_t>(viewport), frame);
+        }
+        connected = false;
+    });
+
+    while (!portal.shouldQuit() && connected)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    client.interrupt();
+    receiver.join();
+    if (!connected)
+        std::cerr << "stream_viewer: connection closed" << std::endl;
+    return 0;
+}
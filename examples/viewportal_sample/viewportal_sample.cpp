@@ -1,17 +1,19 @@
 /*
  * Standalone ViewPortal sample using the ViewPortal library (FetchContent).
  * 2x2 grid with RGB8, G8, Reconstruction, and Plot.
- * Frame capture (OpenCV camera or synthetic) is separated into capture functions;
- * the GUI just receives the captured frame data.
+ * Frames come from FrameSources run by a SourceManager: an OpenCV camera on its
+ * own thread (or a test pattern without a camera) and a synthetic depth pattern,
+ * so capture never runs on the main thread.
  */
 
 #include "viewportal.h"
+#include "viewportal_source.h"
 #include <opencv2/opencv.hpp>
-#include <vector>
-#include <cstdlib>
-#include <cmath>
+#include <chrono>
 #include <iostream>
-#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
 
 namespace {
 
@@ -22,65 +24,43 @@ constexpr int kColorHeight = 240;
 constexpr int kDepthWidth = 320;
 constexpr int kDepthHeight = 240;
 
-struct ViewportalCapture {
-    std::vector<unsigned char> color_buffer;
-    std::vector<unsigned char> depth_buffer;
-
-    FrameData color_rgb;
-    FrameData depth_g8;
+/**
+ * OpenCV camera as a FrameSource. grab() blocks until the camera delivers a
+ * frame, so the source runs on a dedicated thread.
+ */
+class CameraSource : public FrameSource {
+public:
+    explicit CameraSource(std::unique_ptr<cv::VideoCapture> cap) : cap_(std::move(cap)) {}
 
-    ViewportalCapture() {
-        color_buffer.resize(3 * kColorWidth * kColorHeight);
-        depth_buffer.resize(kDepthWidth * kDepthHeight);
+    GrabResult grab(SourceFrame& out) override {
+        cv::Mat frame;
+        if (!cap_->read(frame)) return GrabResult::Retry;
+        cv::Mat rgb;
+        cv::cvtColor(frame, rgb, cv::COLOR_BGR2RGB);
+        auto resized = std::make_shared<cv::Mat>();
+        cv::resize(rgb, *resized, cv::Size(kColorWidth, kColorHeight));
+        out.frame.width = resized->cols;
+        out.frame.height = resized->rows;
+        out.frame.format = ImageFormat::RGB8;
+        out.frame.data = resized->data;
+        out.frame.row_stride = static_cast<int>(resized->step);
+        out.owner = std::move(resized);  // shown without a copy
+        return GrabResult::Frame;
     }
-};
 
-bool captureFrames(cv::VideoCapture* cap, ViewportalCapture& out) {
-    out.color_rgb.data = nullptr;
-    out.depth_g8.data = nullptr;
+    void close() override { cap_->release(); }
+    std::string name() const override { return "camera"; }
 
-    out.color_rgb.width = kColorWidth;
-    out.color_rgb.height = kColorHeight;
-    out.color_rgb.format = ImageFormat::RGB8;
-    out.color_rgb.row_stride = 0;
+private:
+    std::unique_ptr<cv::VideoCapture> cap_;
+};
 
-    if (cap && cap->isOpened()) {
-        cv::Mat frame;
-        if (cap->read(frame)) {
-            cv::Mat rgb;
-            cv::cvtColor(frame, rgb, cv::COLOR_BGR2RGB);
-            cv::Mat resized;
-            cv::resize(rgb, resized, cv::Size(kColorWidth, kColorHeight));
-            if (resized.isContinuous() && resized.total() * resized.elemSize() <= out.color_buffer.size()) {
-                std::memcpy(out.color_buffer.data(), resized.data, resized.total() * resized.elemSize());
-            }
-        } else {
-            for (size_t i = 0; i < out.color_buffer.size(); ++i)
-                out.color_buffer[i] = static_cast<unsigned char>(rand() % 256);
-        }
-    } else {
-        for (size_t i = 0; i < out.color_buffer.size(); ++i)
-            out.color_buffer[i] = static_cast<unsigned char>(rand() % 256);
-    }
-    out.color_rgb.data = out.color_buffer.data();
-
-    // Synthetic depth (radial gradient)
-    for (int y = 0; y < kDepthHeight; ++y) {
-        for (int x = 0; x < kDepthWidth; ++x) {
-            float dx = x - kDepthWidth / 2.0f;
-            float dy = y - kDepthHeight / 2.0f;
-            float dist = std::sqrt(dx * dx + dy * dy);
-            float normalized = dist / (kDepthWidth * 0.7f);
-            out.depth_buffer[y * kDepthWidth + x] = static_cast<unsigned char>(255.0f * (1.0f - std::min(1.0f, normalized)));
-        }
+std::unique_ptr<cv::VideoCapture> openCamera() {
+    auto cap = std::make_unique<cv::VideoCapture>();
+    for (int i = 0; i < 4; ++i) {
+        if (cap->open(i)) return cap;
     }
-    out.depth_g8.width = kDepthWidth;
-    out.depth_g8.height = kDepthHeight;
-    out.depth_g8.format = ImageFormat::Luminance8;
-    out.depth_g8.data = out.depth_buffer.data();
-    out.depth_g8.row_stride = 0;
-
-    return true;
+    return nullptr;
 }
 
 } // namespace
@@ -106,27 +86,28 @@ int main(int /*argc*/, char* /*argv*/[])
 
     ViewPortal portal(rows, cols, types, params);
 
-    cv::VideoCapture cap;
-    bool use_camera = false;
-    for (int i = 0; i < 4; ++i) {
-        if (cap.open(i)) {
-            use_camera = true;
-            break;
-        }
-    }
-    if (!use_camera) {
+    SourceManager sources(portal);
+    if (std::unique_ptr<cv::VideoCapture> cap = openCamera()) {
+        SourceOptions camera_options;
+        camera_options.dedicated_thread = true;
+        sources.addSource(std::make_unique<CameraSource>(std::move(cap)), 0, camera_options);
+    } else {
         std::cout << "No camera found; using synthetic frames for color/depth viewports." << std::endl;
+        TestPatternParams color;
+        color.width = kColorWidth;
+        color.height = kColorHeight;
+        sources.addSource(createTestPatternSource(color), 0);
     }
-
-    ViewportalCapture capture;
-    while (!portal.shouldQuit()) {
-        if (!captureFrames(use_camera ? &cap : nullptr, capture))
-            continue;
-        if (capture.color_rgb.data)
-            portal.updateFrame(0, capture.color_rgb);
-        if (capture.depth_g8.data)
-            portal.updateFrame(1, capture.depth_g8);
-    }
+    TestPatternParams depth;
+    depth.width = kDepthWidth;
+    depth.height = kDepthHeight;
+    depth.format = ImageFormat::Luminance8;
+    depth.pattern = TestPattern::Gradient;
+    sources.addSource(createTestPatternSource(depth), 1);
+
+    while (!portal.shouldQuit())
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    sources.stop();
 
     return 0;
 }
@@ -3,11 +3,14 @@
 
 #include "viewportal.h"
 #include <pangolin/display/view.h>
+#include <pangolin/gl/gl.h>
 #include <memory>
 #include <string>
 
 namespace viewportal {
 
+struct MaskFrame;
+
 /**
  * Base class for viewports in the Pangolin GUI.
  * Provides a common interface for different types of viewports.
@@ -27,6 +30,15 @@ public:
      */
     virtual void update() {}
 
+    /**
+     * CPU work for the next update(), such as colormapping the new frame
+     * (internal API). Runs on a worker thread, in parallel with other viewports'
+     * prepare(), so it must not call GL or touch state shared between viewports.
+     * Viewports that override it call it from update() when it has not run.
+     * Default no-op.
+     */
+    virtual void prepare() {}
+
     /**
      * Render the viewport content.
      * Called every frame when the viewport is shown.
@@ -61,6 +73,81 @@ public:
      * Default no-op; override in RGB8/G8 viewports.
      */
     virtual void setFrame(const FrameData& frame) { (void)frame; }
+
+    /**
+     * Allocate textures for frames of this size and format before the first one
+     * arrives (internal API, display thread). Default no-op.
+     */
+    virtual void reserve(int width, int height, ImageFormat format) { (void)width; (void)height; (void)format; }
+
+    /**
+     * True while the viewport still reads the pixels of the last frame after
+     * update() (internal API). The frame's owner is then kept until the next frame.
+     */
+    virtual bool retainsFrame() const { return false; }
+
+    /**
+     * Set a frame of which only the given rectangle changed since the last one
+     * (internal API). Default treats it as a full frame.
+     */
+    virtual void setFrameRegion(const FrameData& frame, int x, int y, int w, int h) {
+        (void)x; (void)y; (void)w; (void)h;
+        setFrame(frame);
+    }
+
+    /**
+     * Set the overlay drawn on top of the image (internal API).
+     * Default no-op; override in image viewports.
+     */
+    virtual void setOverlay(std::shared_ptr<const Overlay> overlay) { (void)overlay; }
+
+    /**
+     * Set the label mask and its palette (internal API). A null mask clears it.
+     * Default no-op; override in image viewports.
+     */
+    virtual void setMask(std::shared_ptr<const MaskFrame> mask) { (void)mask; }
+    virtual void setMaskPalette(std::shared_ptr<const MaskPalette> palette) { (void)palette; }
+
+    /**
+     * Set the color map of ColoredDepth viewports (internal API).
+     * Default no-op.
+     */
+    virtual void setColormap(std::shared_ptr<const ColormapParams> params) { (void)params; }
+
+    /**
+     * Texture holding the image as currently displayed, top row first unless
+     * bottom_up is set (internal API). Read by Compare viewports; null when the
+     * viewport has no single such texture.
+     */
+    virtual const pangolin::GlTexture* displayTexture(bool& bottom_up) const { (void)bottom_up; return nullptr; }
+
+    /**
+     * Map a window position (Pangolin pixels, y up) to pixels of the source image
+     * as currently displayed (internal API, display thread). \return false when
+     * the viewport shows no image there.
+     */
+    virtual bool imagePosition(float x, float y, float& image_x, float& image_y) const {
+        (void)x; (void)y; (void)image_x; (void)image_y;
+        return false;
+    }
+
+    /**
+     * Set the two viewports a Compare viewport reads (internal API, display
+     * thread, before every update()); null when a source is unavailable.
+     */
+    virtual void setCompareInputs(const Viewport* a, const Viewport* b) { (void)a; (void)b; }
+
+    /**
+     * Set the parameters of Compare viewports (internal API).
+     * Default no-op.
+     */
+    virtual void setCompareParams(std::shared_ptr<const CompareParams> params) { (void)params; }
+
+    /**
+     * Set the statistics shown by Histogram viewports (internal API).
+     * Default no-op.
+     */
+    virtual void setStats(std::shared_ptr<const ImageStats> stats) { (void)stats; }
 };
 
 /**
@@ -81,6 +168,16 @@ std::unique_ptr<Viewport> createViewport(
     float aspect_ratio = 640.0f / 480.0f
 );
 
+/**
+ * Factory function to create a viewport sized and shaped for what spec
+ * announces (textures reserved up front).
+ */
+std::unique_ptr<Viewport> createViewport(
+    ViewportType type,
+    const std::string& name,
+    const ViewportSpec& spec
+);
+
 } // namespace viewportal
 
 #endif // VIEWPORT_H
@@ -2,7 +2,12 @@
 #define VIEWPORTAL_H
 
 #include <vector>
+#include <string>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 
 namespace viewportal {
 
@@ -15,6 +20,9 @@ enum class ViewportType {
     ColoredDepth,  // G8 input displayed with colormap (e.g. jet)
     Reconstruction,
     Plot,
+    Histogram,     // live histogram and statistics of another image viewport
+    Flow,          // dense optical flow (Float32x2) in flow color coding
+    Compare,       // difference or A/B comparison of two other image viewports
     Count  // for bounds
 };
 
@@ -24,13 +32,19 @@ enum class ViewportType {
 enum class ImageFormat {
     RGB8,
     RGBA8,
-    Luminance8
+    Luminance8,
+    Float32,  // one float per pixel: depth in meters, disparity, confidence (ColoredDepth viewports)
+    Float16,  // IEEE half floats stored as uint16_t (ColoredDepth viewports)
+    Float32x2 // two floats per pixel: optical flow (u, v) in pixels (Flow viewports)
 };
 
 /**
  * Non-owning descriptor for a single image frame.
  * When passed to updateFrame(), the library copies the pixel data; the caller
  * may reuse or free the buffer immediately after updateFrame() returns.
+ * data points at the top image row and row_stride is the signed byte offset to
+ * the next row: padded rows and ROI views keep their stride through upload, and a
+ * negative stride describes a bottom-up image (data at its last row in memory).
  */
 struct FrameData {
     int width = 0;
@@ -38,6 +52,151 @@ struct FrameData {
     ImageFormat format = ImageFormat::RGB8;
     const void* data = nullptr;
     int row_stride = 0;  // 0 means packed (width * bytes_per_pixel per row)
+    std::int64_t timestamp_ns = 0;  // capture time, same clock for all sensors; 0 = unknown
+};
+
+/**
+ * RGBA color for overlay primitives; components in [0, 1].
+ */
+struct OverlayColor {
+    float r = 0.0f;
+    float g = 1.0f;
+    float b = 0.0f;
+    float a = 1.0f;
+};
+
+/**
+ * Axis-aligned rectangle outline from (x0, y0) to (x1, y1).
+ */
+struct OverlayBox {
+    float x0 = 0.0f, y0 = 0.0f, x1 = 0.0f, y1 = 0.0f;
+    OverlayColor color;
+};
+
+/**
+ * Line segment from (x0, y0) to (x1, y1).
+ */
+struct OverlayLine {
+    float x0 = 0.0f, y0 = 0.0f, x1 = 0.0f, y1 = 0.0f;
+    OverlayColor color;
+};
+
+/**
+ * Single point (e.g. a keypoint), drawn as a square of Overlay::point_size pixels.
+ */
+struct OverlayPoint {
+    float x = 0.0f, y = 0.0f;
+    OverlayColor color;
+};
+
+/**
+ * Text label anchored at (x, y) (baseline left).
+ */
+struct OverlayText {
+    float x = 0.0f, y = 0.0f;
+    std::string text;
+    OverlayColor color;
+};
+
+/**
+ * Batch of 2D primitives drawn on top of an image viewport (RGB8, G8, ColoredDepth).
+ * Coordinates are image pixels of the displayed frame: origin at the top-left
+ * corner, x to the right, y down. Each primitive kind is drawn with a single
+ * batched draw call, so large batches stay cheap.
+ */
+struct Overlay {
+    std::vector<OverlayBox> boxes;
+    std::vector<OverlayLine> lines;
+    std::vector<OverlayPoint> points;
+    std::vector<OverlayText> texts;
+    float line_width = 2.0f;  // screen pixels, for boxes and lines
+    float point_size = 4.0f;  // screen pixels
+};
+
+/**
+ * Pixel format for label (class-ID) masks.
+ */
+enum class MaskFormat {
+    Label8,   // uint8_t class IDs
+    Label16   // uint16_t class IDs
+};
+
+/**
+ * Non-owning descriptor for a label mask shown on top of an image viewport.
+ * The mask is stretched over the displayed image, so it may have a different
+ * resolution than the frame. The library copies the data in updateMask().
+ * As in FrameData, data points at the top row and row_stride may be negative.
+ */
+struct MaskData {
+    int width = 0;
+    int height = 0;
+    MaskFormat format = MaskFormat::Label8;
+    const void* data = nullptr;
+    int row_stride = 0;  // 0 means packed; |row_stride| below width * bytes per label is ignored
+};
+
+/**
+ * Colors used to blend a label mask: class ID k uses colors[k % colors.size()],
+ * with its alpha multiplied by opacity. An empty palette selects a built-in one
+ * where class 0 is transparent.
+ */
+struct MaskPalette {
+    std::vector<OverlayColor> colors;
+    float opacity = 0.5f;
+};
+
+/**
+ * Color maps for ColoredDepth viewports.
+ */
+enum class Colormap {
+    Jet,
+    Turbo,
+    Viridis,
+    Gray
+};
+
+/**
+ * How a ColoredDepth viewport maps values to color. Values are in pixel units:
+ * 0-255 for Luminance8 frames, the stored value for Float32/Float16 frames.
+ * Values outside [min, max] are clamped; NaN and +/-inf (and 0 for Luminance8,
+ * which means no measurement) are drawn in invalid_color.
+ */
+struct ColormapParams {
+    Colormap colormap = Colormap::Jet;
+    bool auto_range = false;  // track the scene's 2nd/98th percentiles instead of [min, max]
+    float min = 0.0f;
+    float max = 255.0f;
+    OverlayColor invalid_color{0.0f, 0.0f, 0.0f, 1.0f};
+};
+
+/**
+ * What a Compare viewport shows of its two sources A and B.
+ */
+enum class CompareMode {
+    Difference,  // |A - B| per channel, times gain
+    ChangeMask,  // A in gray, pixels where any channel differs by more than threshold in red
+    Split,       // A left of split, B right of it
+    Swipe        // as Split, with the divider following the mouse while dragging
+};
+
+struct CompareParams {
+    CompareMode mode = CompareMode::Difference;
+    float gain = 4.0f;         // Difference: amplification of small differences
+    float threshold = 0.05f;   // ChangeMask: per-channel difference, fraction of full scale
+    float split = 0.5f;        // Split/Swipe: divider position, fraction of the width
+};
+
+/**
+ * What an image viewport expects to receive. With a size, its textures and
+ * ingest buffers are allocated up front, so the first frame neither reallocates
+ * them nor is shown at the wrong aspect. All fields are optional.
+ */
+struct ViewportSpec {
+    int width = 0;                           // 0: unknown (320 x 240 until the first frame)
+    int height = 0;
+    std::optional<ImageFormat> format;       // unset: the viewport type's usual format
+    float aspect = 0.0f;                     // display aspect; 0: width / height, or 4:3 without a size
+    std::optional<ColormapParams> colormap;  // ColoredDepth only; as setColormap()
 };
 
 /**
@@ -48,6 +207,229 @@ struct ViewPortalParams {
     int window_height = 720;
     int panel_width = 200;
     const char* window_title = "ViewPortal";
+    bool gallery_mode = false;     // large-grid mode: all cells drawn as atlas tiles in one view
+    int gallery_tile_width = 160;  // tile size in gallery mode (texels)
+    int gallery_tile_height = 120;
+    int frame_memory_budget_mb = 0;  // if > 0, passed to setFrameMemoryBudget() at construction
+    bool sync_timestamps = false;  // show all viewports at a common capture time (see SyncStats)
+    int sync_queue_depth = 8;      // frames buffered per viewport in sync mode; older ones are dropped (shm rings: at most slot_count - 3)
+    int sync_timeout_ms = 500;     // a viewport without frames for this long stops holding the others back
+    bool headless = false;         // render offscreen without showing a window (Pangolin built with EGL)
+    int prepare_threads = 0;       // threads colormapping frames before upload, display thread included; 0 = one per core, at most 4
+    std::vector<ViewportSpec> viewport_specs;  // by viewport index; missing entries use the defaults
+};
+
+/**
+ * Optional construction parameters for DisplayManager.
+ */
+struct DisplayManagerParams {
+    int idle_refresh_ms = 33;  // redraw interval for windows with no new data (input stays responsive)
+};
+
+/**
+ * Parameters for ViewPortal::startStreaming().
+ */
+struct StreamServerParams {
+    std::string address = "tcp:0.0.0.0:7070";  // or "unix:/path/to/socket"
+    bool stream_viewports = true;   // image viewport frames, one stream per viewport
+    bool stream_composite = false;  // the whole window, read back after drawing
+    int max_fps = 30;               // per stream
+    int max_queued_frames = 8;      // per client; a client further behind drops its backlog
+    int lossy_bits = 0;             // low bits dropped per 8-bit channel before coding (0 = lossless; float frames stay lossless)
+};
+
+/**
+ * Statistics of one frame of an image viewport, shown by Histogram viewports.
+ * Large frames are subsampled by rows, so counts are of sampled pixels.
+ */
+struct ImageStats {
+    int channels = 0;              // 1 for G8 / depth / float, 3 for RGB8, 4 for RGBA8
+    std::uint64_t samples = 0;     // pixels examined
+    std::uint64_t valid = 0;       // depth: non-zero samples; float: finite samples; otherwise samples
+    float min[4] = {0.0f, 0.0f, 0.0f, 0.0f};  // per channel; invalid samples are ignored
+    float max[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    std::vector<std::uint32_t> histogram;  // 256 bins per channel, channel after channel
+    float hist_low = 0.0f;         // the bins split [hist_low, hist_high) evenly: 8-bit bin i is value i,
+    float hist_high = 256.0f;      // float bins span [min, max] (max falls in the last bin)
+    std::uint64_t frame = 0;       // sequence number of the source frame
+};
+
+/**
+ * Timestamp synchronization of one viewport (sync_timestamps mode).
+ */
+struct SyncViewportStats {
+    size_t queued = 0;                 // frames waiting for their presentation time
+    std::uint64_t presented = 0;
+    std::uint64_t dropped = 0;         // evicted from a full queue or superseded before shown
+    std::int64_t shown_ns = 0;         // capture time of the frame on screen
+    bool active = false;               // received a frame within sync_timeout_ms
+};
+
+/**
+ * State of the sync_timestamps mode. Each display step picks the presentation
+ * time: the oldest "newest capture time" over the active viewports, the latest
+ * instant for which all of them have data. Every viewport then shows its newest
+ * frame captured at or before it.
+ */
+struct SyncStats {
+    std::int64_t presentation_ns = 0;
+    std::int64_t skew_ns = 0;          // spread of the capture times on screen now
+    std::int64_t max_skew_ns = 0;      // largest skew seen
+    std::uint64_t dropped = 0;         // over all viewports
+    std::vector<SyncViewportStats> viewports;  // by viewport index; all zero for non-image cells
+};
+
+/**
+ * Time from a frame being published (made the viewport's newest frame) to the
+ * display taking it for drawing.
+ */
+struct LatencyStats {
+    std::uint64_t count = 0;  // frames measured
+    double p50_ms = 0.0;
+    double p90_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+/**
+ * Frame counters of one image viewport since it was created.
+ */
+struct ViewportStats {
+    std::uint64_t published = 0;  // frames made the newest frame (after any delivery or sync queue)
+    std::uint64_t displayed = 0;  // frames taken by the display for drawing
+    std::uint64_t replaced = 0;   // frames discarded for a newer one before they were displayed
+    std::uint64_t dropped = 0;    // frames never published: skipped for a hidden viewport, closed window, timeout
+    LatencyStats latency;
+};
+
+/**
+ * Display counters of a ViewPortal, see ViewPortal::displayStats().
+ */
+struct DisplayStats {
+    std::uint64_t steps = 0;    // windows drawn
+    LatencyStats latency;       // over all viewports
+    std::vector<ViewportStats> viewports;  // by viewport index; all zero for non-image cells
+};
+
+/**
+ * How updateFrame() hands the frames of one viewport to the display.
+ */
+enum class DeliveryPolicy {
+    LatestWins,     // a newer frame replaces one not displayed yet; never blocks (default)
+    BlockWhenFull,  // every frame is displayed in order; updateFrame() waits while the queue is full
+    DropOldest      // frames are displayed in order; a full queue discards its oldest frame
+};
+
+/**
+ * Delivery policy of one viewport, see ViewPortal::setDeliveryPolicy().
+ */
+struct DeliveryParams {
+    DeliveryPolicy policy = DeliveryPolicy::LatestWins;
+    int queue_depth = 4;        // frames waiting behind the one being published
+    int block_timeout_ms = -1;  // BlockWhenFull: give up after this long (-1 = no limit)
+};
+
+/**
+ * Outcome of updateFrame().
+ */
+enum class FrameStatus {
+    Accepted,  // will be displayed (or waits in the queue to be)
+    Replaced,  // will be displayed, but an earlier frame not displayed yet was discarded for it
+    Dropped    // will not be displayed: invalid frame or viewport, hidden viewport, closed window or timeout
+};
+
+enum class InputEventType {
+    KeyDown,
+    KeyUp,
+    MouseDown,
+    MouseUp,
+    MouseMove,  // while dragging or hovering
+    Scroll
+};
+
+/** Bits of InputEvent::modifiers. */
+enum InputModifier {
+    InputModifierShift = 1,
+    InputModifierCtrl = 2,
+    InputModifierAlt = 4
+};
+
+/**
+ * Keyboard or mouse input, as returned by ViewPortal::pollEvent().
+ */
+struct InputEvent {
+    InputEventType type = InputEventType::KeyDown;
+    std::int64_t timestamp_ns = 0;   // steady_clock time the display thread received it
+    int viewport = -1;               // index of the viewport under the pointer; -1 if none
+    int key = 0;                     // KeyDown/KeyUp: key code
+    int button = 0;                  // MouseDown/MouseUp: 1 left, 2 middle, 4 right
+    int buttons = 0;                 // mouse buttons held (same bits)
+    int modifiers = 0;               // InputModifier bits
+    bool in_image = false;           // the pointer is over the viewport's image
+    float image_x = 0.0f;            // pointer in source image pixels (top-left origin),
+    float image_y = 0.0f;            // following zoom and pan; valid when in_image
+    float scroll_x = 0.0f;           // Scroll: wheel steps or trackpad deltas
+    float scroll_y = 0.0f;
+};
+
+/**
+ * Frame buffer memory shared by all ViewPortal windows in the process.
+ */
+struct FrameMemoryStats {
+    size_t budget_bytes = 0;      // 0 = unlimited
+    size_t in_use_bytes = 0;      // held by frame buffers
+    size_t cached_bytes = 0;      // freed and kept for reuse
+    size_t peak_bytes = 0;        // highest in_use + cached seen
+    std::uint64_t allocations = 0;
+    std::uint64_t reuses = 0;     // requests served from the cache
+    std::uint64_t over_budget = 0;  // allocations made although they exceed the budget
+};
+
+/**
+ * Cap the memory held by frame buffers (in use plus cached), process-wide.
+ * Cached buffers are freed first to stay within it; buffers in use are never
+ * taken away. 0 (the default) removes the cap.
+ */
+void setFrameMemoryBudget(size_t bytes);
+
+/**
+ * Free every cached frame buffer now. Cached buffers are also freed on their own
+ * after a few seconds without reuse, e.g. after streams drop to a lower resolution.
+ */
+void trimFrameMemory();
+
+FrameMemoryStats frameMemoryStats();
+
+/**
+ * Hosts one or more ViewPortal windows on a single display thread.
+ * Windows are visited round-robin; a window is redrawn when it is dirty (new
+ * frames, layout changes, animated viewports) or when its idle refresh interval
+ * has elapsed, so idle windows do not spin. A ViewPortal constructed without a
+ * manager owns a private one. The manager must outlive every attached ViewPortal.
+ * Windows with the same title get distinct context names ("title (2)", ...)
+ * across all managers of the process, so their contexts and controls never mix.
+ * Sharing GL contexts or textures between windows is not supported: Pangolin
+ * creates every window with its own context, so each uploads its own textures
+ * and builds its own shaders.
+ */
+class DisplayManager {
+public:
+    explicit DisplayManager(const DisplayManagerParams& params = DisplayManagerParams());
+    ~DisplayManager();
+
+    DisplayManager(const DisplayManager&) = delete;
+    DisplayManager& operator=(const DisplayManager&) = delete;
+
+    /**
+     * Number of windows currently hosted (thread-safe).
+     */
+    size_t numWindows() const;
+
+private:
+    friend class ViewPortal;
+    struct Impl;
+    Impl* impl_;
 };
 
 /**
@@ -76,17 +458,161 @@ public:
     ViewPortal(int rows, int cols, const std::vector<ViewportType>& types,
                const ViewPortalParams& params);
 
+    /**
+     * Create a display hosted on a shared DisplayManager: the window is rendered on
+     * the manager's display thread alongside the manager's other windows.
+     * \param manager Display manager; must outlive this ViewPortal.
+     */
+    ViewPortal(DisplayManager& manager, int rows, int cols, const std::vector<ViewportType>& types,
+               const ViewPortalParams& params);
+
     ~ViewPortal();
 
     ViewPortal(const ViewPortal&) = delete;
     ViewPortal& operator=(const ViewPortal&) = delete;
 
     /**
-     * Set the next frame to display in an image viewport (RGB8 or G8).
-     * Takes a copy of the frame data; the display runs on its own thread and shows
-     * the latest copied frame. No-op for other viewport types.
+     * Set the next frame to display in an image viewport (RGB8, G8, ColoredDepth
+     * or Flow). Takes a copy of the frame data; the display runs on its own thread
+     * and shows the latest copied frame. No-op for other viewport types, for
+     * Float32 / Float16 frames sent to anything but a ColoredDepth viewport, and
+     * for Flow viewports unless the frame is Float32x2. Frames for a hidden
+     * viewport (Show off, or another one fullscreen) that no Compare or Histogram
+     * cell or stream reads are copied at most every 250 ms and otherwise dropped,
+     * so once shown it is at most that far behind until the next frame. How
+     * frames arriving faster than the display are handled is set per viewport
+     * with setDeliveryPolicy().
+     */
+    FrameStatus updateFrame(size_t viewportIndex, const FrameData& frame);
+
+    /**
+     * Zero-copy variant of updateFrame(): the pixels are read in place and owner
+     * keeps them alive. ViewPortal drops its reference once the display thread has
+     * uploaded the frame, or when a newer frame replaces it before it was shown, so
+     * the owner's destructor may run on the display thread or in a later
+     * updateFrame() call. ColoredDepth viewports that color frames on the CPU, and
+     * Flow viewports, keep it until the next frame, to recolor it when the
+     * colormap or scale changes or redraw its arrows. Frames whose stride cannot
+     * be uploaded in place are copied.
+     */
+    FrameStatus updateFrame(size_t viewportIndex, const FrameData& frame, std::shared_ptr<const void> owner);
+
+    /**
+     * Zero-copy variant taking a release callback, called exactly once when the
+     * pixels are no longer needed (see the shared_ptr overload for when).
+     */
+    FrameStatus updateFrame(size_t viewportIndex, const FrameData& frame, std::function<void()> release);
+
+    /**
+     * Set how updateFrame() treats frames of an image viewport that arrive faster
+     * than the display takes them (thread-safe). The queued policies publish one
+     * frame per display step, so each frame reaches the screen; BlockWhenFull
+     * gives producers backpressure, DropOldest bounds their latency instead.
+     * Queued frames keep their owner (zero-copy) or a copy of the pixels.
+     * Timestamped frames in sync_timestamps mode use the sync queue instead.
      */
-    void updateFrame(size_t viewportIndex, const FrameData& frame);
+    void setDeliveryPolicy(size_t viewportIndex, const DeliveryParams& delivery);
+
+    /**
+     * Block until every frame passed to updateFrame() for an image viewport has
+     * been taken by the display for drawing (thread-safe). The frames of a hidden
+     * viewport still read by a Histogram or stream count as taken at the next
+     * display step.
+     * \return false on timeout (timeout_ms >= 0), if the window closed, or if
+     *         the viewport is hidden and its frames are dropped.
+     */
+    bool waitUntilDisplayed(size_t viewportIndex, int timeout_ms = -1);
+
+    /**
+     * Counters of the sync_timestamps mode (thread-safe); false when it is off.
+     * In that mode, frames carrying a timestamp_ns are queued (zero-copy frames
+     * keep their owner while queued) and shown once the other active viewports
+     * have caught up to their capture time. Frames without a timestamp and
+     * updateFrameRegion() bypass the queue.
+     */
+    bool syncStats(SyncStats& stats) const;
+
+    /**
+     * Frame and latency counters (thread-safe), e.g. for load tests. Counters
+     * only grow; latency covers the frames displayed since the last reset.
+     * \param reset_latency Start new latency measurements after reading.
+     */
+    void displayStats(DisplayStats& stats, bool reset_latency = false) const;
+
+    /**
+     * Replace a w x h rectangle at (x, y) of the frame last passed to updateFrame().
+     * Only the rectangle is copied and re-uploaded, so cost scales with the changed
+     * area rather than the frame size. data holds pixels in the viewport's current
+     * format, row_stride bytes apart (0 = tightly packed). Ignored if the rectangle
+     * does not fit the current frame, no frame has been set yet, or the frame was
+     * passed zero-copy and has already been handed back to its owner (send the
+     * next one with the copying updateFrame() to patch it), and after a frame was
+     * skipped for a hidden viewport until the next full frame. Waits while the
+     * display uploads, or the streaming server copies, the frame being patched.
+     */
+    void updateFrameRegion(size_t viewportIndex, int x, int y, int w, int h, const void* data, int row_stride = 0);
+
+    /**
+     * Set the overlay drawn on top of an image viewport (RGB8, G8 or ColoredDepth).
+     * Latest-wins like updateFrame(): the overlay replaces the previous one and stays
+     * until replaced; pass an empty Overlay to clear. No-op for other viewport types.
+     */
+    void updateOverlay(size_t viewportIndex, const Overlay& overlay);
+
+    /**
+     * Move overload of updateOverlay(); avoids copying large batches.
+     */
+    void updateOverlay(size_t viewportIndex, Overlay&& overlay);
+
+    /**
+     * Set the label mask blended over an image viewport (latest-wins; copies the data).
+     * The mask is uploaded as a single-channel integer texture and colored with the
+     * viewport's palette on the GPU. Pass a MaskData with null data to clear. A
+     * mask whose rows overlap (|row_stride| < width * bytes per label) is ignored.
+     */
+    void updateMask(size_t viewportIndex, const MaskData& mask);
+
+    /**
+     * Set the palette and opacity used to blend the viewport's label mask.
+     */
+    void setMaskPalette(size_t viewportIndex, const MaskPalette& palette);
+
+    /**
+     * Set the color map, value range and invalid color of a ColoredDepth viewport
+     * (thread-safe). Float frames are colored on the GPU, so changing the range
+     * does not re-upload them.
+     */
+    void setColormap(size_t viewportIndex, const ColormapParams& params);
+
+    /**
+     * Bind a Histogram viewport to the image viewport it analyses (RGB8, G8 or
+     * ColoredDepth). Statistics are computed on a worker thread, at most about 30
+     * times per second, from the frames the source viewport receives; frames
+     * with more than max_samples pixels are subsampled by rows (0 = every pixel).
+     * The binding follows both cells when viewports are added or removed.
+     */
+    void setHistogramSource(size_t histogramIndex, size_t sourceIndex, size_t max_samples = 1 << 18);
+
+    /**
+     * Latest statistics shown by a Histogram viewport (thread-safe), e.g. for
+     * auto-exposure. False until its first result.
+     */
+    bool histogramStats(size_t histogramIndex, ImageStats& stats) const;
+
+    /**
+     * Bind a Compare viewport to the two image viewports it compares. The
+     * comparison runs in a shader on the textures the sources already display,
+     * so it costs no frame copy; sources of different sizes are stretched to A.
+     * Sources without a single displayed texture (tiled very large images, float
+     * or flow frames colored on the GPU) leave the cell blank. The binding
+     * follows the cells when viewports are added or removed.
+     */
+    void setCompareSources(size_t compareIndex, size_t sourceA, size_t sourceB);
+
+    /**
+     * Set the mode and parameters of a Compare viewport (thread-safe).
+     */
+    void setCompareParams(size_t compareIndex, const CompareParams& params);
 
     /**
      * Return true if the user requested to close the window (thread-safe).
@@ -108,11 +634,73 @@ public:
      */
     void setKeysToWatch(const std::vector<int>& keys);
 
+    /**
+     * Take the oldest pending input event; false if there is none. Lock-free;
+     * call from one thread only. Events are recorded from the first call on, in
+     * a bounded queue: when the app falls behind by more than 4096 events, newer
+     * ones are dropped (counted by droppedInputEvents()).
+     */
+    bool pollEvent(InputEvent& event);
+
+    /**
+     * Number of input events dropped because the queue was full (thread-safe).
+     */
+    std::uint64_t droppedInputEvents() const;
+
+    /**
+     * Append a viewport of the given type to the end of the grid (thread-safe).
+     * The change is queued and applied on the display thread between frames; the
+     * window, GL context and existing viewports are kept. spec sizes the cell up
+     * front, as ViewPortalParams::viewport_specs does at construction.
+     * \return Index of the new viewport, usable with updateFrame() immediately.
+     */
+    size_t addViewport(ViewportType type, const ViewportSpec& spec = ViewportSpec());
+
+    /**
+     * Remove the viewport at viewportIndex (thread-safe). Viewports after it shift
+     * down by one index. Applied on the display thread between frames.
+     */
+    void removeViewport(size_t viewportIndex);
+
+    /**
+     * Change the type of the viewport at viewportIndex (thread-safe). The ingest
+     * buffers of the cell are kept; the last frame is discarded. Applied on the
+     * display thread between frames.
+     */
+    void setViewportType(size_t viewportIndex, ViewportType type);
+
+    /**
+     * Number of viewports in the current layout, including queued changes.
+     */
+    size_t numViewports() const;
+
+    /**
+     * Serve this window's frames to remote viewers (see StreamClient in
+     * viewportal_stream.h and examples/stream_viewer). Frames are delta and
+     * Rice coded on a worker thread and each client has its own bounded
+     * queue, so slow clients never block the display or the producer.
+     * Replaces a running server. POSIX only.
+     * \return false if the address cannot be listened on, with a message in error if given.
+     */
+    bool startStreaming(const StreamServerParams& params = StreamServerParams(), std::string* error = nullptr);
+    void stopStreaming();
+
+    /**
+     * Show the frames of a shared-memory ring (written by a ShmFrameProducer in
+     * viewportal_shm.h, usually in another process) in an image viewport. Frames
+     * are uploaded straight from the ring. The producer may start after this call
+     * and may exit or restart at any time; the viewport keeps its last frame
+     * meanwhile. Replaces the viewport's previous ring. POSIX only.
+     * \return false if shared-memory rings are not available on this platform.
+     */
+    bool attachSharedMemory(size_t viewportIndex, const std::string& ringName);
+    void detachSharedMemory(size_t viewportIndex);
+
 private:
     struct Impl;
     Impl* impl_;
 
-    static void displayThreadMain(Impl* impl);
+    void startDisplay(DisplayManager* manager);
     static void initOnDisplayThread(Impl* impl);
     static void stepFrame(Impl* impl);
 };
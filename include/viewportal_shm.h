@@ -0,0 +1,71 @@
+#ifndef VIEWPORTAL_SHM_H
+#define VIEWPORTAL_SHM_H
+
+#include "viewportal.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace viewportal {
+
+/**
+ * Geometry of a shared-memory frame ring.
+ */
+struct ShmRingParams {
+    int slot_count = 4;                       // at least 3: the viewer may hold two frames, plus slot_count - 3 queued in sync_timestamps mode
+    size_t slot_bytes = 1920 * 1080 * 4;      // largest frame the ring accepts
+};
+
+/**
+ * Writing end of a shared-memory frame ring (POSIX shm), for capture or
+ * perception processes feeding a ViewPortal in another process through
+ * ViewPortal::attachSharedMemory(). Frames are written straight into the ring and
+ * shown without further copies. Neither side blocks the other: when every slot
+ * is still held by the viewer a frame is dropped, and either process may exit or
+ * restart at any time. Needs only the C++ runtime, not Pangolin or GL.
+ */
+class ShmFrameProducer {
+public:
+    ShmFrameProducer();
+    ~ShmFrameProducer();
+
+    ShmFrameProducer(const ShmFrameProducer&) = delete;
+    ShmFrameProducer& operator=(const ShmFrameProducer&) = delete;
+
+    /**
+     * Create the ring with the given name, replacing a ring left behind by an
+     * earlier producer. A viewer attached to the name switches over on its own.
+     * \return false on failure, with a message in error if given.
+     */
+    bool open(const std::string& name, const ShmRingParams& params = ShmRingParams(), std::string* error = nullptr);
+
+    /** Mark the ring closed and remove it; the viewer keeps the last frame. */
+    void close();
+    bool isOpen() const;
+
+    /**
+     * Reserve a slot for the next frame and return where its top row goes; rows
+     * are row_stride bytes apart (0 = packed, negative = bottom-up). Fill it and
+     * call commitFrame(). Returns nullptr if the frame does not fit a slot or all
+     * slots are held by the viewer (drop the frame and try again later).
+     */
+    void* beginFrame(int width, int height, ImageFormat format, int row_stride = 0);
+
+    /** Publish the frame reserved by beginFrame(). */
+    void commitFrame(std::uint64_t timestamp_ns = 0);
+
+    /**
+     * Copy a frame into the ring and publish it (beginFrame() + copy + commitFrame()).
+     * A timestamp_ns of 0 takes frame.timestamp_ns.
+     * \return false if the frame was dropped.
+     */
+    bool writeFrame(const FrameData& frame, std::uint64_t timestamp_ns = 0);
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
+} // namespace viewportal
+
+#endif // VIEWPORTAL_SHM_H
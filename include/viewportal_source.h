@@ -0,0 +1,180 @@
+#ifndef VIEWPORTAL_SOURCE_H
+#define VIEWPORTAL_SOURCE_H
+
+#include "viewportal.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace viewportal {
+
+/** Outcome of FrameSource::grab(). */
+enum class GrabResult {
+    Frame,  // out holds a new frame
+    Retry,  // nothing new yet; grab() is called again after the source's interval
+    End     // the source is exhausted or failed; it is closed and stops
+};
+
+/**
+ * A frame produced by a FrameSource. Without an owner the pixels only need to
+ * stay valid until the next grab() and are copied when published; with one
+ * they are shown in place (see the zero-copy ViewPortal::updateFrame()).
+ */
+struct SourceFrame {
+    FrameData frame;
+    std::shared_ptr<const void> owner;
+};
+
+/**
+ * A producer of frames for one viewport: a camera, a file, a generator. A
+ * SourceManager calls open(), grab() until it stops the source, then close(),
+ * never concurrently, on its worker threads. Capture and conversion therefore
+ * run off the application and display threads, in parallel across sources.
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    /** Prepare the source. \return false on failure, with a message in error. */
+    virtual bool open(std::string& error) {
+        (void)error;
+        return true;
+    }
+
+    /** Capture and convert the next frame. May block, e.g. waiting on a device. */
+    virtual GrabResult grab(SourceFrame& out) = 0;
+
+    virtual void close() {}
+
+    /** Frames per second to pace grab() at; 0 = as fast as grab() returns. */
+    virtual double frameRate() const { return 0.0; }
+
+    /** Name for statistics and error messages. */
+    virtual std::string name() const { return "source"; }
+};
+
+/**
+ * How a SourceManager runs one source.
+ */
+struct SourceOptions {
+    bool dedicated_thread = false;  // own thread, for sources whose grab() blocks; else the shared pool
+    double frame_rate = -1.0;       // overrides the source's frameRate() when >= 0
+};
+
+struct SourceManagerParams {
+    int pool_threads = 0;  // threads shared by sources without a dedicated thread; 0 = one per core, at most 8
+};
+
+/**
+ * Counters of one source bound by a SourceManager.
+ */
+struct SourceStats {
+    std::string name;
+    size_t viewport = 0;
+    bool running = false;        // false once stopped, ended or failed to open
+    std::uint64_t frames = 0;    // frames grabbed and published
+    std::uint64_t replaced = 0;  // published frames that displaced one not displayed yet
+    std::uint64_t dropped = 0;   // published frames that will not be displayed
+    std::uint64_t grabs = 0;     // grab() calls, including those without a new frame
+    double grab_total_ms = 0.0;  // time spent in grab() over all calls
+    double grab_ms = 0.0;        // mean time spent in grab() (grab_total_ms / grabs)
+    std::string error;           // why the source stopped early, if it did
+};
+
+/**
+ * Runs FrameSources and publishes their frames to the viewports they are bound
+ * to. Blocking sources get a thread each; the others share a small pool that
+ * grabs whichever source is due next, so sources capture, convert and publish
+ * in parallel instead of one after the other in the application's loop.
+ * Frames go through ViewPortal::updateFrame(), so the viewport's delivery
+ * policy applies. Destroy the manager before the ViewPortal it feeds.
+ */
+class SourceManager {
+public:
+    explicit SourceManager(ViewPortal& portal, const SourceManagerParams& params = SourceManagerParams());
+    ~SourceManager();
+
+    SourceManager(const SourceManager&) = delete;
+    SourceManager& operator=(const SourceManager&) = delete;
+
+    /**
+     * Bind a source to a viewport and start it (thread-safe).
+     * \return Id for removeSource() and sourceStats(), or -1 if source is null.
+     */
+    int addSource(std::unique_ptr<FrameSource> source, size_t viewportIndex,
+                  const SourceOptions& options = SourceOptions());
+
+    /**
+     * Stop a source, waiting for a grab() in progress, and close it.
+     * \return false if id is unknown.
+     */
+    bool removeSource(int id);
+
+    /** Stop and close all sources. */
+    void stop();
+
+    /** \return false if id is unknown. */
+    bool sourceStats(int id, SourceStats& stats) const;
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
+/** Built-in test patterns; each moves from frame to frame. */
+enum class TestPattern {
+    ColorBars,  // scrolling vertical bars
+    Gradient,   // pulsing radial gradient
+    Checker     // drifting checkerboard
+};
+
+/**
+ * Synthetic stream. Color formats draw the pattern as is, Luminance8 in gray,
+ * Float32 / Float16 as depth from 0.5 to 4.5 m and Float32x2 as a rotating
+ * flow field scaled by the pattern.
+ */
+struct TestPatternParams {
+    int width = 640;
+    int height = 480;
+    ImageFormat format = ImageFormat::RGB8;
+    TestPattern pattern = TestPattern::ColorBars;
+    double frame_rate = 30.0;
+};
+
+std::unique_ptr<FrameSource> createTestPatternSource(const TestPatternParams& params = TestPatternParams());
+
+/**
+ * Images of a directory in file name order (any format pangolin::LoadImage()
+ * reads). 8-bit gray, RGB and RGBA images are shown as is, 32-bit float gray as
+ * Float32; 16-bit gray (e.g. depth in millimeters) becomes Float32 times
+ * depth_scale.
+ */
+struct ImageSequenceParams {
+    std::string directory;
+    double frame_rate = 30.0;
+    bool loop = true;
+    float depth_scale = 0.001f;
+};
+
+std::unique_ptr<FrameSource> createImageSequenceSource(const ImageSequenceParams& params);
+
+/**
+ * Raw frames stored back to back in a file, e.g. a capture dump: header_bytes
+ * at the start are skipped, then every frame is width x height packed pixels.
+ */
+struct RawFileParams {
+    std::string path;
+    int width = 0;
+    int height = 0;
+    ImageFormat format = ImageFormat::RGB8;
+    size_t header_bytes = 0;
+    double frame_rate = 30.0;
+    bool loop = true;
+};
+
+std::unique_ptr<FrameSource> createRawFileSource(const RawFileParams& params);
+
+} // namespace viewportal
+
+#endif // VIEWPORTAL_SOURCE_H
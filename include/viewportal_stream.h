@@ -0,0 +1,58 @@
+#ifndef VIEWPORTAL_STREAM_H
+#define VIEWPORTAL_STREAM_H
+
+#include "viewportal.h"
+#include <string>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Receiving end of ViewPortal::startStreaming(), for remote viewers and tests.
+ * Decodes the stream back into full frames; after a frame that fails to
+ * decode, it asks the server for key frames and drops that viewport's deltas
+ * until one arrives.
+ */
+class StreamClient {
+public:
+    StreamClient();
+    ~StreamClient();
+
+    StreamClient(const StreamClient&) = delete;
+    StreamClient& operator=(const StreamClient&) = delete;
+
+    /**
+     * Connect to a server ("tcp:HOST:PORT" or "unix:PATH") and read its layout.
+     * \return false on failure, with a message in error if given.
+     */
+    bool connect(const std::string& address, std::string* error = nullptr);
+    void disconnect();
+
+    /**
+     * Make a receive() blocked on another thread return false; the connection is
+     * closed by that receive(). Safe to call from any thread.
+     */
+    void interrupt();
+
+    /** Grid announced by the server when the connection was made. */
+    int rows() const;
+    int cols() const;
+    const std::vector<ViewportType>& types() const;
+
+    /**
+     * Block until the next frame arrives and decode it.
+     * \param viewport Set to the viewport index, or -1 for the composite window.
+     * \param frame Set to the reconstructed image (packed rows); valid until the
+     *        next receive() for the same viewport.
+     * \return false once the connection is closed.
+     */
+    bool receive(int& viewport, FrameData& frame);
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
+} // namespace viewportal
+
+#endif // VIEWPORTAL_STREAM_H
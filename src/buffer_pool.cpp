@@ -0,0 +1,178 @@
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace viewportal {
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+void* allocatePages(size_t bytes) {
+    void* p = std::aligned_alloc(kPageSize, bytes);  // bytes is a multiple of the page size
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+} // namespace
+
+BufferPool& BufferPool::instance() {
+    // Never destroyed, so buffers owned by static objects can still be released at exit
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+size_t BufferPool::classSize(size_t bytes) {
+    if (bytes <= kPageSize) return kPageSize;
+    // Largest power of two not above bytes, then the next quarter step above it
+    size_t base = kPageSize;
+    while (base * 2 <= bytes) base *= 2;
+    const size_t step = base / 4;
+    const size_t size = base + (bytes - base + step - 1) / step * step;
+    return (size + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+void* BufferPool::acquire(size_t bytes, size_t& capacity) {
+    capacity = classSize(bytes);
+    std::lock_guard<std::mutex> lock(mutex_);
+    void* data = nullptr;
+    auto it = cached_.find(capacity);
+    if (it != cached_.end() && !it->second.empty()) {
+        data = it->second.back().data;
+        it->second.pop_back();
+        stats_.cached_bytes -= capacity;
+        ++stats_.reuses;
+    } else {
+        if (stats_.budget_bytes != 0)
+            freeCachedUntil(capacity);
+        data = allocatePages(capacity);
+        ++stats_.allocations;
+        if (stats_.budget_bytes != 0 && stats_.in_use_bytes + stats_.cached_bytes + capacity > stats_.budget_bytes)
+            ++stats_.over_budget;
+    }
+    stats_.in_use_bytes += capacity;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.in_use_bytes + stats_.cached_bytes);
+    return data;
+}
+
+void BufferPool::release(void* data, size_t capacity) {
+    if (!data) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.in_use_bytes -= capacity;
+    if (stats_.budget_bytes != 0 && stats_.in_use_bytes + stats_.cached_bytes + capacity > stats_.budget_bytes) {
+        std::free(data);
+        return;
+    }
+    cached_[capacity].push_back(Cached{data, Clock::now()});
+    stats_.cached_bytes += capacity;
+}
+
+void BufferPool::freeCachedUntil(size_t needed) {
+    // Largest classes first: a resolution drop leaves the big blocks unused
+    for (auto it = cached_.rbegin(); it != cached_.rend(); ++it) {
+        std::vector<Cached>& blocks = it->second;
+        while (!blocks.empty() &&
+               stats_.in_use_bytes + stats_.cached_bytes + needed > stats_.budget_bytes) {
+            std::free(blocks.front().data);
+            blocks.erase(blocks.begin());
+            stats_.cached_bytes -= it->first;
+        }
+    }
+}
+
+void BufferPool::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.budget_bytes = bytes;
+    if (bytes != 0)
+        freeCachedUntil(0);
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : cached_) {
+        for (const Cached& c : entry.second)
+            std::free(c.data);
+        stats_.cached_bytes -= entry.first * entry.second.size();
+        entry.second.clear();
+    }
+}
+
+void BufferPool::trimIdle(std::chrono::steady_clock::duration max_age) {
+    const Clock::time_point cutoff = Clock::now() - max_age;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : cached_) {
+        std::vector<Cached>& blocks = entry.second;
+        size_t n = 0;
+        while (n < blocks.size() && blocks[n].released < cutoff) {
+            std::free(blocks[n].data);
+            ++n;
+        }
+        if (n == 0) continue;
+        blocks.erase(blocks.begin(), blocks.begin() + static_cast<std::ptrdiff_t>(n));
+        stats_.cached_bytes -= entry.first * n;
+    }
+}
+
+FrameMemoryStats BufferPool::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+    other.data_ = nullptr;
+    other.size_ = 0;
+    other.capacity_ = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        data_ = other.data_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        other.data_ = nullptr;
+        other.size_ = 0;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+void PooledBuffer::resize(size_t bytes) {
+    if (bytes == 0) {
+        reset();
+        return;
+    }
+    if (keepsBlock(bytes)) {
+        size_ = bytes;
+        return;
+    }
+    reset();
+    data_ = static_cast<std::uint8_t*>(BufferPool::instance().acquire(bytes, capacity_));
+    size_ = bytes;
+}
+
+void PooledBuffer::reset() {
+    if (data_)
+        BufferPool::instance().release(data_, capacity_);
+    data_ = nullptr;
+    size_ = 0;
+    capacity_ = 0;
+}
+
+// Public entry points (declared in viewportal.h)
+
+void setFrameMemoryBudget(size_t bytes) {
+    BufferPool::instance().setBudget(bytes);
+}
+
+void trimFrameMemory() {
+    BufferPool::instance().trim();
+}
+
+FrameMemoryStats frameMemoryStats() {
+    return BufferPool::instance().stats();
+}
+
+} // namespace viewportal
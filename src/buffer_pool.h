@@ -0,0 +1,90 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include "viewportal.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Process-wide pool of page-aligned frame buffers. Requests are rounded up to a
+ * size class (quarter steps between powers of two, at least one page) and freed
+ * blocks are cached per class for reuse. Cached blocks are dropped when the
+ * total would exceed the memory budget, on trim(), or once idle for longer than
+ * the trimIdle() age, so memory follows the stream sizes actually in use.
+ */
+class BufferPool {
+public:
+    static BufferPool& instance();
+
+    /**
+     * Size class a request of the given size is served from.
+     */
+    static size_t classSize(size_t bytes);
+
+    /**
+     * Get a block of classSize(bytes) bytes. Never fails for lack of budget: an
+     * allocation that cannot fit is still made and counted in over_budget.
+     */
+    void* acquire(size_t bytes, size_t& capacity);
+    void release(void* data, size_t capacity);
+
+    void setBudget(size_t bytes);
+    void trim();
+    void trimIdle(std::chrono::steady_clock::duration max_age);
+    FrameMemoryStats stats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Cached {
+        void* data;
+        Clock::time_point released;
+    };
+
+    BufferPool() = default;
+    void freeCachedUntil(size_t needed);  // mutex_ held
+
+    std::mutex mutex_;
+    std::map<size_t, std::vector<Cached>> cached_;  // class size -> free blocks, oldest first
+    FrameMemoryStats stats_;
+};
+
+/**
+ * Move-only owner of one pooled block. resize() keeps the block when the new
+ * size maps to the same class and otherwise swaps it for a block of the new
+ * class (contents are not preserved), so buffers shrink after a resolution drop.
+ */
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer() { reset(); }
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    void resize(size_t bytes);
+    void reset();
+
+    /** Whether resize(bytes) keeps the current block. */
+    bool keepsBlock(size_t bytes) const { return data_ && bytes != 0 && BufferPool::classSize(bytes) == capacity_; }
+
+    std::uint8_t* data() { return data_; }
+    const std::uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    std::uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+} // namespace viewportal
+
+#endif // BUFFER_POOL_H
@@ -0,0 +1,156 @@
+#include "colormap.h"
+#include "image_format.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIEWPORTAL_COLORMAP_SSE2 1
+#endif
+
+namespace viewportal {
+
+namespace {
+
+unsigned char toByte(float v) {
+    return static_cast<unsigned char>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// Polynomial fits of Turbo (Mikhailov, 2019) and matplotlib's viridis
+void turbo(float t, float* c) {
+    c[0] = 0.13572138f + t * (4.61539260f + t * (-42.66032258f + t * (132.13108234f + t * (-152.94239396f + t * 59.28637943f))));
+    c[1] = 0.09140261f + t * (2.19418839f + t * (4.84296658f + t * (-14.18503333f + t * (4.27729857f + t * 2.82956604f))));
+    c[2] = 0.10667330f + t * (12.64194608f + t * (-60.58204836f + t * (110.36276771f + t * (-89.90310912f + t * 27.34824973f))));
+}
+
+void viridis(float t, float* c) {
+    static const float k[7][3] = {
+        {0.2777273272234177f, 0.005407344544966578f, 0.3340998053353061f},
+        {0.1050930431085774f, 1.404613529898575f, 1.384590162594685f},
+        {-0.3308618287255563f, 0.214847559468213f, 0.09509516302823659f},
+        {-4.634230498983486f, -5.799100973351585f, -19.33244095627987f},
+        {6.228269936347081f, 14.17993336680509f, 56.69055260068105f},
+        {4.776384997670288f, -13.74514537774601f, -65.35303263337234f},
+        {-5.435455855934631f, 4.645852612178535f, 26.3124352495832f},
+    };
+    for (int i = 0; i < 3; ++i) {
+        float v = k[6][i];
+        for (int j = 5; j >= 0; --j) v = k[j][i] + t * v;
+        c[i] = v;
+    }
+}
+
+} // namespace
+
+void buildJetRgbLut(unsigned char* lut) {
+    for (int i = 0; i < 256; ++i) {
+        float t = i / 255.0f;
+        float r = std::clamp(1.5f - 4.0f * std::abs(t - 0.75f), 0.0f, 1.0f);
+        float g = std::clamp(1.5f - 4.0f * std::abs(t - 0.5f),  0.0f, 1.0f);
+        float b = std::clamp(1.5f - 4.0f * std::abs(t - 0.25f), 0.0f, 1.0f);
+        lut[i * 3 + 0] = static_cast<unsigned char>(r * 255.0f);
+        lut[i * 3 + 1] = static_cast<unsigned char>(g * 255.0f);
+        lut[i * 3 + 2] = static_cast<unsigned char>(b * 255.0f);
+    }
+}
+
+void buildColormapLut(Colormap colormap, unsigned char* lut) {
+    if (colormap == Colormap::Jet) {
+        buildJetRgbLut(lut);
+        return;
+    }
+    for (int i = 0; i < 256; ++i) {
+        const float t = i / 255.0f;
+        float c[3] = {t, t, t};
+        if (colormap == Colormap::Turbo) turbo(t, c);
+        else if (colormap == Colormap::Viridis) viridis(t, c);
+        lut[i * 3 + 0] = toByte(c[0]);
+        lut[i * 3 + 1] = toByte(c[1]);
+        lut[i * 3 + 2] = toByte(c[2]);
+    }
+}
+
+void buildRangeLut(const unsigned char* colormap_lut, float low, float high, const unsigned char* invalid_rgb,
+                   unsigned char* lut) {
+    const float scale = high > low ? 255.0f / (high - low) : 0.0f;
+    lut[0] = invalid_rgb[0];
+    lut[1] = invalid_rgb[1];
+    lut[2] = invalid_rgb[2];
+    for (int v = 1; v < 256; ++v) {
+        const int t = static_cast<int>(std::lround(std::clamp((static_cast<float>(v) - low) * scale, 0.0f, 255.0f)));
+        lut[v * 3 + 0] = colormap_lut[t * 3 + 0];
+        lut[v * 3 + 1] = colormap_lut[t * 3 + 1];
+        lut[v * 3 + 2] = colormap_lut[t * 3 + 2];
+    }
+}
+
+void applyJetToG8(const unsigned char* g8, int width, int height, unsigned char* rgb, const unsigned char* lut) {
+    const size_t n = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char v = g8[i];
+        rgb[i * 3 + 0] = lut[v * 3 + 0];
+        rgb[i * 3 + 1] = lut[v * 3 + 1];
+        rgb[i * 3 + 2] = lut[v * 3 + 2];
+    }
+}
+
+void colormapFloatRow(const float* src, int count, float low, float high, const unsigned char* lut,
+                      const unsigned char* invalid_rgb, unsigned char* rgb) {
+    const float scale = high > low ? 255.0f / (high - low) : 0.0f;
+    int i = 0;
+#ifdef VIEWPORTAL_COLORMAP_SSE2
+    // Index math for four pixels at a time; invalid lanes get index -1. The LUT
+    // reads stay scalar (SSE2 has no gather).
+    const __m128 v_low = _mm_set1_ps(low);
+    const __m128 v_scale = _mm_set1_ps(scale);
+    const __m128 v_zero = _mm_setzero_ps();
+    const __m128 v_max = _mm_set1_ps(255.0f);
+    const __m128 v_half = _mm_set1_ps(0.5f);
+    const __m128 v_inf = _mm_set1_ps(INFINITY);
+    const __m128 v_abs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    alignas(16) std::int32_t idx[4];
+    for (; i + 4 <= count; i += 4) {
+        const __m128 v = _mm_loadu_ps(src + i);
+        // Finite: not NaN (ordered) and |v| < inf
+        const __m128 finite = _mm_cmplt_ps(_mm_and_ps(v, v_abs), v_inf);
+        __m128 t = _mm_mul_ps(_mm_sub_ps(v, v_low), v_scale);
+        t = _mm_min_ps(_mm_max_ps(t, v_zero), v_max);
+        __m128i k = _mm_cvttps_epi32(_mm_add_ps(t, v_half));
+        k = _mm_or_si128(_mm_and_si128(_mm_castps_si128(finite), k), _mm_andnot_si128(_mm_castps_si128(finite), _mm_set1_epi32(-1)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(idx), k);
+        for (int j = 0; j < 4; ++j) {
+            const unsigned char* c = idx[j] >= 0 ? lut + idx[j] * 3 : invalid_rgb;
+            unsigned char* d = rgb + static_cast<size_t>(i + j) * 3;
+            d[0] = c[0];
+            d[1] = c[1];
+            d[2] = c[2];
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        const float v = src[i];
+        const unsigned char* c = invalid_rgb;
+        if (std::isfinite(v)) {
+            const float t = std::clamp((v - low) * scale, 0.0f, 255.0f);
+            c = lut + static_cast<int>(t + 0.5f) * 3;
+        }
+        unsigned char* d = rgb + static_cast<size_t>(i) * 3;
+        d[0] = c[0];
+        d[1] = c[1];
+        d[2] = c[2];
+    }
+}
+
+void colormapHalfRow(const std::uint16_t* src, int count, float low, float high, const unsigned char* lut,
+                     const unsigned char* invalid_rgb, unsigned char* rgb) {
+    constexpr int kChunk = 256;
+    float values[kChunk];
+    for (int i = 0; i < count; i += kChunk) {
+        const int n = std::min(kChunk, count - i);
+        for (int j = 0; j < n; ++j)
+            values[j] = halfToFloat(src[i + j]);
+        colormapFloatRow(values, n, low, high, lut, invalid_rgb, rgb + static_cast<size_t>(i) * 3);
+    }
+}
+
+} // namespace viewportal
@@ -0,0 +1,48 @@
+#ifndef COLORMAP_H
+#define COLORMAP_H
+
+#include "viewportal.h"
+#include <cstdint>
+
+namespace viewportal {
+
+/**
+ * JET-like colormap LUT: 256 entries, RGB (same order as GL_RGB).
+ */
+void buildJetRgbLut(unsigned char* lut);
+
+/**
+ * 256-entry RGB LUT of a colormap.
+ */
+void buildColormapLut(Colormap colormap, unsigned char* lut);
+
+/**
+ * Build a 256-entry RGB LUT for 8-bit values that stretches [low, high] over
+ * colormap_lut (256 RGB entries), clamping outside; value 0 (no measurement)
+ * maps to invalid_rgb.
+ */
+void buildRangeLut(const unsigned char* colormap_lut, float low, float high, const unsigned char* invalid_rgb,
+                   unsigned char* lut);
+
+/**
+ * Map a packed G8 image to RGB through a 256-entry RGB LUT.
+ */
+void applyJetToG8(const unsigned char* g8, int width, int height, unsigned char* rgb, const unsigned char* lut);
+
+/**
+ * Map a row of float values to RGB: [low, high] is spread over the 256 entries
+ * of lut and clamped outside; NaN and +/-inf get invalid_rgb. CPU fallback for
+ * the float colormap shader, vectorised with SSE2 where available.
+ */
+void colormapFloatRow(const float* src, int count, float low, float high, const unsigned char* lut,
+                      const unsigned char* invalid_rgb, unsigned char* rgb);
+
+/**
+ * As colormapFloatRow() for IEEE half floats.
+ */
+void colormapHalfRow(const std::uint16_t* src, int count, float low, float high, const unsigned char* lut,
+                     const unsigned char* invalid_rgb, unsigned char* rgb);
+
+} // namespace viewportal
+
+#endif // COLORMAP_H
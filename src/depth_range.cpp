@@ -0,0 +1,123 @@
+#include "depth_range.h"
+#include "colormap.h"
+#include "image_format.h"
+#include <algorithm>
+#include <cmath>
+
+namespace viewportal {
+
+namespace {
+
+constexpr int kGridCols = 96;               // samples per sampled row
+constexpr int kGridRows = 64;               // sampled rows per frame
+constexpr float kLowPercentile = 0.02f;
+constexpr float kHighPercentile = 0.98f;
+constexpr float kSmoothing = 0.15f;         // EMA weight of the newest frame
+constexpr float kMinSpan = 8.0f;            // narrowest 8-bit range, so noise is not stretched
+constexpr std::uint32_t kMinSamples = 64;   // fewer valid samples: keep the old range
+
+} // namespace
+
+void DepthAutoRange::nextGrid(int width, int height, int& step_x, int& step_y, int& off_x, int& off_y) {
+    step_x = std::max(width / kGridCols, 1);
+    step_y = std::max(height / kGridRows, 1);
+    // Move the grid each frame so that, over time, every pixel gets sampled
+    off_x = static_cast<int>(phase_ % static_cast<std::uint32_t>(step_x));
+    off_y = static_cast<int>((phase_ / static_cast<std::uint32_t>(step_x)) % static_cast<std::uint32_t>(step_y));
+    phase_ = phase_ * 1103515245u + 12345u;  // pseudo-random walk over offsets
+}
+
+void DepthAutoRange::smooth(float low, float high) {
+    if (!initialised_) {
+        low_ = low;
+        high_ = high;
+        initialised_ = true;
+    } else {
+        low_ += kSmoothing * (low - low_);
+        high_ += kSmoothing * (high - high_);
+    }
+}
+
+void DepthAutoRange::observe(const std::uint8_t* g8, int width, int height, std::ptrdiff_t row_stride) {
+    if (!g8 || width <= 0 || height <= 0) return;
+    int step_x, step_y, off_x, off_y;
+    nextGrid(width, height, step_x, step_y, off_x, off_y);
+
+    std::uint32_t hist[256] = {};
+    std::uint32_t valid = 0;
+    for (int y = off_y; y < height; y += step_y) {
+        const std::uint8_t* row = g8 + static_cast<std::ptrdiff_t>(y) * row_stride;
+        for (int x = off_x; x < width; x += step_x) {
+            const std::uint8_t v = row[x];
+            ++hist[v];
+            valid += v != 0;
+        }
+    }
+    if (valid < kMinSamples) return;
+
+    const std::uint32_t low_rank = static_cast<std::uint32_t>(kLowPercentile * valid);
+    const std::uint32_t high_rank = static_cast<std::uint32_t>(kHighPercentile * valid);
+    int low = 1, high = 255;
+    std::uint32_t seen = 0;
+    bool low_found = false;
+    for (int v = 1; v < 256; ++v) {
+        seen += hist[v];
+        if (!low_found && seen > low_rank) {
+            low = v;
+            low_found = true;
+        }
+        if (seen > high_rank) {
+            high = v;
+            break;
+        }
+    }
+    smooth(static_cast<float>(low), static_cast<float>(high));
+}
+
+void DepthAutoRange::observeFloat(const void* data, ImageFormat format, int width, int height,
+                                  std::ptrdiff_t row_stride) {
+    if (!data || width <= 0 || height <= 0 || !isFloatFormat(format)) return;
+    int step_x, step_y, off_x, off_y;
+    nextGrid(width, height, step_x, step_y, off_x, off_y);
+
+    samples_.clear();
+    const auto* base = static_cast<const std::uint8_t*>(data);
+    for (int y = off_y; y < height; y += step_y) {
+        const std::uint8_t* row = base + static_cast<std::ptrdiff_t>(y) * row_stride;
+        for (int x = off_x; x < width; x += step_x) {
+            const float v = format == ImageFormat::Float32
+                                ? reinterpret_cast<const float*>(row)[x]
+                                : halfToFloat(reinterpret_cast<const std::uint16_t*>(row)[x]);
+            if (std::isfinite(v)) samples_.push_back(v);
+        }
+    }
+    if (samples_.size() < kMinSamples) return;
+
+    // A few thousand samples: selection is cheaper than a histogram of unknown range
+    const size_t low_rank = static_cast<size_t>(kLowPercentile * samples_.size());
+    const size_t high_rank = static_cast<size_t>(kHighPercentile * samples_.size());
+    std::nth_element(samples_.begin(), samples_.begin() + low_rank, samples_.end());
+    const float low = samples_[low_rank];
+    std::nth_element(samples_.begin() + low_rank, samples_.begin() + high_rank, samples_.end());
+    smooth(low, samples_[high_rank]);
+}
+
+void DepthAutoRange::reset() {
+    low_ = 0.0f;
+    high_ = 255.0f;
+    initialised_ = false;
+    phase_ = 0;
+}
+
+void DepthAutoRange::buildLut(const unsigned char* colormap_lut, const unsigned char* invalid_rgb,
+                              unsigned char* lut) const {
+    float low = low_, high = high_;
+    if (high - low < kMinSpan) {
+        const float mid = 0.5f * (low + high);
+        low = mid - 0.5f * kMinSpan;
+        high = mid + 0.5f * kMinSpan;
+    }
+    buildRangeLut(colormap_lut, low, high, invalid_rgb, lut);
+}
+
+} // namespace viewportal
@@ -0,0 +1,55 @@
+#ifndef DEPTH_RANGE_H
+#define DEPTH_RANGE_H
+
+#include "viewportal.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Automatic display range for 8-bit depth. Each frame contributes a sparse,
+ * sampled histogram (a few thousand pixels on a grid whose phase moves every
+ * frame, so successive frames cover different pixels); its low and high
+ * percentiles are smoothed with an exponential moving average. Zero depth means
+ * no measurement and is ignored. The result is applied through the colormap LUT,
+ * so the colormap pass stays the only full-frame pass. Float frames are sampled
+ * on the same grid; their percentiles come from the finite samples.
+ */
+class DepthAutoRange {
+public:
+    /** Sample a top-down frame and move the range towards its percentiles. */
+    void observe(const std::uint8_t* g8, int width, int height, std::ptrdiff_t row_stride);
+
+    /** As observe() for a Float32 or Float16 frame; row_stride is in bytes. */
+    void observeFloat(const void* data, ImageFormat format, int width, int height, std::ptrdiff_t row_stride);
+
+    /** Forget the history, e.g. when the stream changes. */
+    void reset();
+
+    /**
+     * Build a 256-entry RGB LUT for 8-bit depth that stretches [low, high] over
+     * the colormap colormap_lut (256 RGB entries); zero depth maps to invalid_rgb.
+     */
+    void buildLut(const unsigned char* colormap_lut, const unsigned char* invalid_rgb, unsigned char* lut) const;
+
+    bool valid() const { return initialised_; }
+    float low() const { return low_; }
+    float high() const { return high_; }
+
+private:
+    /** Grid step and this frame's offsets; advances the phase. */
+    void nextGrid(int width, int height, int& step_x, int& step_y, int& off_x, int& off_y);
+    void smooth(float low, float high);
+
+    float low_ = 0.0f;
+    float high_ = 255.0f;
+    bool initialised_ = false;
+    std::uint32_t phase_ = 0;
+    std::vector<float> samples_;  // finite samples of the last float frame
+};
+
+} // namespace viewportal
+
+#endif // DEPTH_RANGE_H
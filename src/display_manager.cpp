@@ -0,0 +1,186 @@
+#include "display_manager.h"
+#include "buffer_pool.h"
+#include "thread_name.h"
+#include <algorithm>
+#include <set>
+
+namespace viewportal {
+
+namespace {
+
+constexpr auto kPoolTrimInterval = std::chrono::seconds(1);
+constexpr auto kPoolIdleAge = std::chrono::seconds(5);
+
+// Context names in use by the windows of every manager: Pangolin's context map
+// and its "ui.<name>.*" Vars are process-wide, and a ViewPortal built without a
+// manager runs on a private one.
+std::mutex context_names_mutex;
+std::set<std::string> context_names;
+
+/** Reserve the title, or "title (k)" with the smallest free k, for one window. */
+std::string claimContextName(const std::string& title) {
+    std::lock_guard<std::mutex> lock(context_names_mutex);
+    std::string name = title;
+    for (int k = 2; context_names.count(name) != 0; ++k)
+        name = title + " (" + std::to_string(k) + ")";
+    context_names.insert(name);
+    return name;
+}
+
+void releaseContextName(const std::string& name) {
+    std::lock_guard<std::mutex> lock(context_names_mutex);
+    context_names.erase(name);
+}
+
+} // namespace
+
+void DisplayManager::Impl::attach(HostedWindow* window) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        to_attach.push_back(window);
+    }
+    cv.notify_one();
+}
+
+void DisplayManager::Impl::detach(HostedWindow* window) {
+    std::unique_lock<std::mutex> lock(mutex);
+    to_detach.push_back(window);
+    cv.notify_one();
+    detach_cv.wait(lock, [&]() {
+        return std::find(detached.begin(), detached.end(), window) != detached.end();
+    });
+    detached.erase(std::find(detached.begin(), detached.end(), window));
+}
+
+void DisplayManager::Impl::wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake_pending = true;
+    }
+    cv.notify_one();
+}
+
+void DisplayManager::Impl::processRequests(std::unique_lock<std::mutex>& lock) {
+    while (!to_attach.empty()) {
+        HostedWindow* w = to_attach.front();
+        to_attach.pop_front();
+        Entry e;
+        e.window = w;
+        e.context_name = claimContextName(w->title());
+        lock.unlock();
+        e.open = w->open(e.context_name);
+        lock.lock();
+        windows.push_back(e);
+        window_count = windows.size();
+    }
+    while (!to_detach.empty()) {
+        HostedWindow* w = to_detach.front();
+        to_detach.pop_front();
+        auto it = std::find_if(windows.begin(), windows.end(), [w](const Entry& e) { return e.window == w; });
+        if (it != windows.end()) {
+            if (it->open) {
+                lock.unlock();
+                w->close();
+                lock.lock();
+            }
+            releaseContextName(it->context_name);
+            windows.erase(it);
+            window_count = windows.size();
+        }
+        detached.push_back(w);
+        detach_cv.notify_all();
+    }
+}
+
+void DisplayManager::Impl::run() {
+    setThreadName("vp-display");
+    Clock::time_point last_pool_trim = Clock::now();
+    const auto idle_refresh = std::chrono::milliseconds(std::max(1, params.idle_refresh_ms));
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        processRequests(lock);
+        if (stop) break;
+        if (windows.empty()) {
+            cv.wait(lock, [this]() { return stop || !to_attach.empty() || !to_detach.empty(); });
+            continue;
+        }
+        wake_pending = false;
+        lock.unlock();
+
+        // Visit every window once, starting from a rotating offset so that no
+        // window is always drawn first (FinishFrame may block on vsync).
+        bool rendered = false;
+        Clock::time_point next_deadline = Clock::time_point::max();
+        const size_t n = windows.size();
+        for (size_t k = 0; k < n; ++k) {
+            Entry& e = windows[(next_window + k) % n];
+            if (!e.open) continue;
+            const Clock::time_point now = Clock::now();
+            if (e.window->isDirty() || now - e.last_step >= idle_refresh) {
+                e.last_step = now;
+                if (!e.window->step()) {
+                    e.window->close();
+                    e.open = false;
+                    continue;
+                }
+                rendered = true;
+            }
+            next_deadline = std::min(next_deadline, e.last_step + idle_refresh);
+        }
+        next_window = (next_window + 1) % n;
+
+        // Return frame buffers nobody asked for lately (e.g. after a resolution drop)
+        const Clock::time_point now = Clock::now();
+        if (now - last_pool_trim >= kPoolTrimInterval) {
+            last_pool_trim = now;
+            BufferPool::instance().trimIdle(kPoolIdleAge);
+        }
+
+        lock.lock();
+        if (!rendered) {
+            auto woken = [this]() { return stop || wake_pending || !to_attach.empty() || !to_detach.empty(); };
+            // No deadline when every window is closed: sleep until detached or woken
+            if (next_deadline == Clock::time_point::max())
+                cv.wait(lock, woken);
+            else
+                cv.wait_until(lock, next_deadline, woken);
+        }
+    }
+
+    // Manager destroyed while windows are still attached: close them so their
+    // GL resources are released on this thread.
+    for (Entry& e : windows) {
+        if (e.open) {
+            lock.unlock();
+            e.window->close();
+            lock.lock();
+            e.open = false;
+        }
+        releaseContextName(e.context_name);
+    }
+}
+
+DisplayManager::DisplayManager(const DisplayManagerParams& params)
+    : impl_(new Impl)
+{
+    impl_->params = params;
+    impl_->thread = std::thread(&DisplayManager::Impl::run, impl_);
+}
+
+DisplayManager::~DisplayManager() {
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stop = true;
+    }
+    impl_->cv.notify_one();
+    if (impl_->thread.joinable())
+        impl_->thread.join();
+    delete impl_;
+    impl_ = nullptr;
+}
+
+size_t DisplayManager::numWindows() const {
+    return impl_->window_count.load();
+}
+
+} // namespace viewportal
@@ -0,0 +1,99 @@
+#ifndef DISPLAY_MANAGER_H
+#define DISPLAY_MANAGER_H
+
+#include "viewportal.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * A window rendered by a DisplayManager. open(), step() and close() are called
+ * only on the manager's display thread; isDirty() may be called from any thread.
+ */
+struct HostedWindow {
+    virtual ~HostedWindow() = default;
+
+    /**
+     * Create the window and its GL resources under the given (unique) context name.
+     * Return false if initialization failed.
+     */
+    virtual bool open(const std::string& context_name) = 0;
+
+    /**
+     * Render one frame. Return false once the window should close.
+     */
+    virtual bool step() = 0;
+
+    /**
+     * Release GL resources and destroy the window.
+     */
+    virtual void close() = 0;
+
+    /**
+     * Requested window title (used to derive the context name).
+     */
+    virtual std::string title() const = 0;
+
+    /**
+     * True if the window has something new to draw.
+     */
+    virtual bool isDirty() const = 0;
+};
+
+struct DisplayManager::Impl {
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        HostedWindow* window = nullptr;
+        std::string context_name;
+        Clock::time_point last_step;
+        bool open = false;
+    };
+
+    DisplayManagerParams params;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable detach_cv;
+    std::deque<HostedWindow*> to_attach;  // guarded by mutex
+    std::deque<HostedWindow*> to_detach;  // guarded by mutex
+    std::vector<HostedWindow*> detached;  // guarded by mutex; acknowledged detaches
+    bool wake_pending = false;            // guarded by mutex
+    bool stop = false;                    // guarded by mutex
+    std::vector<Entry> windows;           // display thread only
+    size_t next_window = 0;               // display thread only; round-robin start
+    std::atomic<size_t> window_count{0};
+
+    /**
+     * Queue a window for opening on the display thread. The window reports
+     * completion itself (see ViewPortal::Impl::open()).
+     */
+    void attach(HostedWindow* window);
+
+    /**
+     * Close (if still open) and remove a window; blocks until the display thread
+     * has released it.
+     */
+    void detach(HostedWindow* window);
+
+    /**
+     * Wake the display thread because a window became dirty.
+     */
+    void wake();
+
+    void run();
+
+private:
+    void processRequests(std::unique_lock<std::mutex>& lock);
+};
+
+} // namespace viewportal
+
+#endif // DISPLAY_MANAGER_H
@@ -0,0 +1,173 @@
+#include "flow_color.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIEWPORTAL_FLOW_SSE2 1
+#endif
+
+namespace viewportal {
+
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+constexpr int kGridCols = 64;               // samples per sampled row
+constexpr int kGridRows = 48;               // sampled rows per frame
+constexpr float kPercentile = 0.98f;
+constexpr float kSmoothing = 0.15f;         // EMA weight of the newest frame
+constexpr float kMinMagnitude = 1e-3f;      // still scenes: do not amplify sub-pixel noise without bound
+constexpr size_t kMinSamples = 64;
+
+/** Color of one vector given its wheel entry and normalised magnitude. */
+inline void shade(const unsigned char* c, float rad, unsigned char* out) {
+    if (rad <= 1.0f) {
+        for (int k = 0; k < 3; ++k)
+            out[k] = static_cast<unsigned char>(255.0f - rad * (255.0f - c[k]) + 0.5f);
+    } else {
+        for (int k = 0; k < 3; ++k)
+            out[k] = static_cast<unsigned char>(0.75f * c[k] + 0.5f);
+    }
+}
+
+inline int wheelIndex(float u, float v) {
+    const float t = std::atan2(-v, -u) / (2.0f * kPi) + 0.5f;  // [0, 1]
+    return static_cast<int>(t * kFlowWheelSize + 0.5f) & (kFlowWheelSize - 1);
+}
+
+} // namespace
+
+void buildFlowWheelLut(unsigned char* lut) {
+    // Segment lengths chosen by Baker et al. for perceptually even hue steps
+    const int segments[6] = {15, 6, 4, 11, 13, 6};  // RY, YG, GC, CB, BM, MR
+    float wheel[55][3];
+    int n = 0;
+    for (int s = 0; s < 6; ++s) {
+        for (int i = 0; i < segments[s]; ++i, ++n) {
+            const float up = std::floor(255.0f * i / segments[s]);
+            const float r[6] = {255.0f, 255.0f - up, 0.0f, 0.0f, up, 255.0f};
+            const float g[6] = {up, 255.0f, 255.0f, 255.0f - up, 0.0f, 0.0f};
+            const float b[6] = {0.0f, 0.0f, up, 255.0f, 255.0f, 255.0f - up};
+            wheel[n][0] = r[s];
+            wheel[n][1] = g[s];
+            wheel[n][2] = b[s];
+        }
+    }
+    for (int i = 0; i < kFlowWheelSize; ++i) {
+        const float fk = static_cast<float>(i) / kFlowWheelSize * (n - 1);
+        const int k0 = static_cast<int>(fk);
+        const int k1 = (k0 + 1) % n;
+        const float f = fk - k0;
+        for (int c = 0; c < 3; ++c)
+            lut[i * 3 + c] = static_cast<unsigned char>((1.0f - f) * wheel[k0][c] + f * wheel[k1][c] + 0.5f);
+    }
+}
+
+void flowColorRow(const float* uv, int count, float max_magnitude, const unsigned char* wheel_lut, unsigned char* rgb) {
+    static const unsigned char kInvalid[3] = {0, 0, 0};
+    const float inv_max = max_magnitude > 0.0f ? 1.0f / max_magnitude : 0.0f;
+    int i = 0;
+#ifdef VIEWPORTAL_FLOW_SSE2
+    // atan2 by a 7th-order minimax polynomial on [0, 1] plus octant fix-ups
+    // (error ~1e-5 rad, far below one wheel entry)
+    const __m128 v_zero = _mm_setzero_ps();
+    const __m128 v_abs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 v_inf = _mm_set1_ps(INFINITY);
+    const __m128 v_tiny = _mm_set1_ps(1e-30f);
+    const __m128 v_half_pi = _mm_set1_ps(0.5f * kPi);
+    const __m128 v_pi = _mm_set1_ps(kPi);
+    const __m128 v_c0 = _mm_set1_ps(-0.0464964749f);
+    const __m128 v_c1 = _mm_set1_ps(0.15931422f);
+    const __m128 v_c2 = _mm_set1_ps(-0.327622764f);
+    const __m128 v_to_wheel = _mm_set1_ps(kFlowWheelSize / (2.0f * kPi));
+    const __m128 v_wheel_offset = _mm_set1_ps(0.5f * kFlowWheelSize + 0.5f);
+    const __m128 v_inv_max = _mm_set1_ps(inv_max);
+    alignas(16) std::int32_t idx[4];
+    alignas(16) float rad[4];
+    alignas(16) std::int32_t ok[4];
+    for (; i + 4 <= count; i += 4) {
+        const __m128 a = _mm_loadu_ps(uv + 2 * i);
+        const __m128 b = _mm_loadu_ps(uv + 2 * i + 4);
+        const __m128 u = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 v = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        // Direction of (-u, -v)
+        const __m128 x = _mm_sub_ps(v_zero, u);
+        const __m128 y = _mm_sub_ps(v_zero, v);
+        const __m128 ax = _mm_and_ps(x, v_abs);
+        const __m128 ay = _mm_and_ps(y, v_abs);
+        const __m128 q = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), v_tiny));
+        const __m128 s = _mm_mul_ps(q, q);
+        __m128 r = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(v_c0, s), v_c1), s), v_c2), s), q), q);
+        const __m128 steep = _mm_cmpgt_ps(ay, ax);
+        r = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(v_half_pi, r)), _mm_andnot_ps(steep, r));
+        const __m128 left = _mm_cmplt_ps(x, v_zero);
+        r = _mm_or_ps(_mm_and_ps(left, _mm_sub_ps(v_pi, r)), _mm_andnot_ps(left, r));
+        const __m128 down = _mm_cmplt_ps(y, v_zero);
+        r = _mm_or_ps(_mm_and_ps(down, _mm_sub_ps(v_zero, r)), _mm_andnot_ps(down, r));
+        const __m128i k = _mm_and_si128(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, v_to_wheel), v_wheel_offset)),
+                                        _mm_set1_epi32(kFlowWheelSize - 1));
+        // Magnitude; non-finite components make it NaN or inf
+        const __m128 m = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(u, u), _mm_mul_ps(v, v)));
+        const __m128 finite = _mm_cmplt_ps(_mm_and_ps(m, v_abs), v_inf);
+        _mm_store_si128(reinterpret_cast<__m128i*>(idx), k);
+        _mm_store_ps(rad, _mm_mul_ps(m, v_inv_max));
+        _mm_store_si128(reinterpret_cast<__m128i*>(ok), _mm_castps_si128(finite));
+        for (int j = 0; j < 4; ++j) {
+            unsigned char* d = rgb + static_cast<size_t>(i + j) * 3;
+            if (ok[j])
+                shade(wheel_lut + idx[j] * 3, rad[j], d);
+            else
+                std::memcpy(d, kInvalid, 3);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        const float u = uv[2 * i];
+        const float v = uv[2 * i + 1];
+        unsigned char* d = rgb + static_cast<size_t>(i) * 3;
+        const float m = std::sqrt(u * u + v * v);
+        if (!std::isfinite(m)) {
+            std::memcpy(d, kInvalid, 3);
+            continue;
+        }
+        shade(wheel_lut + wheelIndex(u, v) * 3, m * inv_max, d);
+    }
+}
+
+void FlowAutoScale::observe(const void* uv, int width, int height, std::ptrdiff_t row_stride) {
+    if (!uv || width <= 0 || height <= 0) return;
+    const int step_x = std::max(width / kGridCols, 1);
+    const int step_y = std::max(height / kGridRows, 1);
+    // Move the grid each frame so that, over time, every pixel gets sampled
+    const int off_x = static_cast<int>(phase_ % static_cast<std::uint32_t>(step_x));
+    const int off_y = static_cast<int>((phase_ / static_cast<std::uint32_t>(step_x)) % static_cast<std::uint32_t>(step_y));
+    phase_ = phase_ * 1103515245u + 12345u;
+
+    samples_.clear();
+    const auto* base = static_cast<const std::uint8_t*>(uv);
+    for (int y = off_y; y < height; y += step_y) {
+        const float* row = reinterpret_cast<const float*>(base + static_cast<std::ptrdiff_t>(y) * row_stride);
+        for (int x = off_x; x < width; x += step_x) {
+            const float m = std::sqrt(row[2 * x] * row[2 * x] + row[2 * x + 1] * row[2 * x + 1]);
+            if (std::isfinite(m)) samples_.push_back(m);
+        }
+    }
+    if (samples_.size() < kMinSamples) return;
+    const size_t rank = static_cast<size_t>(kPercentile * samples_.size());
+    std::nth_element(samples_.begin(), samples_.begin() + rank, samples_.end());
+    const float m = std::max(samples_[rank], kMinMagnitude);
+    if (!initialised_) {
+        max_magnitude_ = m;
+        initialised_ = true;
+    } else {
+        max_magnitude_ += kSmoothing * (m - max_magnitude_);
+    }
+}
+
+void FlowAutoScale::reset() {
+    max_magnitude_ = 1.0f;
+    initialised_ = false;
+    phase_ = 0;
+}
+
+} // namespace viewportal
@@ -0,0 +1,52 @@
+#ifndef FLOW_COLOR_H
+#define FLOW_COLOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace viewportal {
+
+constexpr int kFlowWheelSize = 256;
+
+/**
+ * Middlebury optical flow color wheel (Baker et al.) sampled at kFlowWheelSize
+ * directions, RGB. Entry i is the hue of vectors with atan2(-v, -u) =
+ * (2 * i / kFlowWheelSize - 1) * pi, so the table wraps around.
+ */
+void buildFlowWheelLut(unsigned char* lut);
+
+/**
+ * Map a row of interleaved (u, v) floats to RGB with the standard flow coding:
+ * hue from the direction, saturation from |(u, v)| / max_magnitude; longer
+ * vectors are darkened. Vectors with NaN or inf components are black. The
+ * direction and magnitude math is vectorised with SSE2 where available.
+ */
+void flowColorRow(const float* uv, int count, float max_magnitude, const unsigned char* wheel_lut, unsigned char* rgb);
+
+/**
+ * Automatic magnitude range for flow coloring: the 98th percentile of the
+ * magnitudes of a sparse sample grid (moving every frame), smoothed with an
+ * exponential moving average so the colors do not flicker.
+ */
+class FlowAutoScale {
+public:
+    /** Sample a top-down Float32x2 frame; row_stride is in bytes. */
+    void observe(const void* uv, int width, int height, std::ptrdiff_t row_stride);
+
+    void reset();
+
+    bool valid() const { return initialised_; }
+    /** Magnitude mapped to full saturation. */
+    float maxMagnitude() const { return max_magnitude_; }
+
+private:
+    float max_magnitude_ = 1.0f;
+    bool initialised_ = false;
+    std::uint32_t phase_ = 0;
+    std::vector<float> samples_;
+};
+
+} // namespace viewportal
+
+#endif // FLOW_COLOR_H
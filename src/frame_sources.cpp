@@ -0,0 +1,331 @@
+#include "viewportal_source.h"
+#include "buffer_pool.h"
+#include "image_format.h"
+#include <pangolin/image/image_io.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace viewportal {
+
+namespace {
+
+/** Steady-clock capture time, the clock sync_timestamps expects. */
+std::int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** A pooled buffer for one packed frame, handed to ViewPortal as the frame's owner. */
+std::shared_ptr<PooledBuffer> frameBuffer(int width, int height, ImageFormat format) {
+    auto buffer = std::make_shared<PooledBuffer>();
+    buffer->resize(static_cast<size_t>(width) * height * bytesPerPixel(format));
+    return buffer;
+}
+
+void describePacked(SourceFrame& out, std::shared_ptr<PooledBuffer> buffer, int width, int height,
+                    ImageFormat format) {
+    out.frame.width = width;
+    out.frame.height = height;
+    out.frame.format = format;
+    out.frame.data = buffer->data();
+    out.frame.row_stride = 0;
+    out.frame.timestamp_ns = nowNs();
+    out.owner = std::move(buffer);
+}
+
+constexpr float kTwoPi = 6.28318530718f;
+
+// SMPTE-style bars, white to black
+constexpr std::uint8_t kBars[8][3] = {
+    {235, 235, 235}, {235, 235, 16}, {16, 235, 235}, {16, 235, 16},
+    {235, 16, 235},  {235, 16, 16},  {16, 16, 235},  {16, 16, 16}};
+
+class TestPatternSource : public FrameSource {
+public:
+    explicit TestPatternSource(const TestPatternParams& params) : params_(params) {}
+
+    bool open(std::string& error) override {
+        if (params_.width <= 0 || params_.height <= 0) {
+            error = "invalid size";
+            return false;
+        }
+        values_.resize(static_cast<size_t>(params_.width));
+        return true;
+    }
+
+    GrabResult grab(SourceFrame& out) override {
+        const int w = params_.width;
+        const int h = params_.height;
+        auto buffer = frameBuffer(w, h, params_.format);
+        const size_t row_bytes = static_cast<size_t>(w) * bytesPerPixel(params_.format);
+        for (int y = 0; y < h; ++y) {
+            std::uint8_t* row = buffer->data() + static_cast<size_t>(y) * row_bytes;
+            // Bars are the same on every row
+            if (y > 0 && params_.pattern == TestPattern::ColorBars) {
+                std::memcpy(row, buffer->data(), row_bytes);
+                continue;
+            }
+            fillValues(y);
+            encodeRow(row, y);
+        }
+        describePacked(out, std::move(buffer), w, h, params_.format);
+        ++frame_;
+        return GrabResult::Frame;
+    }
+
+    double frameRate() const override { return params_.frame_rate; }
+    std::string name() const override { return "test pattern"; }
+
+private:
+    /** Pattern value in [0, 1] of each pixel of row y. */
+    void fillValues(int y) {
+        const int w = params_.width;
+        const int h = params_.height;
+        switch (params_.pattern) {
+            case TestPattern::ColorBars: {
+                const std::uint64_t shift = frame_ * 4;
+                for (int x = 0; x < w; ++x)
+                    values_[x] = static_cast<float>(((x + shift) * 8 / static_cast<std::uint64_t>(w)) % 8) / 7.0f;
+                break;
+            }
+            case TestPattern::Gradient: {
+                const float cx = 0.5f * w, cy = 0.5f * h;
+                const float inv_radius = 2.0f / std::sqrt(static_cast<float>(w) * w + static_cast<float>(h) * h);
+                const float phase = static_cast<float>(frame_ % 120) / 120.0f;
+                const float dy = y - cy;
+                for (int x = 0; x < w; ++x) {
+                    const float dx = x - cx;
+                    const float d = std::sqrt(dx * dx + dy * dy) * inv_radius;
+                    values_[x] = 0.5f + 0.5f * std::cos(kTwoPi * (2.0f * d - phase));
+                }
+                break;
+            }
+            case TestPattern::Checker: {
+                constexpr int kCell = 32;
+                const std::uint64_t yc = (y + frame_ / 2) / kCell;
+                for (int x = 0; x < w; ++x)
+                    values_[x] = static_cast<float>(((x + frame_) / kCell + yc) & 1u);
+                break;
+            }
+        }
+    }
+
+    void encodeRow(std::uint8_t* row, int y) {
+        const int w = params_.width;
+        const int h = params_.height;
+        switch (params_.format) {
+            case ImageFormat::RGB8:
+            case ImageFormat::RGBA8: {
+                const int channels = bytesPerPixel(params_.format);
+                const std::uint8_t blue = static_cast<std::uint8_t>(255 * y / std::max(1, h - 1));
+                for (int x = 0; x < w; ++x, row += channels) {
+                    const float v = values_[x];
+                    if (params_.pattern == TestPattern::ColorBars) {
+                        const std::uint8_t* c = kBars[static_cast<int>(v * 7.0f + 0.5f)];
+                        row[0] = c[0];
+                        row[1] = c[1];
+                        row[2] = c[2];
+                    } else {
+                        row[0] = static_cast<std::uint8_t>(255.0f * v);
+                        row[1] = static_cast<std::uint8_t>(255.0f * (1.0f - v));
+                        row[2] = blue;
+                    }
+                    if (channels == 4) row[3] = 255;
+                }
+                break;
+            }
+            case ImageFormat::Luminance8:
+                for (int x = 0; x < w; ++x)
+                    row[x] = static_cast<std::uint8_t>(255.0f * values_[x]);
+                break;
+            case ImageFormat::Float32: {
+                float* out = reinterpret_cast<float*>(row);
+                for (int x = 0; x < w; ++x)
+                    out[x] = 0.5f + 4.0f * values_[x];
+                break;
+            }
+            case ImageFormat::Float16: {
+                std::uint16_t* out = reinterpret_cast<std::uint16_t*>(row);
+                for (int x = 0; x < w; ++x)
+                    out[x] = floatToHalf(0.5f + 4.0f * values_[x]);
+                break;
+            }
+            case ImageFormat::Float32x2: {
+                // Rotation about the center, up to 16 px at the corners
+                float* out = reinterpret_cast<float*>(row);
+                const float scale = 32.0f / std::max(w, h);
+                const float dy = y - 0.5f * h;
+                for (int x = 0; x < w; ++x) {
+                    const float dx = x - 0.5f * w;
+                    out[2 * x] = -dy * scale * values_[x];
+                    out[2 * x + 1] = dx * scale * values_[x];
+                }
+                break;
+            }
+        }
+    }
+
+    TestPatternParams params_;
+    std::vector<float> values_;
+    std::uint64_t frame_ = 0;
+};
+
+class ImageSequenceSource : public FrameSource {
+public:
+    explicit ImageSequenceSource(const ImageSequenceParams& params) : params_(params) {}
+
+    bool open(std::string& error) override {
+        namespace fs = std::filesystem;
+        static const char* const kExtensions[] = {".png", ".jpg", ".jpeg", ".ppm", ".pgm", ".pnm", ".bmp",
+                                                  ".tga", ".tif", ".tiff", ".exr", ".pfm"};
+        std::error_code ec;
+        files_.clear();
+        for (const fs::directory_entry& entry : fs::directory_iterator(params_.directory, ec)) {
+            if (!entry.is_regular_file(ec)) continue;
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (std::find(std::begin(kExtensions), std::end(kExtensions), ext) != std::end(kExtensions))
+                files_.push_back(entry.path().string());
+        }
+        if (ec) {
+            error = ec.message();
+            return false;
+        }
+        if (files_.empty()) {
+            error = "no images";
+            return false;
+        }
+        std::sort(files_.begin(), files_.end());
+        next_ = 0;
+        return true;
+    }
+
+    GrabResult grab(SourceFrame& out) override {
+        if (next_ >= files_.size()) {
+            if (!params_.loop) return GrabResult::End;
+            next_ = 0;
+        }
+        const std::string& path = files_[next_++];
+        // Throws on unreadable files, which stops the source with the message
+        auto image = std::make_shared<pangolin::TypedImage>(pangolin::LoadImage(path));
+        const int w = static_cast<int>(image->w);
+        const int h = static_cast<int>(image->h);
+        const std::string& fmt = image->fmt.format;
+        if (fmt == "GRAY16LE") {
+            // Depth in sensor units: widen to meters
+            auto buffer = frameBuffer(w, h, ImageFormat::Float32);
+            float* dst = reinterpret_cast<float*>(buffer->data());
+            for (int y = 0; y < h; ++y) {
+                const std::uint16_t* src = reinterpret_cast<const std::uint16_t*>(image->ptr + y * image->pitch);
+                for (int x = 0; x < w; ++x)
+                    *dst++ = src[x] * params_.depth_scale;
+            }
+            describePacked(out, std::move(buffer), w, h, ImageFormat::Float32);
+            return GrabResult::Frame;
+        }
+        ImageFormat format;
+        if (fmt == "GRAY8") format = ImageFormat::Luminance8;
+        else if (fmt == "RGB24") format = ImageFormat::RGB8;
+        else if (fmt == "RGBA32") format = ImageFormat::RGBA8;
+        else if (fmt == "GRAY32F") format = ImageFormat::Float32;
+        else throw std::runtime_error(path + ": unsupported pixel format " + fmt);
+        // Shown in place: the decoded image is the frame's owner
+        out.frame.width = w;
+        out.frame.height = h;
+        out.frame.format = format;
+        out.frame.data = image->ptr;
+        out.frame.row_stride = static_cast<int>(image->pitch);
+        out.frame.timestamp_ns = nowNs();
+        out.owner = std::move(image);
+        return GrabResult::Frame;
+    }
+
+    double frameRate() const override { return params_.frame_rate; }
+    std::string name() const override { return "image sequence " + params_.directory; }
+
+private:
+    ImageSequenceParams params_;
+    std::vector<std::string> files_;
+    size_t next_ = 0;
+};
+
+class RawFileSource : public FrameSource {
+public:
+    explicit RawFileSource(const RawFileParams& params) : params_(params) {}
+
+    bool open(std::string& error) override {
+        if (params_.width <= 0 || params_.height <= 0) {
+            error = "invalid size";
+            return false;
+        }
+        file_.open(params_.path, std::ios::binary);
+        if (!file_) {
+            error = "cannot open";
+            return false;
+        }
+        frame_bytes_ = static_cast<size_t>(params_.width) * params_.height * bytesPerPixel(params_.format);
+        file_.seekg(0, std::ios::end);
+        const std::streamoff size = file_.tellg();
+        const std::streamoff payload = size - static_cast<std::streamoff>(params_.header_bytes);
+        frames_ = payload > 0 ? static_cast<size_t>(payload) / frame_bytes_ : 0;
+        if (frames_ == 0) {
+            error = "no complete frame";
+            file_.close();
+            return false;
+        }
+        file_.seekg(static_cast<std::streamoff>(params_.header_bytes));
+        next_ = 0;
+        return true;
+    }
+
+    GrabResult grab(SourceFrame& out) override {
+        if (next_ == frames_) {
+            if (!params_.loop) return GrabResult::End;
+            file_.clear();
+            file_.seekg(static_cast<std::streamoff>(params_.header_bytes));
+            next_ = 0;
+        }
+        auto buffer = frameBuffer(params_.width, params_.height, params_.format);
+        if (!file_.read(reinterpret_cast<char*>(buffer->data()), static_cast<std::streamsize>(frame_bytes_)))
+            throw std::runtime_error("read failed");
+        ++next_;
+        describePacked(out, std::move(buffer), params_.width, params_.height, params_.format);
+        return GrabResult::Frame;
+    }
+
+    void close() override { file_.close(); }
+
+    double frameRate() const override { return params_.frame_rate; }
+    std::string name() const override { return "raw file " + params_.path; }
+
+private:
+    RawFileParams params_;
+    std::ifstream file_;
+    size_t frame_bytes_ = 0;
+    size_t frames_ = 0;
+    size_t next_ = 0;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> createTestPatternSource(const TestPatternParams& params) {
+    return std::unique_ptr<FrameSource>(new TestPatternSource(params));
+}
+
+std::unique_ptr<FrameSource> createImageSequenceSource(const ImageSequenceParams& params) {
+    return std::unique_ptr<FrameSource>(new ImageSequenceSource(params));
+}
+
+std::unique_ptr<FrameSource> createRawFileSource(const RawFileParams& params) {
+    return std::unique_ptr<FrameSource>(new RawFileSource(params));
+}
+
+} // namespace viewportal
@@ -0,0 +1,84 @@
+#ifndef IMAGE_FORMAT_H
+#define IMAGE_FORMAT_H
+
+#include "viewportal.h"
+#include <cstdint>
+#include <cstring>
+
+namespace viewportal {
+
+inline int bytesPerPixel(ImageFormat fmt) {
+    switch (fmt) {
+        case ImageFormat::RGB8: return 3;
+        case ImageFormat::RGBA8: return 4;
+        case ImageFormat::Luminance8: return 1;
+        case ImageFormat::Float32: return 4;
+        case ImageFormat::Float16: return 2;
+        case ImageFormat::Float32x2: return 8;
+    }
+    return 3;
+}
+
+/** Single-channel float formats (ColoredDepth viewports). */
+inline bool isFloatFormat(ImageFormat fmt) {
+    return fmt == ImageFormat::Float32 || fmt == ImageFormat::Float16;
+}
+
+/** Formats whose bytes must reach the display unchanged (no lossy coding). */
+inline bool isExactFormat(ImageFormat fmt) {
+    return isFloatFormat(fmt) || fmt == ImageFormat::Float32x2;
+}
+
+/** IEEE 754 half to float, including subnormals, inf and NaN. */
+inline float halfToFloat(std::uint16_t h) {
+    const std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000u) << 16;
+    std::uint32_t exp = (h >> 10) & 0x1Fu;
+    std::uint32_t mant = h & 0x3FFu;
+    std::uint32_t bits;
+    if (exp == 0x1Fu) {
+        bits = sign | 0x7F800000u | (mant << 13);  // inf / NaN
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        bits = sign;
+    } else {
+        // Subnormal: normalise the mantissa
+        exp = 113;
+        while ((mant & 0x400u) == 0) {
+            mant <<= 1;
+            --exp;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3FFu) << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/** Float to IEEE 754 half, rounding to nearest; values beyond the half range become inf. */
+inline std::uint16_t floatToHalf(float f) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+    const std::uint32_t exp = (bits >> 23) & 0xFFu;
+    std::uint32_t mant = bits & 0x7FFFFFu;
+    if (exp == 0xFFu) return static_cast<std::uint16_t>(sign | 0x7C00u | (mant != 0 ? 0x200u : 0u));  // inf / NaN
+    const int e = static_cast<int>(exp) - 127 + 15;
+    if (e >= 0x1F) return static_cast<std::uint16_t>(sign | 0x7C00u);
+    if (e <= 0) {
+        if (e < -10) return sign;  // below the smallest subnormal
+        mant |= 0x800000u;
+        const int shift = 14 - e;
+        std::uint32_t half = mant >> shift;
+        if ((mant >> (shift - 1)) & 1u) ++half;
+        return static_cast<std::uint16_t>(sign | half);
+    }
+    // A rounding carry into the exponent still gives the right value
+    std::uint32_t half = (static_cast<std::uint32_t>(e) << 10) | (mant >> 13);
+    if (mant & 0x1000u) ++half;
+    return static_cast<std::uint16_t>(sign | half);
+}
+
+} // namespace viewportal
+
+#endif // IMAGE_FORMAT_H
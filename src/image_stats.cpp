@@ -0,0 +1,259 @@
+#include "image_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIEWPORTAL_STATS_SSE2 1
+#endif
+
+namespace viewportal {
+
+namespace {
+
+// Histogram increments cannot be vectorised; spreading consecutive pixels over
+// four tables breaks the store-to-load dependency on runs of equal values.
+constexpr int kSubTables = 4;
+
+struct Accumulator {
+    std::uint32_t hist[kSubTables][4][kStatsBins];
+    int min[4];
+    int max[4];
+    std::uint64_t sum[4];
+    std::uint64_t zeros = 0;  // single channel only
+};
+
+template <int Channels>
+void histogramPixels(const std::uint8_t* p, size_t pixels, Accumulator& acc) {
+    size_t i = 0;
+    for (; i + kSubTables <= pixels; i += kSubTables) {
+        for (int t = 0; t < kSubTables; ++t, p += Channels)
+            for (int c = 0; c < Channels; ++c)
+                ++acc.hist[t][c][p[c]];
+    }
+    for (; i < pixels; ++i, p += Channels)
+        for (int c = 0; c < Channels; ++c)
+            ++acc.hist[0][c][p[c]];
+}
+
+void histogramBytes(const std::uint8_t* p, size_t pixels, int channels, Accumulator& acc) {
+    switch (channels) {
+        case 1: histogramPixels<1>(p, pixels, acc); break;
+        case 3: histogramPixels<3>(p, pixels, acc); break;
+        case 4: histogramPixels<4>(p, pixels, acc); break;
+        default: break;
+    }
+}
+
+void scalarStats(const std::uint8_t* p, size_t pixels, int channels, bool ignore_zero, Accumulator& acc) {
+    for (size_t i = 0; i < pixels; ++i, p += channels) {
+        for (int c = 0; c < channels; ++c) {
+            const int v = p[c];
+            acc.sum[c] += static_cast<std::uint64_t>(v);
+            acc.max[c] = std::max(acc.max[c], v);
+            if (channels == 1 && v == 0) {
+                ++acc.zeros;
+                if (ignore_zero) continue;
+            }
+            acc.min[c] = std::min(acc.min[c], v);
+        }
+    }
+}
+
+#ifdef VIEWPORTAL_STATS_SSE2
+/**
+ * Min, max, sums and zero count over whole blocks of 16 * channels bytes (one
+ * register period for packed 1, 3 or 4 channel pixels); returns pixels done.
+ * Each register position keeps its own min/max and the lanes are folded to
+ * channels at the end; sums are taken per channel with byte masks and SAD.
+ */
+size_t sse2Stats(const std::uint8_t* p, size_t pixels, int channels, bool ignore_zero, Accumulator& acc) {
+    const int period = channels == 3 ? 3 : 1;  // registers per block
+    const size_t block_pixels = static_cast<size_t>(16 * period / channels);
+    const size_t blocks = pixels / block_pixels;
+    if (blocks == 0) return 0;
+
+    alignas(16) std::uint8_t mask_bytes[3][4][16];
+    for (int r = 0; r < period; ++r)
+        for (int c = 0; c < channels; ++c)
+            for (int i = 0; i < 16; ++i)
+                mask_bytes[r][c][i] = (r * 16 + i) % channels == c ? 0xFF : 0;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i vmin[3], vmax[3], vsum[4];
+    for (int r = 0; r < 3; ++r) {
+        vmin[r] = _mm_set1_epi8(static_cast<char>(0xFF));
+        vmax[r] = zero;
+    }
+    for (int c = 0; c < 4; ++c) vsum[c] = zero;
+    __m128i vzeros = zero;
+
+    for (size_t b = 0; b < blocks; ++b) {
+        for (int r = 0; r < period; ++r) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p) + r);
+            vmax[r] = _mm_max_epu8(vmax[r], v);
+            if (channels == 1) {
+                const __m128i is_zero = _mm_cmpeq_epi8(v, zero);
+                vzeros = _mm_add_epi64(vzeros, _mm_sad_epu8(_mm_and_si128(is_zero, one), zero));
+                vsum[0] = _mm_add_epi64(vsum[0], _mm_sad_epu8(v, zero));
+                // Invalid (zero) depth reads as 255 so it never wins the min
+                vmin[r] = _mm_min_epu8(vmin[r], ignore_zero ? _mm_or_si128(v, is_zero) : v);
+            } else {
+                vmin[r] = _mm_min_epu8(vmin[r], v);
+                for (int c = 0; c < channels; ++c) {
+                    const __m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(mask_bytes[r][c]));
+                    vsum[c] = _mm_add_epi64(vsum[c], _mm_sad_epu8(_mm_and_si128(v, m), zero));
+                }
+            }
+        }
+        p += 16 * period;
+    }
+
+    alignas(16) std::uint8_t lanes_min[16], lanes_max[16];
+    for (int r = 0; r < period; ++r) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes_min), vmin[r]);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes_max), vmax[r]);
+        for (int i = 0; i < 16; ++i) {
+            const int c = (r * 16 + i) % channels;
+            acc.min[c] = std::min(acc.min[c], static_cast<int>(lanes_min[i]));
+            acc.max[c] = std::max(acc.max[c], static_cast<int>(lanes_max[i]));
+        }
+    }
+    alignas(16) std::uint64_t halves[2];
+    for (int c = 0; c < channels; ++c) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(halves), vsum[c]);
+        acc.sum[c] += halves[0] + halves[1];
+    }
+    _mm_store_si128(reinterpret_cast<__m128i*>(halves), vzeros);
+    acc.zeros += halves[0] + halves[1];
+    return blocks * block_pixels;
+}
+#endif
+
+} // namespace
+
+void computeImageStats(const std::uint8_t* pixels, size_t count, int channels, bool ignore_zero, ImageStats& out) {
+    if (channels != 3 && channels != 4) channels = 1;
+    ignore_zero = ignore_zero && channels == 1;
+    Accumulator acc;
+    std::memset(acc.hist, 0, sizeof(acc.hist));
+    for (int c = 0; c < 4; ++c) {
+        acc.min[c] = 255;
+        acc.max[c] = 0;
+        acc.sum[c] = 0;
+    }
+
+    // Statistics and histogram in one pass over cache-sized chunks, so the bytes
+    // are read from memory once
+    constexpr size_t kChunkBytes = 16 * 1024;
+    const size_t chunk_pixels = std::max<size_t>(kChunkBytes / (48 * static_cast<size_t>(channels)), 1) * 48;
+    for (size_t done = 0; done < count;) {
+        const size_t n = std::min(chunk_pixels, count - done);
+        const std::uint8_t* p = pixels + done * channels;
+        size_t simd = 0;
+#ifdef VIEWPORTAL_STATS_SSE2
+        simd = sse2Stats(p, n, channels, ignore_zero, acc);
+#endif
+        scalarStats(p + simd * channels, n - simd, channels, ignore_zero, acc);
+        histogramBytes(p, n, channels, acc);
+        done += n;
+    }
+
+    out.channels = channels;
+    out.samples = count;
+    out.valid = ignore_zero ? count - acc.zeros : count;
+    out.histogram.assign(static_cast<size_t>(channels) * kStatsBins, 0);
+    for (int c = 0; c < channels; ++c) {
+        std::uint32_t* h = out.histogram.data() + static_cast<size_t>(c) * kStatsBins;
+        for (int t = 0; t < kSubTables; ++t)
+            for (int b = 0; b < kStatsBins; ++b)
+                h[b] += acc.hist[t][c][b];
+        const std::uint64_t n = ignore_zero ? out.valid : count;
+        const bool any = n > 0;
+        out.min[c] = any ? static_cast<float>(acc.min[c]) : 0.0f;
+        out.max[c] = any ? static_cast<float>(acc.max[c]) : 0.0f;
+        out.mean[c] = any ? static_cast<float>(static_cast<double>(acc.sum[c]) / static_cast<double>(n)) : 0.0f;
+    }
+    for (int c = channels; c < 4; ++c) {
+        out.min[c] = out.max[c] = 0.0f;
+        out.mean[c] = 0.0f;
+    }
+    out.hist_low = 0.0f;
+    out.hist_high = static_cast<float>(kStatsBins);
+}
+
+void computeFloatStats(const float* values, size_t count, ImageStats& out) {
+    float lo = INFINITY, hi = -INFINITY;
+    double sum = 0.0;
+    std::uint64_t valid = 0;
+    size_t i = 0;
+#ifdef VIEWPORTAL_STATS_SSE2
+    {
+        const __m128 v_inf = _mm_set1_ps(INFINITY);
+        const __m128 v_ninf = _mm_set1_ps(-INFINITY);
+        const __m128 v_abs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 vmin = v_inf, vmax = v_ninf;
+        __m128d vsum = _mm_setzero_pd();
+        for (; i + 4 <= count; i += 4) {
+            const __m128 v = _mm_loadu_ps(values + i);
+            // Finite lanes only: NaN compares false, |inf| is not below inf
+            const __m128 finite = _mm_cmplt_ps(_mm_and_ps(v, v_abs), v_inf);
+            vmin = _mm_min_ps(vmin, _mm_or_ps(_mm_and_ps(finite, v), _mm_andnot_ps(finite, v_inf)));
+            vmax = _mm_max_ps(vmax, _mm_or_ps(_mm_and_ps(finite, v), _mm_andnot_ps(finite, v_ninf)));
+            const __m128 kept = _mm_and_ps(finite, v);
+            // Sum in double: float lanes would drift over a few hundred thousand samples
+            vsum = _mm_add_pd(vsum, _mm_cvtps_pd(kept));
+            vsum = _mm_add_pd(vsum, _mm_cvtps_pd(_mm_movehl_ps(kept, kept)));
+            static const int kBits[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+            valid += static_cast<std::uint64_t>(kBits[_mm_movemask_ps(finite)]);
+        }
+        alignas(16) float lanes_min[4], lanes_max[4];
+        alignas(16) double halves[2];
+        _mm_store_ps(lanes_min, vmin);
+        _mm_store_ps(lanes_max, vmax);
+        _mm_store_pd(halves, vsum);
+        for (int l = 0; l < 4; ++l) {
+            lo = std::min(lo, lanes_min[l]);
+            hi = std::max(hi, lanes_max[l]);
+        }
+        sum += halves[0] + halves[1];
+    }
+#endif
+    for (; i < count; ++i) {
+        const float v = values[i];
+        if (!std::isfinite(v)) continue;
+        lo = std::min(lo, v);
+        hi = std::max(hi, v);
+        sum += v;
+        ++valid;
+    }
+
+    out.channels = 1;
+    out.samples = count;
+    out.valid = valid;
+    out.histogram.assign(kStatsBins, 0);
+    for (int c = 0; c < 4; ++c) {
+        out.min[c] = out.max[c] = 0.0f;
+        out.mean[c] = 0.0f;
+    }
+    out.hist_low = 0.0f;
+    out.hist_high = 1.0f;
+    if (valid == 0) return;
+    out.min[0] = lo;
+    out.max[0] = hi;
+    out.mean[0] = static_cast<float>(sum / static_cast<double>(valid));
+    out.hist_low = lo;
+    out.hist_high = hi;
+
+    const float scale = hi > lo ? kStatsBins / (hi - lo) : 0.0f;
+    std::uint32_t* h = out.histogram.data();
+    for (size_t k = 0; k < count; ++k) {
+        const float v = values[k];
+        if (!std::isfinite(v)) continue;
+        const int b = static_cast<int>((v - lo) * scale);
+        ++h[std::min(b, kStatsBins - 1)];
+    }
+}
+
+} // namespace viewportal
@@ -0,0 +1,27 @@
+#ifndef IMAGE_STATS_H
+#define IMAGE_STATS_H
+
+#include "viewportal.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace viewportal {
+
+constexpr int kStatsBins = 256;
+
+/**
+ * Compute histogram, min/max/mean and valid count of a run of packed pixels.
+ * With ignore_zero (depth), zero samples are invalid: they are counted in bin 0
+ * but excluded from min and mean. SSE2 where available.
+ */
+void computeImageStats(const std::uint8_t* pixels, size_t count, int channels, bool ignore_zero, ImageStats& out);
+
+/**
+ * As computeImageStats() for single-channel float samples. NaN and +/-inf are
+ * invalid; the histogram spans the valid [min, max].
+ */
+void computeFloatStats(const float* values, size_t count, ImageStats& out);
+
+} // namespace viewportal
+
+#endif // IMAGE_STATS_H
@@ -0,0 +1,133 @@
+#include "image_zoom.h"
+#include <algorithm>
+
+namespace viewportal {
+
+namespace {
+
+constexpr float kZoomStep = 1.2f;
+constexpr float kMaxZoom = 256.0f;
+
+} // namespace
+
+void ImageZoom::setImageSize(int width, int height) {
+    if (width == width_ && height == height_) return;
+    width_ = width;
+    height_ = height;
+    zoom_ = 1.0f;
+    cx_ = width_ * 0.5f;
+    cy_ = height_ * 0.5f;
+}
+
+ImageRegion ImageZoom::region() const {
+    ImageRegion r;
+    const float hw = width_ * 0.5f / zoom_;
+    const float hh = height_ * 0.5f / zoom_;
+    r.x0 = cx_ - hw;
+    r.x1 = cx_ + hw;
+    r.y0 = cy_ - hh;
+    r.y1 = cy_ + hh;
+    return r;
+}
+
+void ImageZoom::clampCenter() {
+    const float hw = width_ * 0.5f / zoom_;
+    const float hh = height_ * 0.5f / zoom_;
+    cx_ = std::clamp(cx_, hw, width_ - hw);
+    cy_ = std::clamp(cy_, hh, height_ - hh);
+}
+
+void ImageZoom::zoomAt(const pangolin::View& view, float x, float y, float factor) {
+    if (width_ <= 0 || height_ <= 0 || view.v.w <= 0 || view.v.h <= 0) return;
+    // Image point under the cursor stays fixed
+    float px = 0.0f, py = 0.0f;
+    viewToImage(view, region(), x, y, px, py);
+    const float new_zoom = std::clamp(zoom_ * factor, 1.0f, kMaxZoom);
+    cx_ = px + (cx_ - px) * zoom_ / new_zoom;
+    cy_ = py + (cy_ - py) * zoom_ / new_zoom;
+    zoom_ = new_zoom;
+    clampCenter();
+}
+
+void ImageZoom::Mouse(pangolin::View& view, pangolin::MouseButton button, int x, int y, bool pressed, int button_state) {
+    (void)button_state;
+    if (button == pangolin::MouseWheelUp && pressed) {
+        zoomAt(view, static_cast<float>(x), static_cast<float>(y), kZoomStep);
+    } else if (button == pangolin::MouseWheelDown && pressed) {
+        zoomAt(view, static_cast<float>(x), static_cast<float>(y), 1.0f / kZoomStep);
+    } else if (button == pangolin::MouseButtonLeft) {
+        dragging_ = pressed;
+        last_x_ = x;
+        last_y_ = y;
+    } else if (button == pangolin::MouseButtonRight && pressed) {
+        zoom_ = 1.0f;
+        cx_ = width_ * 0.5f;
+        cy_ = height_ * 0.5f;
+    }
+}
+
+void ImageZoom::MouseMotion(pangolin::View& view, int x, int y, int button_state) {
+    (void)button_state;
+    if (!dragging_ || view.v.w <= 0 || view.v.h <= 0) return;
+    const ImageRegion r = region();
+    cx_ -= (x - last_x_) * (r.x1 - r.x0) / view.v.w;
+    cy_ += (y - last_y_) * (r.y1 - r.y0) / view.v.h;
+    last_x_ = x;
+    last_y_ = y;
+    clampCenter();
+}
+
+void ImageZoom::Special(pangolin::View& view, pangolin::InputSpecial type, float x, float y,
+                        float p1, float p2, float p3, float p4, int button_state) {
+    (void)p1; (void)p3; (void)p4; (void)button_state;
+    if (type == pangolin::InputSpecialScroll && p2 != 0.0f)
+        zoomAt(view, x, y, p2 > 0.0f ? kZoomStep : 1.0f / kZoomStep);
+}
+
+bool viewToImage(const pangolin::View& view, const ImageRegion& region, float x, float y,
+                 float& image_x, float& image_y) {
+    if (view.v.w <= 0 || view.v.h <= 0) return false;
+    const float u = (x - view.v.l) / view.v.w;
+    const float v = (y - view.v.b) / view.v.h;  // Pangolin y is bottom-up
+    image_x = region.x0 + u * (region.x1 - region.x0);
+    image_y = region.y0 + (1.0f - v) * (region.y1 - region.y0);
+    return u >= 0.0f && u < 1.0f && v >= 0.0f && v < 1.0f;
+}
+
+void renderTextureRegion(const pangolin::GlTexture& texture, const ImageRegion& region, bool bottom_up) {
+    if (texture.width <= 0 || texture.height <= 0) return;
+    const GLfloat u0 = region.x0 / texture.width;
+    const GLfloat u1 = region.x1 / texture.width;
+    GLfloat v0 = region.y0 / texture.height;
+    GLfloat v1 = region.y1 / texture.height;
+    if (bottom_up) {
+        v0 = 1.0f - v0;
+        v1 = 1.0f - v1;
+    }
+    const GLfloat sq_vert[] = {-1, -1, 1, -1, 1, 1, -1, 1};
+    const GLfloat sq_tex[] = {u0, v1, u1, v1, u1, v0, u0, v0};
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, sq_vert);
+    glTexCoordPointer(2, GL_FLOAT, 0, sq_tex);
+    glEnable(GL_TEXTURE_2D);
+    texture.Bind();
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    glDisable(GL_TEXTURE_2D);
+    glPopClientAttrib();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+} // namespace viewportal
@@ -0,0 +1,70 @@
+#ifndef IMAGE_ZOOM_H
+#define IMAGE_ZOOM_H
+
+#include <pangolin/gl/gl.h>
+#include <pangolin/handler/handler.h>
+
+namespace viewportal {
+
+/**
+ * Visible part of an image, in image pixels (top-left origin, y down).
+ */
+struct ImageRegion {
+    float x0 = 0.0f;
+    float y0 = 0.0f;
+    float x1 = 1.0f;
+    float y1 = 1.0f;
+};
+
+/**
+ * Zoom and pan state of an image viewport, and the Pangolin handler that edits it:
+ * scroll zooms around the cursor, left-drag pans, right-click resets. Zoom 1 shows
+ * the whole image; the visible region always stays inside the image.
+ */
+class ImageZoom : public pangolin::Handler {
+public:
+    /**
+     * Set the size of the displayed image; resets the view if the size changed.
+     */
+    void setImageSize(int width, int height);
+
+    ImageRegion region() const;
+    float zoom() const { return zoom_; }
+    bool isZoomed() const { return zoom_ > 1.0f; }
+
+    void Mouse(pangolin::View& view, pangolin::MouseButton button, int x, int y, bool pressed, int button_state) override;
+    void MouseMotion(pangolin::View& view, int x, int y, int button_state) override;
+    void Special(pangolin::View& view, pangolin::InputSpecial type, float x, float y,
+                 float p1, float p2, float p3, float p4, int button_state) override;
+
+private:
+    void zoomAt(const pangolin::View& view, float x, float y, float factor);
+    void clampCenter();
+
+    int width_ = 0;
+    int height_ = 0;
+    float zoom_ = 1.0f;
+    float cx_ = 0.0f;
+    float cy_ = 0.0f;
+    bool dragging_ = false;
+    int last_x_ = 0;
+    int last_y_ = 0;
+};
+
+/**
+ * Map a window position (Pangolin pixels, y up) to image pixels, for a view
+ * showing region. \return false if the position is outside the view.
+ */
+bool viewToImage(const pangolin::View& view, const ImageRegion& region, float x, float y,
+                 float& image_x, float& image_y);
+
+/**
+ * Draw the given region of a texture over the whole active view. Rows are stored
+ * top-first unless bottom_up is set. Equivalent to RenderToViewportFlipY() (or
+ * RenderToViewport() when bottom-up) for the full region.
+ */
+void renderTextureRegion(const pangolin::GlTexture& texture, const ImageRegion& region, bool bottom_up = false);
+
+} // namespace viewportal
+
+#endif // IMAGE_ZOOM_H
@@ -0,0 +1,78 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include "viewportal.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Latencies counted in 50 us buckets up to 200 ms (longer ones share the last
+ * bucket), plus the exact maximum: percentiles without keeping every sample.
+ * Not thread-safe.
+ */
+class LatencyHistogram {
+public:
+    void record(std::int64_t ns) {
+        if (ns < 0) ns = 0;
+        if (buckets_.empty()) buckets_.assign(kBuckets, 0);
+        const size_t bucket = std::min(static_cast<size_t>(ns / kBucketNs), kBuckets - 1);
+        ++buckets_[bucket];
+        ++count_;
+        max_ns_ = std::max(max_ns_, ns);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        if (other.count_ == 0) return;
+        if (buckets_.empty()) buckets_.assign(kBuckets, 0);
+        for (size_t i = 0; i < kBuckets; ++i)
+            buckets_[i] += other.buckets_[i];
+        count_ += other.count_;
+        max_ns_ = std::max(max_ns_, other.max_ns_);
+    }
+
+    void reset() {
+        std::fill(buckets_.begin(), buckets_.end(), 0);
+        count_ = 0;
+        max_ns_ = 0;
+    }
+
+    /** Summary in milliseconds; a percentile is the upper edge of its bucket, capped at the maximum. */
+    LatencyStats stats() const {
+        LatencyStats s;
+        s.count = count_;
+        if (count_ == 0) return s;
+        s.p50_ms = percentileMs(0.50);
+        s.p90_ms = percentileMs(0.90);
+        s.p99_ms = percentileMs(0.99);
+        s.max_ms = static_cast<double>(max_ns_) * 1e-6;
+        return s;
+    }
+
+private:
+    static constexpr std::int64_t kBucketNs = 50000;
+    static constexpr size_t kBuckets = 4000;
+
+    double percentileMs(double q) const {
+        const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(q * static_cast<double>(count_) + 0.5));
+        std::uint64_t seen = 0;
+        size_t i = 0;
+        for (; i < kBuckets; ++i) {
+            seen += buckets_[i];
+            if (seen >= rank) break;
+        }
+        const std::int64_t edge = std::min(static_cast<std::int64_t>(i + 1) * kBucketNs, max_ns_);
+        return static_cast<double>(edge) * 1e-6;
+    }
+
+    std::vector<std::uint64_t> buckets_;  // allocated with the first sample
+    std::uint64_t count_ = 0;
+    std::int64_t max_ns_ = 0;
+};
+
+} // namespace viewportal
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,124 @@
+#include "shm_consumer.h"
+#include "shm_ring.h"
+#include "thread_name.h"
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+namespace viewportal {
+
+namespace {
+
+// Frame polling period; short enough to add well under a display frame of latency
+constexpr std::chrono::microseconds kPollInterval(1000);
+// How often the ring name is checked for a new producer
+constexpr std::chrono::milliseconds kReattachInterval(250);
+
+/**
+ * Map the segment behind a ring name, sharing the mapping with every follower of
+ * that segment in this process (two viewports, a re-attached ring, another
+ * window). Reader counts are reset only when the process first maps a segment,
+ * voiding leases left by a viewer that died; a segment already mapped here has
+ * live leases that must keep counting.
+ */
+std::shared_ptr<shm::Mapping> openRing(const std::string& name) {
+    static std::mutex mutex;
+    static std::map<std::uint64_t, std::weak_ptr<shm::Mapping>> mapped;
+    std::shared_ptr<shm::Mapping> mapping = shm::Mapping::open(name);
+    if (!mapping) return nullptr;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = mapped.begin(); it != mapped.end();)
+        it = it->second.expired() ? mapped.erase(it) : std::next(it);
+    std::weak_ptr<shm::Mapping>& entry = mapped[mapping->id()];
+    if (std::shared_ptr<shm::Mapping> shared = entry.lock()) return shared;
+    for (std::uint32_t i = 0; i < mapping->header().slot_count; ++i)
+        mapping->slot(i).readers.store(0);
+    entry = mapping;
+    return mapping;
+}
+
+} // namespace
+
+ShmConsumer::ShmConsumer(Deliver deliver) : deliver_(std::move(deliver)) {
+    thread_ = std::thread(&ShmConsumer::run, this);
+}
+
+ShmConsumer::~ShmConsumer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+void ShmConsumer::attach(size_t viewport, const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [&](const Ring& r) { return r.viewport == viewport; }),
+                 rings_.end());
+    Ring ring;
+    ring.viewport = viewport;
+    ring.name = name;
+    rings_.push_back(std::move(ring));
+    wake_.notify_all();
+}
+
+void ShmConsumer::detach(size_t viewport) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [&](const Ring& r) { return r.viewport == viewport; }),
+                 rings_.end());
+}
+
+void ShmConsumer::run() {
+    setThreadName("vp-shm");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        const Clock::time_point now = Clock::now();
+        for (Ring& ring : rings_)
+            poll(ring, now);
+        wake_.wait_for(lock, kPollInterval);
+    }
+}
+
+void ShmConsumer::poll(Ring& ring, Clock::time_point now) {
+    if (now >= ring.next_check) {
+        ring.next_check = now + kReattachInterval;
+        std::uint64_t id = 0;
+        if (shm::Mapping::segmentId(ring.name, id) && (!ring.mapping || id != ring.mapping->id())) {
+            std::shared_ptr<shm::Mapping> mapping = openRing(ring.name);
+            if (mapping && !mapping->header().closed.load()) {
+                ring.mapping = std::move(mapping);
+                ring.last = 0;
+            }
+        }
+    }
+    if (!ring.mapping) return;
+    deliverLatest(ring);
+    // A producer that closed the ring has delivered its last frame: let the
+    // segment go once the display is done with it, and wait for a new one
+    if (ring.mapping->header().closed.load()) ring.mapping.reset();
+}
+
+void ShmConsumer::deliverLatest(Ring& ring) {
+    shm::Mapping& m = *ring.mapping;
+    const std::uint64_t latest = m.header().latest.load();
+    if (latest == 0 || latest == ring.last) return;
+    const std::uint32_t index = static_cast<std::uint32_t>(latest % m.header().slot_count);
+    shm::SlotHeader& slot = m.slot(index);
+    // Lease first, then confirm the slot still holds that frame (see shm_ring.h)
+    slot.readers.fetch_add(1);
+    FrameData frame;
+    if (slot.state.load() != latest * 2 || !m.slotFrame(index, frame)) {
+        slot.readers.fetch_sub(1);
+        if (slot.state.load() == latest * 2) ring.last = latest;  // malformed frame: skip it
+        return;
+    }
+    ring.last = latest;
+    std::shared_ptr<shm::Mapping> mapping = ring.mapping;
+    std::shared_ptr<const void> lease(frame.data, [mapping, index](const void*) {
+        mapping->slot(index).readers.fetch_sub(1);
+    });
+    deliver_(ring.viewport, frame, std::move(lease), static_cast<int>(m.header().slot_count));
+}
+
+} // namespace viewportal
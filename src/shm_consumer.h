@@ -0,0 +1,70 @@
+#ifndef SHM_CONSUMER_H
+#define SHM_CONSUMER_H
+
+#include "viewportal.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace viewportal {
+
+namespace shm {
+class Mapping;
+}
+
+/**
+ * Follows shared-memory frame rings (see ShmFrameProducer) and hands each new
+ * frame to a callback in place: the frame points into the ring and the lease
+ * passed along keeps its slot from being rewritten until the lease is dropped.
+ * One thread polls every attached ring; it opens a ring once its producer
+ * appears and switches to the new segment when a producer restarts, keeping the
+ * old mapping until all its leases are gone. A ring its producer closed is let
+ * go the same way.
+ */
+class ShmConsumer {
+public:
+    /** slot_count is the ring's, for callers that hold several leases at once. */
+    using Deliver = std::function<void(size_t viewport, const FrameData& frame, std::shared_ptr<const void> lease,
+                                       int slot_count)>;
+
+    explicit ShmConsumer(Deliver deliver);
+    ~ShmConsumer();
+
+    ShmConsumer(const ShmConsumer&) = delete;
+    ShmConsumer& operator=(const ShmConsumer&) = delete;
+
+    /** Follow the named ring for a viewport, replacing its previous ring. */
+    void attach(size_t viewport, const std::string& name);
+    void detach(size_t viewport);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Ring {
+        size_t viewport = 0;
+        std::string name;
+        std::shared_ptr<shm::Mapping> mapping;
+        std::uint64_t last = 0;          // last frame delivered
+        Clock::time_point next_check;    // next look for a new segment under the name
+    };
+
+    void run();
+    void poll(Ring& ring, Clock::time_point now);
+    void deliverLatest(Ring& ring);
+
+    Deliver deliver_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Ring> rings_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace viewportal
+
+#endif // SHM_CONSUMER_H
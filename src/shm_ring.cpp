@@ -0,0 +1,258 @@
+#include "shm_ring.h"
+#include "viewportal_shm.h"
+#include "image_format.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace viewportal {
+namespace shm {
+
+namespace {
+
+size_t pageAlign(size_t bytes) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (bytes + page - 1) / page * page;
+}
+
+size_t frameSpan(int width, int height, int bpp, int row_stride) {
+    const size_t row_bytes = static_cast<size_t>(width) * bpp;
+    if (row_stride == 0) return row_bytes * static_cast<size_t>(height);
+    return static_cast<size_t>(height - 1) * static_cast<size_t>(std::abs(row_stride)) + row_bytes;
+}
+
+} // namespace
+
+std::string segmentName(const std::string& name) {
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+int formatBytes(std::int32_t format) {
+    if (format < 0 || format > static_cast<std::int32_t>(ImageFormat::Float32x2)) return 0;
+    return bytesPerPixel(static_cast<ImageFormat>(format));
+}
+
+Mapping::~Mapping() {
+    if (base_) munmap(base_, size_);
+}
+
+std::shared_ptr<Mapping> Mapping::create(const std::string& name, std::uint32_t slot_count, std::uint64_t slot_bytes,
+                                         std::string& error) {
+    const std::string seg = segmentName(name);
+    shm_unlink(seg.c_str());  // a ring left behind by a crashed producer
+    const int fd = shm_open(seg.c_str(), O_RDWR | O_CREAT | O_EXCL, 0660);
+    if (fd < 0) {
+        error = seg + ": " + std::strerror(errno);
+        return nullptr;
+    }
+    slot_bytes = pageAlign(slot_bytes);
+    const size_t payload_offset = pageAlign(sizeof(RingHeader) + slot_count * sizeof(SlotHeader));
+    const size_t size = payload_offset + slot_count * slot_bytes;
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0 && fstat(fd, &st) == 0)
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        error = seg + ": " + std::strerror(errno);
+        ::close(fd);
+        shm_unlink(seg.c_str());
+        return nullptr;
+    }
+    ::close(fd);
+
+    std::shared_ptr<Mapping> m(new Mapping());
+    m->base_ = base;
+    m->size_ = size;
+    m->id_ = (static_cast<std::uint64_t>(st.st_dev) << 32) ^ static_cast<std::uint64_t>(st.st_ino);
+
+    RingHeader* h = new (base) RingHeader();
+    h->version = kVersion;
+    h->slot_count = slot_count;
+    h->slot_bytes = slot_bytes;
+    h->payload_offset = payload_offset;
+    h->latest.store(0);
+    h->closed.store(0);
+    for (std::uint32_t i = 0; i < slot_count; ++i) {
+        SlotHeader* s = new (&m->slot(i)) SlotHeader();
+        s->state.store(0);
+        s->readers.store(0);
+    }
+    // The magic goes in last: a consumer that sees it sees an initialised ring
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(h->magic, kMagic, sizeof(kMagic));
+    return m;
+}
+
+std::shared_ptr<Mapping> Mapping::open(const std::string& name) {
+    const int fd = shm_open(segmentName(name).c_str(), O_RDWR, 0);
+    if (fd < 0) return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RingHeader)) {
+        ::close(fd);
+        return nullptr;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) return nullptr;
+
+    std::shared_ptr<Mapping> m(new Mapping());
+    m->base_ = base;
+    m->size_ = size;
+    m->id_ = (static_cast<std::uint64_t>(st.st_dev) << 32) ^ static_cast<std::uint64_t>(st.st_ino);
+
+    // Validate against the mapped size so a foreign or half-written segment is rejected
+    const RingHeader& h = m->header();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0) return nullptr;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (h.version != kVersion || h.slot_count == 0 || h.slot_count > 1024 ||
+        h.payload_offset < sizeof(RingHeader) + h.slot_count * sizeof(SlotHeader) ||
+        h.payload_offset + h.slot_count * h.slot_bytes > size)
+        return nullptr;
+    return m;
+}
+
+bool Mapping::segmentId(const std::string& name, std::uint64_t& id) {
+    const int fd = shm_open(segmentName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat st;
+    const bool ok = fstat(fd, &st) == 0;
+    ::close(fd);
+    if (ok) id = (static_cast<std::uint64_t>(st.st_dev) << 32) ^ static_cast<std::uint64_t>(st.st_ino);
+    return ok;
+}
+
+bool Mapping::slotFrame(std::uint32_t i, FrameData& frame) {
+    const SlotHeader& s = slot(i);
+    const int bpp = formatBytes(s.format);
+    if (bpp == 0 || s.width <= 0 || s.height <= 0) return false;
+    const std::int64_t row_bytes = static_cast<std::int64_t>(s.width) * bpp;
+    if (s.row_stride != 0 && std::abs(static_cast<std::int64_t>(s.row_stride)) < row_bytes) return false;
+    const size_t span = frameSpan(s.width, s.height, bpp, s.row_stride);
+    const size_t lowest = s.row_stride < 0 ? static_cast<size_t>(s.height - 1) * static_cast<size_t>(-s.row_stride) : 0;
+    if (s.data_offset < lowest || s.data_offset - lowest + span > header().slot_bytes) return false;
+    frame.width = s.width;
+    frame.height = s.height;
+    frame.format = static_cast<ImageFormat>(s.format);
+    frame.row_stride = s.row_stride;
+    frame.data = payload(i) + s.data_offset;
+    frame.timestamp_ns = static_cast<std::int64_t>(s.timestamp_ns);
+    return true;
+}
+
+} // namespace shm
+
+struct ShmFrameProducer::Impl {
+    std::shared_ptr<shm::Mapping> ring;
+    std::string name;
+    std::uint64_t next = 1;          // number of the next frame
+    std::uint32_t pending_slot = 0;
+    std::uint64_t pending_frame = 0; // 0 = no frame reserved
+};
+
+ShmFrameProducer::ShmFrameProducer() : impl_(new Impl()) {}
+
+ShmFrameProducer::~ShmFrameProducer() {
+    close();
+    delete impl_;
+}
+
+bool ShmFrameProducer::open(const std::string& name, const ShmRingParams& params, std::string* error) {
+    close();
+    std::string message;
+    const std::uint32_t slots = static_cast<std::uint32_t>(std::max(3, std::min(params.slot_count, 1024)));
+    impl_->ring = shm::Mapping::create(name, slots, std::max<size_t>(params.slot_bytes, 1), message);
+    if (!impl_->ring) {
+        if (error) *error = message;
+        return false;
+    }
+    impl_->name = name;
+    impl_->next = 1;
+    impl_->pending_frame = 0;
+    return true;
+}
+
+void ShmFrameProducer::close() {
+    if (!impl_->ring) return;
+    impl_->ring->header().closed.store(1);
+    shm_unlink(shm::segmentName(impl_->name).c_str());  // attached viewers keep their mapping
+    impl_->ring.reset();
+    impl_->pending_frame = 0;
+}
+
+bool ShmFrameProducer::isOpen() const {
+    return impl_->ring != nullptr;
+}
+
+void* ShmFrameProducer::beginFrame(int width, int height, ImageFormat format, int row_stride) {
+    shm::Mapping* ring = impl_->ring.get();
+    const int bpp = shm::formatBytes(static_cast<std::int32_t>(format));
+    if (!ring || width <= 0 || height <= 0 || bpp == 0) return nullptr;
+    const std::int64_t row_bytes = static_cast<std::int64_t>(width) * bpp;
+    if (row_stride != 0 && std::abs(static_cast<std::int64_t>(row_stride)) < row_bytes) return nullptr;
+    if (shm::frameSpan(width, height, bpp, row_stride) > ring->header().slot_bytes) return nullptr;
+
+    const std::uint32_t count = ring->header().slot_count;
+    std::uint32_t index = impl_->pending_slot;
+    if (impl_->pending_frame == 0) {
+        // Claim the next slot no reader holds. Marking it before checking readers
+        // pairs with the reader's lease-then-check, so one side always backs off.
+        bool claimed = false;
+        for (std::uint32_t attempt = 0; attempt < count && !claimed; ++attempt, ++impl_->next) {
+            index = static_cast<std::uint32_t>(impl_->next % count);
+            shm::SlotHeader& s = ring->slot(index);
+            const std::uint64_t previous = s.state.load();
+            s.state.store(impl_->next * 2 + 1);
+            if (s.readers.load() == 0) {
+                claimed = true;
+                impl_->pending_frame = impl_->next;
+            } else {
+                s.state.store(previous);
+            }
+        }
+        if (!claimed) return nullptr;
+        impl_->pending_slot = index;
+    }
+
+    shm::SlotHeader& s = ring->slot(index);
+    s.width = width;
+    s.height = height;
+    s.format = static_cast<std::int32_t>(format);
+    s.row_stride = row_stride;
+    s.data_offset = row_stride < 0 ? static_cast<std::uint64_t>(height - 1) * static_cast<std::uint64_t>(-row_stride) : 0;
+    return ring->payload(index) + s.data_offset;
+}
+
+void ShmFrameProducer::commitFrame(std::uint64_t timestamp_ns) {
+    shm::Mapping* ring = impl_->ring.get();
+    if (!ring || impl_->pending_frame == 0) return;
+    shm::SlotHeader& s = ring->slot(impl_->pending_slot);
+    s.timestamp_ns = timestamp_ns;
+    s.state.store(impl_->pending_frame * 2);
+    ring->header().latest.store(impl_->pending_frame);
+    impl_->pending_frame = 0;
+}
+
+bool ShmFrameProducer::writeFrame(const FrameData& frame, std::uint64_t timestamp_ns) {
+    if (!frame.data) return false;
+    std::uint8_t* dst = static_cast<std::uint8_t*>(beginFrame(frame.width, frame.height, frame.format));
+    if (!dst) return false;
+    const size_t row_bytes = static_cast<size_t>(frame.width) * shm::formatBytes(static_cast<std::int32_t>(frame.format));
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(frame.data);
+    if (frame.row_stride == 0 || frame.row_stride == static_cast<int>(row_bytes)) {
+        std::memcpy(dst, src, row_bytes * static_cast<size_t>(frame.height));
+    } else {
+        for (int y = 0; y < frame.height; ++y)
+            std::memcpy(dst + static_cast<size_t>(y) * row_bytes, src + static_cast<std::ptrdiff_t>(y) * frame.row_stride, row_bytes);
+    }
+    commitFrame(timestamp_ns != 0 ? timestamp_ns : static_cast<std::uint64_t>(frame.timestamp_ns));
+    return true;
+}
+
+} // namespace viewportal
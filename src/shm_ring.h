@@ -0,0 +1,102 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include "viewportal.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace viewportal {
+namespace shm {
+
+/**
+ * Layout of a frame ring in POSIX shared memory:
+ *   RingHeader | SlotHeader x slot_count | slot payloads (page-aligned, slot_bytes each)
+ *
+ * Slots are written without locks. Frame n goes to slot n % slot_count. The
+ * producer marks the slot as being written (odd state), checks that no reader
+ * holds it, fills it and publishes state = 2n followed by RingHeader::latest = n.
+ * A reader registers in SlotHeader::readers and then confirms the state is still
+ * 2n. Both sides use sequentially consistent operations, so either the reader sees
+ * the write mark or the producer sees the reader and skips the slot. A frame stays
+ * valid for as long as its reader holds it.
+ */
+constexpr char kMagic[8] = {'V', 'P', 'S', 'H', 'M', 'R', 'G', '1'};
+constexpr std::uint32_t kVersion = 1;
+
+struct alignas(64) RingHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t slot_count;
+    std::uint64_t slot_bytes;
+    std::uint64_t payload_offset;           // from the start of the mapping
+    std::atomic<std::uint64_t> latest;      // last published frame number (0 = none)
+    std::atomic<std::uint32_t> closed;      // set by a producer that detached cleanly; viewers let go
+};
+
+struct alignas(64) SlotHeader {
+    std::atomic<std::uint64_t> state;       // 2n: frame n readable; odd: being written
+    std::atomic<std::uint32_t> readers;     // leases held by consumers
+    std::int32_t width;
+    std::int32_t height;
+    std::int32_t format;                    // ImageFormat
+    std::int32_t row_stride;                // signed, as in FrameData
+    std::uint64_t timestamp_ns;
+    std::uint64_t data_offset;              // top row, from the start of the slot payload
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shared-memory ring needs lock-free 64-bit atomics");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free, "shared-memory ring needs lock-free 32-bit atomics");
+
+/** shm_open() name for a ring: a leading '/' is added if missing. */
+std::string segmentName(const std::string& name);
+
+/** Bytes per pixel of a ring format, or 0 for values that are not an ImageFormat. */
+int formatBytes(std::int32_t format);
+
+/**
+ * A mapped ring segment. Unmapped when the last reference goes away, so frames
+ * leased from it stay readable after the consumer switches to a new segment.
+ */
+class Mapping {
+public:
+    ~Mapping();
+
+    /** Create (replacing any existing segment of that name) and initialise a ring. */
+    static std::shared_ptr<Mapping> create(const std::string& name, std::uint32_t slot_count, std::uint64_t slot_bytes,
+                                           std::string& error);
+    /** Map an existing ring; null if it does not exist (yet) or is not a valid ring. */
+    static std::shared_ptr<Mapping> open(const std::string& name);
+
+    /** Identity of the segment behind a name, to notice a restarted producer. */
+    static bool segmentId(const std::string& name, std::uint64_t& id);
+
+    RingHeader& header() { return *static_cast<RingHeader*>(base_); }
+    SlotHeader& slot(std::uint32_t i) {
+        return reinterpret_cast<SlotHeader*>(static_cast<std::uint8_t*>(base_) + sizeof(RingHeader))[i];
+    }
+    std::uint8_t* payload(std::uint32_t i) {
+        return static_cast<std::uint8_t*>(base_) + header().payload_offset + i * header().slot_bytes;
+    }
+    std::uint64_t id() const { return id_; }
+
+    /**
+     * Describe the frame in a leased slot, pointing into the mapping. False if
+     * the producer left a header that does not fit the slot.
+     */
+    bool slotFrame(std::uint32_t i, FrameData& frame);
+
+private:
+    Mapping() = default;
+
+    void* base_ = nullptr;
+    size_t size_ = 0;
+    std::uint64_t id_ = 0;
+};
+
+} // namespace shm
+} // namespace viewportal
+
+#endif // SHM_RING_H
@@ -0,0 +1,253 @@
+#include "viewportal_source.h"
+#include "thread_name.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace viewportal {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kMaxPoolThreads = 8;
+
+// Pause before calling grab() again when an unpaced source has nothing new
+constexpr std::chrono::milliseconds kRetryDelay(1);
+
+} // namespace
+
+struct SourceManager::Impl {
+    struct Entry {
+        std::unique_ptr<FrameSource> source;
+        size_t viewport = 0;
+        bool dedicated = false;
+        Clock::duration interval{0};  // zero: unpaced
+        bool opened = false;          // only touched by the thread running the source
+        // Guarded by Impl::mutex
+        Clock::time_point due;
+        bool busy = false;      // a pool thread is inside the source
+        bool stopping = false;
+        bool finished = false;  // ended or failed, and closed
+        SourceStats stats;
+        std::thread thread;     // dedicated sources
+    };
+
+    explicit Impl(ViewPortal& p) : portal(p) {}
+
+    /**
+     * Open the source if needed, grab once and publish the frame (entry's
+     * thread, without the mutex). \return false once the source ended or
+     * failed; it is closed then.
+     */
+    bool step(Entry& e) {
+        std::string error;
+        GrabResult result = GrabResult::End;
+        FrameStatus status = FrameStatus::Accepted;
+        double grab_ms = 0.0;
+        try {
+            if (!e.opened) {
+                if (!e.source->open(error)) {
+                    if (error.empty()) error = "open failed";
+                    finish(e, e.stats.name + ": " + error);
+                    return false;
+                }
+                e.opened = true;
+            }
+            SourceFrame out;
+            const auto start = Clock::now();
+            result = e.source->grab(out);
+            grab_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+            if (result == GrabResult::Frame)
+                status = portal.updateFrame(e.viewport, out.frame, std::move(out.owner));
+        } catch (const std::exception& ex) {
+            finish(e, e.stats.name + ": " + ex.what());
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++e.stats.grabs;
+            e.stats.grab_total_ms += grab_ms;
+            e.stats.grab_ms = e.stats.grab_total_ms / static_cast<double>(e.stats.grabs);
+            if (result == GrabResult::Frame) {
+                ++e.stats.frames;
+                if (status == FrameStatus::Replaced) ++e.stats.replaced;
+                if (status == FrameStatus::Dropped) ++e.stats.dropped;
+            }
+        }
+        if (result == GrabResult::End) {
+            finish(e, std::string());
+            return false;
+        }
+        schedule(e, result == GrabResult::Retry);
+        return true;
+    }
+
+    /** Close an opened source and record why it stopped (entry's thread). */
+    void finish(Entry& e, const std::string& error) {
+        if (e.opened) e.source->close();
+        e.opened = false;
+        std::lock_guard<std::mutex> lock(mutex);
+        e.finished = true;
+        e.stats.running = false;
+        if (!error.empty()) e.stats.error = error;
+    }
+
+    /** Next time the source is due; a source that fell behind does not catch up in a burst. */
+    void schedule(Entry& e, bool retry) {
+        const auto now = Clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (e.interval == Clock::duration::zero()) {
+            e.due = retry ? now + kRetryDelay : now;
+            return;
+        }
+        e.due += e.interval;
+        if (e.due < now) e.due = now;
+    }
+
+    void runDedicated(std::shared_ptr<Entry> e) {
+        setThreadName("vp-source");
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait_until(lock, e->due, [&]() { return e->stopping; });
+                if (e->stopping) break;
+            }
+            if (!step(*e)) return;
+        }
+        if (e->opened) finish(*e, std::string());
+    }
+
+    /** Pool thread: run whichever idle source has been due the longest. */
+    void runPool() {
+        setThreadName("vp-source-pool");
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stop_pool) {
+            std::shared_ptr<Entry> next;
+            for (const auto& kv : entries) {
+                const Entry& e = *kv.second;
+                if (e.dedicated || e.busy || e.stopping || e.finished) continue;
+                if (!next || e.due < next->due) next = kv.second;
+            }
+            if (!next) {
+                wake.wait(lock);
+                continue;
+            }
+            if (next->due > Clock::now()) {
+                wake.wait_until(lock, next->due);
+                continue;
+            }
+            next->busy = true;
+            lock.unlock();
+            step(*next);
+            lock.lock();
+            next->busy = false;
+            wake.notify_all();  // removeSource() may be waiting for this source
+        }
+    }
+
+    void startPool() {
+        int n = params.pool_threads;
+        if (n <= 0) n = std::min(kMaxPoolThreads, static_cast<int>(std::thread::hardware_concurrency()));
+        n = std::max(1, n);
+        for (int i = 0; i < n; ++i)
+            pool.emplace_back(&Impl::runPool, this);
+    }
+
+    ViewPortal& portal;
+    SourceManagerParams params;
+    mutable std::mutex mutex;
+    std::condition_variable wake;  // sources added, stopped or done with a step
+    std::map<int, std::shared_ptr<Entry>> entries;
+    int next_id = 0;
+    bool stop_pool = false;
+    std::vector<std::thread> pool;  // started with the first pooled source
+};
+
+SourceManager::SourceManager(ViewPortal& portal, const SourceManagerParams& params)
+    : impl_(new Impl(portal)) {
+    impl_->params = params;
+}
+
+SourceManager::~SourceManager() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stop_pool = true;
+    }
+    impl_->wake.notify_all();
+    for (std::thread& t : impl_->pool)
+        t.join();
+    delete impl_;
+}
+
+int SourceManager::addSource(std::unique_ptr<FrameSource> source, size_t viewportIndex, const SourceOptions& options) {
+    if (!source) return -1;
+    auto e = std::make_shared<Impl::Entry>();
+    const double rate = options.frame_rate >= 0.0 ? options.frame_rate : source->frameRate();
+    if (rate > 0.0)
+        e->interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    e->stats.name = source->name();
+    e->stats.viewport = viewportIndex;
+    e->stats.running = true;
+    e->source = std::move(source);
+    e->viewport = viewportIndex;
+    e->dedicated = options.dedicated_thread;
+    e->due = Clock::now();
+
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    const int id = impl_->next_id++;
+    impl_->entries[id] = e;
+    if (e->dedicated)
+        e->thread = std::thread(&Impl::runDedicated, impl_, e);
+    else if (impl_->pool.empty())
+        impl_->startPool();
+    impl_->wake.notify_all();
+    return id;
+}
+
+bool SourceManager::removeSource(int id) {
+    std::shared_ptr<Impl::Entry> e;
+    {
+        std::unique_lock<std::mutex> lock(impl_->mutex);
+        auto it = impl_->entries.find(id);
+        if (it == impl_->entries.end()) return false;
+        e = it->second;
+        impl_->entries.erase(it);
+        e->stopping = true;
+        impl_->wake.notify_all();
+        if (!e->dedicated) impl_->wake.wait(lock, [&]() { return !e->busy; });
+    }
+    if (e->thread.joinable()) {
+        e->thread.join();  // waits for a blocking grab() to return
+    } else if (e->opened) {
+        impl_->finish(*e, std::string());
+    }
+    return true;
+}
+
+void SourceManager::stop() {
+    std::vector<int> ids;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        for (const auto& kv : impl_->entries)
+            ids.push_back(kv.first);
+    }
+    for (int id : ids)
+        removeSource(id);
+}
+
+bool SourceManager::sourceStats(int id, SourceStats& stats) const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    auto it = impl_->entries.find(id);
+    if (it == impl_->entries.end()) return false;
+    stats = it->second->stats;
+    return true;
+}
+
+} // namespace viewportal
@@ -0,0 +1,67 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Bounded lock-free queue between exactly one producer thread and one consumer
+ * thread. The capacity is rounded up to a power of two; push() fails when the
+ * queue is full, so the producer never waits on the consumer.
+ */
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        slots_.resize(n);
+        mask_ = n - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /** Producer thread only. \return false if the queue is full. */
+    bool push(const T& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_) return false;
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Consumer thread only. \return false if the queue is empty. */
+    bool pop(T& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) return false;
+        }
+        value = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::vector<T> slots_;
+    size_t mask_ = 0;
+    // Each side caches the other's index so a push or pop touches the shared
+    // cache line only when the queue looks full (or empty).
+    alignas(kCacheLine) std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;  // producer's view of head_
+    alignas(kCacheLine) std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;  // consumer's view of tail_
+};
+
+} // namespace viewportal
+
+#endif // SPSC_RING_H
@@ -0,0 +1,73 @@
+#include "stats_worker.h"
+#include "image_stats.h"
+#include "thread_name.h"
+#include <algorithm>
+
+namespace viewportal {
+
+namespace {
+
+// Statistics refresh rate; faster than anyone reads a histogram
+constexpr std::chrono::milliseconds kInterval(33);
+
+} // namespace
+
+StatsWorker::StatsWorker() {
+    thread_ = std::thread(&StatsWorker::run, this);
+}
+
+StatsWorker::~StatsWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+void StatsWorker::bind(Binding binding) {
+    auto entry = std::make_shared<Entry>();
+    entry->binding = std::move(binding);
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [&](const std::shared_ptr<Entry>& e) { return e->binding.key == entry->binding.key; }),
+                   entries_.end());
+    entries_.push_back(std::move(entry));
+    wake_.notify_all();
+}
+
+void StatsWorker::run() {
+    setThreadName("vp-stats");
+    StatsSample sample;
+    std::vector<std::shared_ptr<Entry>> entries;
+    std::vector<std::shared_ptr<Entry>> finished;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        const auto next = std::chrono::steady_clock::now() + kInterval;
+        // Work on a snapshot so bind() is not held up while statistics are computed
+        entries = entries_;
+        lock.unlock();
+        for (const std::shared_ptr<Entry>& e : entries) {
+            if (!e->binding.sample(e->last_frame, sample)) continue;
+            e->last_frame = sample.frame;
+            auto stats = std::make_shared<ImageStats>();
+            if (sample.is_float)
+                computeFloatStats(reinterpret_cast<const float*>(sample.data.data()), sample.count, *stats);
+            else
+                computeImageStats(sample.data.data(), sample.count, sample.channels, sample.ignore_zero, *stats);
+            stats->frame = sample.frame;
+            if (!e->binding.publish(std::move(stats)))
+                finished.push_back(e);
+        }
+        entries.clear();
+        lock.lock();
+        for (const std::shared_ptr<Entry>& e : finished)
+            entries_.erase(std::remove(entries_.begin(), entries_.end(), e), entries_.end());
+        lock.unlock();
+        finished.clear();  // may drop the last reference to a cell's frame state
+        lock.lock();
+        wake_.wait_until(lock, next, [this]() { return stop_; });
+    }
+}
+
+} // namespace viewportal
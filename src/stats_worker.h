@@ -0,0 +1,69 @@
+#ifndef STATS_WORKER_H
+#define STATS_WORKER_H
+
+#include "viewportal.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Packed pixels sampled from a frame for statistics.
+ */
+struct StatsSample {
+    int channels = 1;
+    bool ignore_zero = false;    // depth: zero means no measurement
+    bool is_float = false;       // data holds count floats (Float16 frames are widened when sampled)
+    std::uint64_t frame = 0;
+    size_t count = 0;            // pixels in data
+    std::vector<std::uint8_t> data;
+};
+
+/**
+ * Computes image statistics for Histogram viewports on its own thread, so the
+ * display thread and producers never pay for them. Each binding is polled once
+ * per kInterval (about 30 Hz): sample() copies the newest frame's rows (if it changed) and
+ * publish() hands the result over, returning false once the histogram viewport
+ * is gone, which ends the binding.
+ */
+class StatsWorker {
+public:
+    struct Binding {
+        const void* key = nullptr;  // identifies the histogram cell
+        std::function<bool(std::uint64_t last_frame, StatsSample& sample)> sample;
+        std::function<bool(std::shared_ptr<const ImageStats> stats)> publish;
+    };
+
+    StatsWorker();
+    ~StatsWorker();
+
+    StatsWorker(const StatsWorker&) = delete;
+    StatsWorker& operator=(const StatsWorker&) = delete;
+
+    /** Add a binding, replacing one with the same key. */
+    void bind(Binding binding);
+
+private:
+    struct Entry {
+        Binding binding;
+        std::uint64_t last_frame = 0;  // worker thread only
+    };
+
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<std::shared_ptr<Entry>> entries_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+} // namespace viewportal
+
+#endif // STATS_WORKER_H
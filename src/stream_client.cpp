@@ -0,0 +1,126 @@
+#include "viewportal_stream.h"
+#include "stream_protocol.h"
+#include "image_format.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+
+namespace viewportal {
+
+struct StreamClient::Impl {
+    std::atomic<int> fd{-1};
+    int rows = 0;
+    int cols = 0;
+    std::vector<ViewportType> types;
+    std::map<std::uint16_t, std::vector<std::uint8_t>> images;  // reconstructed frame per viewport
+    std::vector<std::uint8_t> payload;
+    std::vector<std::uint8_t> delta;
+};
+
+StreamClient::StreamClient() : impl_(new Impl) {}
+
+StreamClient::~StreamClient() {
+    disconnect();
+    delete impl_;
+}
+
+bool StreamClient::connect(const std::string& address, std::string* error) {
+    disconnect();
+    std::string message;
+    impl_->fd = stream::connectTo(address, message);
+    if (impl_->fd < 0) {
+        if (error) *error = message;
+        return false;
+    }
+    std::uint8_t hello[stream::kHelloFixedSize];
+    if (!stream::recvAll(impl_->fd, hello, sizeof(hello)) || std::memcmp(hello, "VPST", 4) != 0 ||
+        (hello[4] | (hello[5] << 8)) != stream::kProtocolVersion) {
+        if (error) *error = "not a ViewPortal stream (or unsupported version)";
+        disconnect();
+        return false;
+    }
+    impl_->rows = hello[6] | (hello[7] << 8);
+    impl_->cols = hello[8] | (hello[9] << 8);
+    const int count = hello[10] | (hello[11] << 8);
+    std::vector<std::uint8_t> types(count);
+    if (count > 0 && !stream::recvAll(impl_->fd, types.data(), types.size())) {
+        if (error) *error = "connection closed during handshake";
+        disconnect();
+        return false;
+    }
+    impl_->types.clear();
+    for (std::uint8_t t : types)
+        impl_->types.push_back(t < static_cast<std::uint8_t>(ViewportType::Count) ? static_cast<ViewportType>(t)
+                                                                                   : ViewportType::RGB8);
+    return true;
+}
+
+void StreamClient::disconnect() {
+    if (impl_->fd >= 0)
+        close(impl_->fd);
+    impl_->fd = -1;
+    impl_->images.clear();
+}
+
+void StreamClient::interrupt() {
+    const int fd = impl_->fd.load();
+    if (fd >= 0)
+        shutdown(fd, SHUT_RDWR);
+}
+
+int StreamClient::rows() const { return impl_->rows; }
+int StreamClient::cols() const { return impl_->cols; }
+const std::vector<ViewportType>& StreamClient::types() const { return impl_->types; }
+
+bool StreamClient::receive(int& viewport, FrameData& frame) {
+    while (impl_->fd >= 0) {
+        std::uint8_t header[stream::kFrameHeaderSize];
+        stream::FrameHeader h;
+        if (!stream::recvAll(impl_->fd, header, sizeof(header)) || !stream::readFrameHeader(header, h)) break;
+        // A header out of these bounds means the stream is corrupt or not ours:
+        // nothing after it can be trusted
+        if (h.format > static_cast<std::uint8_t>(ImageFormat::Float32x2) || h.width == 0 || h.height == 0 ||
+            h.width > stream::kMaxDimension || h.height > stream::kMaxDimension)
+            break;
+        const ImageFormat format = static_cast<ImageFormat>(h.format);
+        const size_t size = static_cast<size_t>(h.width) * h.height * bytesPerPixel(format);
+        if (size > stream::kMaxImageBytes || h.payload_size > size ||
+            ((h.flags & stream::kFlagRaw) && h.payload_size != size))
+            break;
+        impl_->payload.resize(h.payload_size);
+        if (h.payload_size > 0 && !stream::recvAll(impl_->fd, impl_->payload.data(), h.payload_size)) break;
+
+        std::vector<std::uint8_t>& image = impl_->images[h.viewport];
+        const bool key = (h.flags & stream::kFlagKey) != 0;
+        if (!key && image.size() != size) continue;  // delta without its key frame
+        std::vector<std::uint8_t>& residual = key ? image : impl_->delta;
+        residual.resize(size);
+        if (h.flags & stream::kFlagRaw) {
+            std::memcpy(residual.data(), impl_->payload.data(), size);
+        } else if (!stream::decodeResidual(impl_->payload.data(), impl_->payload.size(), residual.data(), size)) {
+            // Drop the stream until the server sends a key frame again
+            impl_->images.erase(h.viewport);
+            const std::uint8_t request = stream::kKeyRequest;
+            if (!stream::sendAll(impl_->fd, &request, 1)) break;
+            continue;
+        }
+        if (key)
+            stream::undoLeftResidual(image.data(), size, bytesPerPixel(format));
+        else
+            stream::applyDelta(image.data(), impl_->delta.data(), size);
+        viewport = h.viewport == stream::kCompositeIndex ? -1 : static_cast<int>(h.viewport);
+        frame.width = static_cast<int>(h.width);
+        frame.height = static_cast<int>(h.height);
+        frame.format = format;
+        frame.data = image.data();
+        frame.row_stride = 0;
+        return true;
+    }
+    disconnect();
+    return false;
+}
+
+} // namespace viewportal
@@ -0,0 +1,425 @@
+#include "stream_protocol.h"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace viewportal {
+namespace stream {
+
+namespace {
+
+void put16(std::uint8_t* p, std::uint16_t v) {
+    p[0] = static_cast<std::uint8_t>(v);
+    p[1] = static_cast<std::uint8_t>(v >> 8);
+}
+
+void put32(std::uint8_t* p, std::uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = static_cast<std::uint8_t>(v >> (8 * i));
+}
+
+void put64(std::uint8_t* p, std::uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = static_cast<std::uint8_t>(v >> (8 * i));
+}
+
+std::uint16_t get16(const std::uint8_t* p) {
+    return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::uint32_t get32(const std::uint8_t* p) {
+    std::uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v |= static_cast<std::uint32_t>(p[i]) << (8 * i);
+    return v;
+}
+
+std::uint64_t get64(const std::uint8_t* p) {
+    std::uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+    return v;
+}
+
+bool splitAddress(const std::string& address, std::string& scheme, std::string& rest) {
+    const size_t colon = address.find(':');
+    if (colon == std::string::npos) return false;
+    scheme = address.substr(0, colon);
+    rest = address.substr(colon + 1);
+    return !rest.empty();
+}
+
+bool unixAddress(const std::string& path, sockaddr_un& addr, std::string& error) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        error = "unix socket path too long: " + path;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+addrinfo* resolveTcp(const std::string& host_port, bool passive, std::string& error) {
+    const size_t colon = host_port.rfind(':');
+    if (colon == std::string::npos) {
+        error = "expected tcp:HOST:PORT";
+        return nullptr;
+    }
+    const std::string host = host_port.substr(0, colon);
+    const std::string port = host_port.substr(colon + 1);
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    const int rc = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+    if (rc != 0) {
+        error = std::string("cannot resolve ") + host_port + ": " + gai_strerror(rc);
+        return nullptr;
+    }
+    return result;
+}
+
+constexpr std::uint32_t kZeroBlock = 15;  // block header: every residual is 0
+constexpr std::uint32_t kEscape = 16;     // unary prefix this long is followed by the raw byte
+
+void storeLe64(std::uint8_t* p, std::uint64_t v) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    std::memcpy(p, &v, 8);
+#else
+    put64(p, v);
+#endif
+}
+
+/** LSB-first bit packer appending to a byte vector. */
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<std::uint8_t>& out) : out_(out) {}
+
+    /** Room for at least bits more bits without growing on every byte. */
+    void reserve(size_t bits) {
+        if (pos_ + bits / 8 + 8 > out_.size()) out_.resize(std::max(out_.size() * 2, pos_ + bits / 8 + 8));
+        base_ = out_.data();
+    }
+
+    /** count <= 32 bits; reserve() must cover them. Branch-free: the next eight bytes are always stored. */
+    void put(std::uint32_t bits, int count) {
+        acc_ |= static_cast<std::uint64_t>(bits) << n_;
+        n_ += count;
+        storeLe64(base_ + pos_, acc_);
+        const int bytes = n_ >> 3;
+        pos_ += static_cast<size_t>(bytes);
+        acc_ >>= 8 * bytes;
+        n_ &= 7;
+    }
+
+    void finish() {
+        for (; n_ > 0; n_ -= 8, acc_ >>= 8) out_[pos_++] = static_cast<std::uint8_t>(acc_);
+        out_.resize(pos_);
+    }
+
+private:
+    std::vector<std::uint8_t>& out_;
+    std::uint8_t* base_ = nullptr;
+    size_t pos_ = 0;
+    std::uint64_t acc_ = 0;
+    int n_ = 0;
+};
+
+/** Reads what BitWriter wrote; reads past the end fail. */
+class BitReader {
+public:
+    BitReader(const std::uint8_t* data, size_t size) : p_(data), end_(data + size) {}
+
+    /** Load up to 56 bits; \return the number available. */
+    int fill() {
+        while (n_ <= 48 && p_ != end_) {
+            acc_ |= static_cast<std::uint64_t>(*p_++) << n_;
+            n_ += 8;
+        }
+        return n_;
+    }
+
+    /** Consume a unary prefix: up to limit one bits, and the zero ending a shorter run. */
+    bool unary(std::uint32_t limit, std::uint32_t& q) {
+        fill();
+        const std::uint64_t zeros = ~acc_ & ((std::uint64_t(1) << n_) - 1);
+        const std::uint32_t run = zeros ? static_cast<std::uint32_t>(__builtin_ctzll(zeros)) : static_cast<std::uint32_t>(n_);
+        if (run >= limit) {
+            q = limit;
+            acc_ >>= limit;
+            n_ -= static_cast<int>(limit);
+            return true;
+        }
+        if (!zeros) return false;  // the data ends inside the run
+        q = run;
+        acc_ >>= run + 1;
+        n_ -= static_cast<int>(run) + 1;
+        return true;
+    }
+
+    bool get(int count, std::uint32_t& v) {
+        if (n_ < count && fill() < count) return false;
+        v = static_cast<std::uint32_t>(acc_ & ((std::uint64_t(1) << count) - 1));
+        acc_ >>= count;
+        n_ -= count;
+        return true;
+    }
+
+    /** True once every whole byte was read (the last one may be padding). */
+    bool done() const { return p_ == end_ && n_ < 8; }
+
+private:
+    const std::uint8_t* p_;
+    const std::uint8_t* end_;
+    std::uint64_t acc_ = 0;
+    int n_ = 0;
+};
+
+std::uint32_t zigzag(std::uint8_t b) {
+    const int v = static_cast<std::int8_t>(b);
+    return static_cast<std::uint32_t>(v < 0 ? -2 * v - 1 : 2 * v);
+}
+
+std::uint8_t unzigzag(std::uint32_t z) {
+    return static_cast<std::uint8_t>((z & 1) ? -static_cast<int>((z + 1) >> 1) : static_cast<int>(z >> 1));
+}
+
+} // namespace
+
+void writeFrameHeader(const FrameHeader& h, std::uint8_t* out) {
+    std::memcpy(out, "VPFR", 4);
+    put16(out + 4, h.viewport);
+    out[6] = h.format;
+    out[7] = h.flags;
+    put32(out + 8, h.width);
+    put32(out + 12, h.height);
+    put64(out + 16, h.seq);
+    put32(out + 24, h.payload_size);
+    put32(out + 28, 0);  // reserved
+}
+
+bool readFrameHeader(const std::uint8_t* in, FrameHeader& h) {
+    if (std::memcmp(in, "VPFR", 4) != 0) return false;
+    h.viewport = get16(in + 4);
+    h.format = in[6];
+    h.flags = in[7];
+    h.width = get32(in + 8);
+    h.height = get32(in + 12);
+    h.seq = get64(in + 16);
+    h.payload_size = get32(in + 24);
+    return true;
+}
+
+std::vector<std::uint8_t> writeHello(int rows, int cols, const std::vector<std::uint8_t>& types) {
+    std::vector<std::uint8_t> out(kHelloFixedSize + types.size());
+    std::memcpy(out.data(), "VPST", 4);
+    put16(out.data() + 4, kProtocolVersion);
+    put16(out.data() + 6, static_cast<std::uint16_t>(rows));
+    put16(out.data() + 8, static_cast<std::uint16_t>(cols));
+    put16(out.data() + 10, static_cast<std::uint16_t>(types.size()));
+    if (!types.empty())
+        std::memcpy(out.data() + kHelloFixedSize, types.data(), types.size());
+    return out;
+}
+
+void encodeResidual(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out) {
+    out.clear();
+    BitWriter bits(out);
+    std::uint32_t zz[kResidualBlock];
+    for (size_t start = 0; start < size; start += kResidualBlock) {
+        const size_t n = std::min(kResidualBlock, size - start);
+        bits.reserve(4 + n * (kEscape + 8));
+        std::uint32_t sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            zz[i] = zigzag(data[start + i]);
+            sum += zz[i];
+        }
+        if (sum == 0) {
+            bits.put(kZeroBlock, 4);
+            continue;
+        }
+        // Rice parameter near log2 of the mean
+        int k = 0;
+        while (k < 7 && (static_cast<std::uint32_t>(n) << (k + 1)) <= sum) ++k;
+        bits.put(static_cast<std::uint32_t>(k), 4);
+        const std::uint32_t low_mask = (1u << k) - 1;
+        for (size_t i = 0; i < n; ++i) {
+            const std::uint32_t q = zz[i] >> k;
+            if (q < kEscape) {
+                // q ones, a zero, then the k low bits
+                bits.put(((1u << q) - 1) | ((zz[i] & low_mask) << (q + 1)), static_cast<int>(q) + 1 + k);
+            } else {
+                bits.put((1u << kEscape) - 1, static_cast<int>(kEscape));
+                bits.put(zz[i], 8);
+            }
+        }
+    }
+    bits.finish();
+}
+
+bool decodeResidual(const std::uint8_t* data, size_t size, std::uint8_t* out, size_t out_size) {
+    BitReader bits(data, size);
+    for (size_t start = 0; start < out_size; start += kResidualBlock) {
+        const size_t n = std::min(kResidualBlock, out_size - start);
+        std::uint32_t k = 0;
+        if (!bits.get(4, k)) return false;
+        if (k == kZeroBlock) {
+            std::memset(out + start, 0, n);
+            continue;
+        }
+        if (k > 7) return false;
+        for (size_t i = 0; i < n; ++i) {
+            std::uint32_t q = 0, z = 0;
+            if (!bits.unary(kEscape, q)) return false;
+            if (q == kEscape) {
+                if (!bits.get(8, z)) return false;
+            } else {
+                std::uint32_t low = 0;
+                if (k > 0 && !bits.get(static_cast<int>(k), low)) return false;
+                z = (q << k) | low;
+                if (z > 255) return false;
+            }
+            out[start + i] = unzigzag(z);
+        }
+    }
+    return bits.done();
+}
+
+void computeDelta(const std::uint8_t* cur, const std::uint8_t* prev, size_t size, std::uint8_t* out) {
+    for (size_t i = 0; i < size; ++i)
+        out[i] = static_cast<std::uint8_t>(cur[i] - prev[i]);
+}
+
+void applyDelta(std::uint8_t* image, const std::uint8_t* delta, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+        image[i] = static_cast<std::uint8_t>(image[i] + delta[i]);
+}
+
+void computeLeftResidual(const std::uint8_t* cur, size_t size, int bpp, std::uint8_t* out) {
+    const size_t first = std::min(size, static_cast<size_t>(bpp));
+    std::memcpy(out, cur, first);
+    for (size_t i = first; i < size; ++i)
+        out[i] = static_cast<std::uint8_t>(cur[i] - cur[i - bpp]);
+}
+
+void undoLeftResidual(std::uint8_t* image, size_t size, int bpp) {
+    for (size_t i = static_cast<size_t>(bpp); i < size; ++i)
+        image[i] = static_cast<std::uint8_t>(image[i] + image[i - bpp]);
+}
+
+int listenOn(const std::string& address, std::string& error) {
+    std::string scheme, rest;
+    if (!splitAddress(address, scheme, rest)) {
+        error = "bad address: " + address;
+        return -1;
+    }
+    if (scheme == "unix") {
+        sockaddr_un addr;
+        if (!unixAddress(rest, addr, error)) return -1;
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            error = std::strerror(errno);
+            return -1;
+        }
+        unlink(rest.c_str());  // stale socket from a previous run
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+            error = "cannot listen on " + address + ": " + std::strerror(errno);
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    if (scheme == "tcp") {
+        addrinfo* ai = resolveTcp(rest, true, error);
+        if (!ai) return -1;
+        int fd = -1;
+        for (addrinfo* p = ai; p; p = p->ai_next) {
+            fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (fd < 0) continue;
+            const int one = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if (bind(fd, p->ai_addr, p->ai_addrlen) == 0 && listen(fd, 8) == 0) break;
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(ai);
+        if (fd < 0) error = "cannot listen on " + address + ": " + std::strerror(errno);
+        return fd;
+    }
+    error = "unknown address scheme: " + scheme;
+    return -1;
+}
+
+int connectTo(const std::string& address, std::string& error) {
+    std::string scheme, rest;
+    if (!splitAddress(address, scheme, rest)) {
+        error = "bad address: " + address;
+        return -1;
+    }
+    if (scheme == "unix") {
+        sockaddr_un addr;
+        if (!unixAddress(rest, addr, error)) return -1;
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            error = "cannot connect to " + address + ": " + std::strerror(errno);
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    if (scheme == "tcp") {
+        addrinfo* ai = resolveTcp(rest, false, error);
+        if (!ai) return -1;
+        int fd = -1;
+        for (addrinfo* p = ai; p; p = p->ai_next) {
+            fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+            if (fd < 0) continue;
+            if (connect(fd, p->ai_addr, p->ai_addrlen) == 0) break;
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(ai);
+        if (fd < 0) {
+            error = "cannot connect to " + address + ": " + std::strerror(errno);
+            return -1;
+        }
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return fd;
+    }
+    error = "unknown address scheme: " + scheme;
+    return -1;
+}
+
+bool sendAll(int fd, const void* data, size_t size) {
+    const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recvAll(int fd, void* data, size_t size) {
+    std::uint8_t* p = static_cast<std::uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace stream
+} // namespace viewportal
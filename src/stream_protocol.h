@@ -0,0 +1,83 @@
+#ifndef STREAM_PROTOCOL_H
+#define STREAM_PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace viewportal {
+namespace stream {
+
+/**
+ * Wire format (all integers little-endian):
+ *   Hello, server -> client once:  "VPST" u16 version u16 rows u16 cols u16 count, count x u8 ViewportType
+ *   Frame, server -> client:       "VPFR" u16 viewport u8 format u8 flags u32 width u32 height
+ *                                  u64 seq u32 payload_size, payload
+ *   Key request, client -> server: one byte kKeyRequest; the server sends key
+ *                                  frames of every stream next
+ * The payload codes the packed, top-down image as residuals: for key frames
+ * each byte minus the byte one pixel to its left, for delta frames each byte
+ * minus the same byte of the previous frame of the viewport. The residuals are
+ * coded by encodeResidual(), or stored as they are (kFlagRaw) when that would
+ * not be smaller, so a payload never exceeds the image size. viewport
+ * kCompositeIndex is the whole window.
+ */
+constexpr std::uint16_t kProtocolVersion = 2;
+constexpr std::uint16_t kCompositeIndex = 0xFFFF;
+constexpr std::uint8_t kFlagKey = 1;
+constexpr std::uint8_t kFlagRaw = 2;
+constexpr std::uint8_t kKeyRequest = 'K';
+constexpr size_t kHelloFixedSize = 12;
+constexpr size_t kFrameHeaderSize = 32;
+constexpr std::uint32_t kMaxDimension = 32768;     // per side; larger headers are rejected
+constexpr size_t kMaxImageBytes = size_t(1) << 30;  // likewise
+
+struct FrameHeader {
+    std::uint16_t viewport = 0;
+    std::uint8_t format = 0;
+    std::uint8_t flags = 0;
+    std::uint32_t width = 0;
+    std::uint32_t height = 0;
+    std::uint64_t seq = 0;
+    std::uint32_t payload_size = 0;
+};
+
+void writeFrameHeader(const FrameHeader& h, std::uint8_t* out);
+bool readFrameHeader(const std::uint8_t* in, FrameHeader& h);
+
+std::vector<std::uint8_t> writeHello(int rows, int cols, const std::vector<std::uint8_t>& types);
+
+/**
+ * Lossless residual coding. Residuals are zigzag mapped (0, -1, 1, -2, ...) and
+ * Rice coded in blocks of kResidualBlock bytes, with the parameter chosen per
+ * block from its mean; an all-zero block costs four bits. Sensor noise of a few
+ * levels codes to about 3-4 bits per byte, and unchanged areas to 1/128 of their
+ * size. decodeResidual() fails unless data decodes to exactly out_size bytes.
+ */
+constexpr size_t kResidualBlock = 64;
+void encodeResidual(const std::uint8_t* data, size_t size, std::vector<std::uint8_t>& out);
+bool decodeResidual(const std::uint8_t* data, size_t size, std::uint8_t* out, size_t out_size);
+
+/** out[i] = cur[i] - prev[i] (mod 256). */
+void computeDelta(const std::uint8_t* cur, const std::uint8_t* prev, size_t size, std::uint8_t* out);
+/** image[i] += delta[i] (mod 256). */
+void applyDelta(std::uint8_t* image, const std::uint8_t* delta, size_t size);
+/** out[i] = cur[i] - cur[i - bpp] (mod 256); the first pixel is kept. */
+void computeLeftResidual(const std::uint8_t* cur, size_t size, int bpp, std::uint8_t* out);
+/** Inverse of computeLeftResidual(), in place. */
+void undoLeftResidual(std::uint8_t* image, size_t size, int bpp);
+
+/**
+ * Socket helpers. Addresses are "tcp:HOST:PORT" or "unix:PATH".
+ * Return a file descriptor, or -1 with a message in error.
+ */
+int listenOn(const std::string& address, std::string& error);
+int connectTo(const std::string& address, std::string& error);
+bool sendAll(int fd, const void* data, size_t size);
+bool recvAll(int fd, void* data, size_t size);
+
+} // namespace stream
+} // namespace viewportal
+
+#endif // STREAM_PROTOCOL_H
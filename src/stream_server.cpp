@@ -0,0 +1,317 @@
+#include "stream_server.h"
+#include "stream_protocol.h"
+#include "image_format.h"
+#include "thread_name.h"
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+namespace viewportal {
+
+namespace {
+
+constexpr size_t kCompositeSlot = std::numeric_limits<size_t>::max();
+
+bool sameShape(const StreamImage& a, const StreamImage& b) {
+    return a.width == b.width && a.height == b.height && a.format == b.format;
+}
+
+} // namespace
+
+StreamServer::StreamServer(StreamSource& source, const StreamServerParams& params)
+    : source_(source), params_(params) {
+    params_.max_fps = std::max(1, params_.max_fps);
+    params_.max_queued_frames = std::max(1, params_.max_queued_frames);
+    params_.lossy_bits = std::min(std::max(0, params_.lossy_bits), 7);
+}
+
+StreamServer::~StreamServer() {
+    stop();
+}
+
+bool StreamServer::start(std::string& error) {
+    listen_fd_ = stream::listenOn(params_.address, error);
+    if (listen_fd_ < 0) return false;
+    if (params_.address.compare(0, 5, "unix:") == 0)
+        unix_path_ = params_.address.substr(5);
+    if (pipe(wake_pipe_) != 0) {
+        error = std::strerror(errno);
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    fcntl(wake_pipe_[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe_[1], F_SETFL, O_NONBLOCK);
+    stop_ = false;
+    last_composite_ = std::chrono::steady_clock::now();
+    io_thread_ = std::thread(&StreamServer::ioLoop, this);
+    encode_thread_ = std::thread(&StreamServer::encodeLoop, this);
+    return true;
+}
+
+void StreamServer::stop() {
+    if (!io_thread_.joinable() && !encode_thread_.joinable()) return;
+    stop_ = true;
+    wakeIo();
+    if (encode_thread_.joinable()) encode_thread_.join();
+    if (io_thread_.joinable()) io_thread_.join();
+    for (auto& c : clients_)
+        close(c->fd);
+    clients_.clear();
+    num_clients_ = 0;
+    close(listen_fd_);
+    close(wake_pipe_[0]);
+    close(wake_pipe_[1]);
+    listen_fd_ = wake_pipe_[0] = wake_pipe_[1] = -1;
+    if (!unix_path_.empty())
+        unlink(unix_path_.c_str());
+}
+
+size_t StreamServer::numClients() {
+    return num_clients_.load();
+}
+
+bool StreamServer::wantsComposite() {
+    if (!params_.stream_composite || num_clients_.load() == 0) return false;
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_composite_ < std::chrono::milliseconds(1000 / params_.max_fps)) return false;
+    last_composite_ = now;
+    return true;
+}
+
+void StreamServer::submitComposite(int width, int height, const std::uint8_t* rgb_bottom_up) {
+    const size_t row = static_cast<size_t>(width) * 3;
+    std::lock_guard<std::mutex> lock(mutex_);
+    composite_.format = ImageFormat::RGB8;
+    composite_.width = width;
+    composite_.height = height;
+    composite_.pixels.resize(row * height);
+    for (int y = 0; y < height; ++y)
+        std::memcpy(composite_.pixels.data() + y * row, rgb_bottom_up + (height - 1 - y) * row, row);
+    ++composite_.seq;
+}
+
+void StreamServer::wakeIo() {
+    if (wake_pipe_[1] < 0) return;
+    const char c = 1;
+    (void)!write(wake_pipe_[1], &c, 1);
+}
+
+StreamServer::Packet StreamServer::makePacket(std::uint16_t wire_index, const StreamImage& img,
+                                              const std::uint8_t* residual, bool key) {
+    const size_t size = img.pixels.size();
+    stream::encodeResidual(residual, size, coded_);
+    const bool raw = coded_.size() >= size;  // noise-like content: store it as is
+    const size_t payload = raw ? size : coded_.size();
+    auto packet = std::make_shared<std::vector<std::uint8_t>>(stream::kFrameHeaderSize + payload);
+    stream::FrameHeader h;
+    h.viewport = wire_index;
+    h.format = static_cast<std::uint8_t>(img.format);
+    h.flags = static_cast<std::uint8_t>((key ? stream::kFlagKey : 0) | (raw ? stream::kFlagRaw : 0));
+    h.width = static_cast<std::uint32_t>(img.width);
+    h.height = static_cast<std::uint32_t>(img.height);
+    h.seq = img.seq;
+    h.payload_size = static_cast<std::uint32_t>(payload);
+    stream::writeFrameHeader(h, packet->data());
+    std::memcpy(packet->data() + stream::kFrameHeaderSize, raw ? residual : coded_.data(), payload);
+    return packet;
+}
+
+bool StreamServer::enqueue(Client& c, const Packet& p) {
+    if (c.queue.size() >= static_cast<size_t>(params_.max_queued_frames)) {
+        // Too far behind: drop the backlog (except a partly sent packet) and
+        // restart every stream of this client from a key frame.
+        Packet partial = c.front_offset > 0 || !c.greeted ? c.queue.front() : nullptr;
+        c.queue.clear();
+        if (partial) c.queue.push_back(partial);
+        c.has_key.clear();
+        return false;
+    }
+    c.queue.push_back(p);
+    return true;
+}
+
+void StreamServer::encodeStream(std::uint16_t wire_index, size_t key_slot, Encoder& enc, StreamImage& img, bool fresh) {
+    if (fresh) {
+        if (params_.lossy_bits > 0 && !isExactFormat(img.format)) {  // masking float bytes would corrupt the values
+            const std::uint8_t mask = static_cast<std::uint8_t>(0xFF << params_.lossy_bits);
+            for (std::uint8_t& v : img.pixels) v &= mask;
+        }
+        enc.last_seq = img.seq;
+    }
+    bool any_needs_key = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& c : clients_)
+            any_needs_key = any_needs_key || (!c->dead && c->has_key.count(key_slot) == 0);
+    }
+    if (!fresh && (!any_needs_key || !enc.has_prev)) return;
+
+    const StreamImage& cur = fresh ? img : enc.prev;
+    Packet delta;
+    if (fresh && enc.has_prev && sameShape(img, enc.prev)) {
+        scratch_.resize(img.pixels.size());
+        stream::computeDelta(img.pixels.data(), enc.prev.pixels.data(), img.pixels.size(), scratch_.data());
+        delta = makePacket(wire_index, img, scratch_.data(), false);
+    }
+    Packet key;
+    if (any_needs_key || !delta) {
+        scratch_.resize(cur.pixels.size());
+        stream::computeLeftResidual(cur.pixels.data(), cur.pixels.size(), bytesPerPixel(cur.format), scratch_.data());
+        key = makePacket(wire_index, cur, scratch_.data(), true);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& c : clients_) {
+            if (c->dead) continue;
+            const bool keyed = c->has_key.count(key_slot) != 0;
+            if (keyed && delta) {
+                enqueue(*c, delta);
+            } else if (key && (!keyed || !delta)) {
+                if (enqueue(*c, key))
+                    c->has_key.insert(key_slot);
+            }
+        }
+    }
+    if (fresh) {
+        std::swap(enc.prev, img);
+        enc.has_prev = true;
+    }
+}
+
+void StreamServer::encodeLoop() {
+    setThreadName("vp-stream-enc");
+    const auto interval = std::chrono::milliseconds(1000 / params_.max_fps);
+    auto next = std::chrono::steady_clock::now();
+    while (!stop_) {
+        next += interval;
+        std::this_thread::sleep_until(next);
+        const auto now = std::chrono::steady_clock::now();
+        if (now > next + interval) next = now;  // fell behind; do not try to catch up
+        if (num_clients_.load() == 0) continue;
+
+        if (params_.stream_viewports) {
+            int rows = 0, cols = 0;
+            std::vector<std::uint8_t> types;
+            source_.streamLayout(rows, cols, types);
+            encoders_.resize(types.size());
+            for (size_t i = 0; i < types.size(); ++i) {
+                const bool fresh = source_.streamSnapshot(i, encoders_[i].last_seq, snapshot_);
+                encodeStream(static_cast<std::uint16_t>(i), i, encoders_[i], snapshot_, fresh);
+            }
+        }
+        if (params_.stream_composite) {
+            bool fresh = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (composite_.seq != composite_encoder_.last_seq && !composite_.pixels.empty()) {
+                    snapshot_.format = composite_.format;
+                    snapshot_.width = composite_.width;
+                    snapshot_.height = composite_.height;
+                    snapshot_.seq = composite_.seq;
+                    snapshot_.pixels = composite_.pixels;
+                    fresh = true;
+                }
+            }
+            encodeStream(stream::kCompositeIndex, kCompositeSlot, composite_encoder_, snapshot_, fresh);
+        }
+        wakeIo();
+    }
+}
+
+void StreamServer::ioLoop() {
+    setThreadName("vp-stream-io");
+    std::vector<pollfd> fds;
+    std::vector<Client*> polled;
+    while (!stop_) {
+        fds.clear();
+        polled.clear();
+        fds.push_back(pollfd{wake_pipe_[0], POLLIN, 0});
+        fds.push_back(pollfd{listen_fd_, POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& c : clients_) {
+                const short events = static_cast<short>(POLLIN | (c->queue.empty() ? 0 : POLLOUT));
+                fds.push_back(pollfd{c->fd, events, 0});
+                polled.push_back(c.get());
+            }
+        }
+        if (poll(fds.data(), fds.size(), 200) < 0 && errno != EINTR) break;
+
+        if (fds[0].revents & POLLIN) {
+            char buf[64];
+            while (read(wake_pipe_[0], buf, sizeof(buf)) > 0) {}
+        }
+        if (fds[1].revents & POLLIN) {
+            const int fd = accept(listen_fd_, nullptr, nullptr);
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                const int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));  // fails harmlessly on unix sockets
+                auto client = std::make_unique<Client>();
+                client->fd = fd;
+                int rows = 0, cols = 0;
+                std::vector<std::uint8_t> types;
+                source_.streamLayout(rows, cols, types);
+                client->queue.push_back(std::make_shared<std::vector<std::uint8_t>>(stream::writeHello(rows, cols, types)));
+                std::lock_guard<std::mutex> lock(mutex_);
+                clients_.push_back(std::move(client));
+                num_clients_ = clients_.size();
+            }
+        }
+
+        for (size_t k = 0; k < polled.size(); ++k) {
+            Client& c = *polled[k];
+            const short revents = fds[k + 2].revents;
+            bool closed = (revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+            bool key_request = false;
+            if (revents & POLLIN) {
+                // Clients only send key requests; reading also detects a closed connection
+                char buf[256];
+                const ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                    closed = true;
+                key_request = n > 0 && std::memchr(buf, stream::kKeyRequest, static_cast<size_t>(n)) != nullptr;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed) c.dead = true;
+            if (key_request) c.has_key.clear();  // every stream restarts from a key frame
+            if (!c.dead && (revents & POLLOUT)) {
+                while (!c.queue.empty()) {
+                    const std::vector<std::uint8_t>& p = *c.queue.front();
+                    const ssize_t n = send(c.fd, p.data() + c.front_offset, p.size() - c.front_offset, MSG_NOSIGNAL);
+                    if (n < 0) {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c.dead = true;
+                        break;
+                    }
+                    c.front_offset += static_cast<size_t>(n);
+                    if (c.front_offset < p.size()) break;
+                    c.queue.pop_front();
+                    c.front_offset = 0;
+                    c.greeted = true;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = clients_.begin(); it != clients_.end();) {
+            if ((*it)->dead) {
+                close((*it)->fd);
+                it = clients_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        num_clients_ = clients_.size();
+    }
+}
+
+} // namespace viewportal
@@ -0,0 +1,130 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include "viewportal.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * A packed, top-down copy of one frame taken for streaming.
+ */
+struct StreamImage {
+    ImageFormat format = ImageFormat::RGB8;
+    int width = 0;
+    int height = 0;
+    std::uint64_t seq = 0;
+    std::vector<std::uint8_t> pixels;
+};
+
+/**
+ * Where the server gets its frames from; implemented by the ViewPortal window.
+ * Called from the server's encoder thread.
+ */
+class StreamSource {
+public:
+    virtual ~StreamSource() = default;
+
+    virtual void streamLayout(int& rows, int& cols, std::vector<std::uint8_t>& types) = 0;
+
+    /**
+     * Copy the newest frame of an image viewport into out if its sequence number
+     * differs from last_seq. False if there is nothing new (or no such viewport).
+     */
+    virtual bool streamSnapshot(size_t index, std::uint64_t last_seq, StreamImage& out) = 0;
+};
+
+/**
+ * Streams viewport frames (and optionally the composited window) to socket
+ * clients. An encoder thread samples the source at up to max_fps and codes each
+ * changed frame once as a delta to the previous one, plus a key frame for
+ * clients that need one (new, behind, or asking after a decode error). An I/O thread accepts clients and
+ * writes their queues without blocking; a client whose queue exceeds
+ * max_queued_frames loses its backlog and resumes from the next key frame, so
+ * a slow client never holds up the display or other clients.
+ */
+class StreamServer {
+public:
+    StreamServer(StreamSource& source, const StreamServerParams& params);
+    ~StreamServer();
+
+    StreamServer(const StreamServer&) = delete;
+    StreamServer& operator=(const StreamServer&) = delete;
+
+    bool start(std::string& error);
+    void stop();
+
+    /**
+     * True if the display thread should read back the window for a composite
+     * frame now (composite streaming on, clients connected, interval elapsed).
+     */
+    bool wantsComposite();
+
+    /**
+     * Hand over the composited window as read back by glReadPixels (RGB, rows
+     * bottom-up). Display thread.
+     */
+    void submitComposite(int width, int height, const std::uint8_t* rgb_bottom_up);
+
+    size_t numClients();
+
+private:
+    using Packet = std::shared_ptr<const std::vector<std::uint8_t>>;
+
+    struct Client {
+        int fd = -1;
+        std::deque<Packet> queue;
+        size_t front_offset = 0;       // bytes of queue.front() already sent
+        std::set<size_t> has_key;      // streams this client can decode deltas for
+        bool greeted = false;          // hello fully sent
+        bool dead = false;
+    };
+
+    struct Encoder {
+        std::uint64_t last_seq = 0;
+        StreamImage prev;              // last frame sent, quantized
+        bool has_prev = false;
+    };
+
+    void encodeLoop();
+    void ioLoop();
+    void encodeStream(std::uint16_t wire_index, size_t key_slot, Encoder& enc, StreamImage& img, bool fresh);
+    Packet makePacket(std::uint16_t wire_index, const StreamImage& img, const std::uint8_t* residual, bool key);
+    bool enqueue(Client& c, const Packet& p);  // mutex_ held; false if the client's backlog was dropped
+    void wakeIo();
+
+    StreamSource& source_;
+    StreamServerParams params_;
+    int listen_fd_ = -1;
+    int wake_pipe_[2] = {-1, -1};
+    std::atomic<bool> stop_{false};
+    std::thread encode_thread_;
+    std::thread io_thread_;
+
+    std::mutex mutex_;                 // guards clients_ and the composite slot
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::atomic<size_t> num_clients_{0};
+    StreamImage composite_;
+    std::chrono::steady_clock::time_point last_composite_;
+
+    std::vector<Encoder> encoders_;    // encoder thread only
+    Encoder composite_encoder_;        // encoder thread only
+    StreamImage snapshot_;             // encoder thread only
+    std::vector<std::uint8_t> scratch_;  // residuals of the frame being coded
+    std::vector<std::uint8_t> coded_;
+    std::string unix_path_;            // removed on stop()
+};
+
+} // namespace viewportal
+
+#endif // STREAM_SERVER_H
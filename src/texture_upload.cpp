@@ -0,0 +1,133 @@
+#include "texture_upload.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace viewportal {
+
+void PendingUpload::markRect(int rx, int ry, int rw, int rh) {
+    if (rw <= 0 || rh <= 0) return;
+    if (full) return;
+    if (!pending) {
+        pending = true;
+        x = rx;
+        y = ry;
+        w = rw;
+        h = rh;
+        return;
+    }
+    const int x1 = std::max(x + w, rx + rw);
+    const int y1 = std::max(y + h, ry + rh);
+    x = std::min(x, rx);
+    y = std::min(y, ry);
+    w = x1 - x;
+    h = y1 - y;
+}
+
+bool unpackForStride(std::ptrdiff_t stride_bytes, int bytes_per_pixel, int& row_length, int& alignment) {
+    const std::ptrdiff_t stride = stride_bytes < 0 ? -stride_bytes : stride_bytes;
+    if (stride % bytes_per_pixel == 0) {
+        row_length = static_cast<int>(stride / bytes_per_pixel);
+        alignment = 1;
+        return true;
+    }
+    // Rows padded to 2, 4 or 8 bytes after a whole number of pixels
+    row_length = static_cast<int>(stride / bytes_per_pixel);
+    const std::ptrdiff_t used = static_cast<std::ptrdiff_t>(row_length) * bytes_per_pixel;
+    for (int a : {2, 4, 8}) {
+        if ((used + a - 1) / a * a == stride) {
+            alignment = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+void uploadTextureRect(pangolin::GlTexture& texture, const FrameData& frame, int bytes_per_pixel,
+                       int x, int y, int w, int h, GLenum gl_format, GLenum gl_type) {
+    const std::ptrdiff_t stride = frameRowStride(frame, bytes_per_pixel);
+    int row_length = frame.width;
+    int alignment = 1;
+    unpackForStride(stride, bytes_per_pixel, row_length, alignment);
+    const std::uint8_t* base = static_cast<const std::uint8_t*>(frame.data);
+    const std::uint8_t* first = nullptr;
+    int tex_y = y;
+    if (stride < 0) {
+        // Start at the lowest address: the rectangle's bottom row, bottom-up in the texture
+        first = base + (y + h - 1) * stride + static_cast<std::ptrdiff_t>(x) * bytes_per_pixel;
+        tex_y = frame.height - (y + h);
+    } else {
+        first = base + y * stride + static_cast<std::ptrdiff_t>(x) * bytes_per_pixel;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    texture.Upload(first, x, tex_y, w, h, gl_format, gl_type);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+namespace {
+
+const char* kQuadVertexShader = R"GLSL(
+#version 130
+out vec2 v_uv;
+void main() {
+    v_uv = gl_MultiTexCoord0.xy;
+    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+}
+)GLSL";
+
+} // namespace
+
+bool ensureQuadProgram(pangolin::GlSlProgram& program, bool& failed, const char* fragment_shader) {
+    if (failed) return false;
+    if (program.Valid()) return true;
+    if (!program.AddShader(pangolin::GlSlVertexShader, kQuadVertexShader) ||
+        !program.AddShader(pangolin::GlSlFragmentShader, fragment_shader) ||
+        !program.Link()) {
+        failed = true;
+        return false;
+    }
+    return true;
+}
+
+void beginQuadPass(pangolin::GlSlProgram& program, const pangolin::GlTexture& unit0, const pangolin::GlTexture& unit1,
+                   double left, double right, double bottom, double top) {
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(left, right, bottom, top, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glActiveTexture(GL_TEXTURE1);
+    unit1.Bind();
+    glActiveTexture(GL_TEXTURE0);
+    unit0.Bind();
+    program.Bind();
+}
+
+void endQuadPass(pangolin::GlSlProgram& program) {
+    static const GLfloat kQuad[] = {0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, kQuad);
+    glTexCoordPointer(2, GL_FLOAT, 0, kQuad);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    glPopClientAttrib();
+
+    program.Unbind();
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+} // namespace viewportal
@@ -0,0 +1,91 @@
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include "viewportal.h"
+#include <pangolin/gl/gl.h>
+#include <pangolin/gl/glsl.h>
+#include <cstddef>
+
+namespace viewportal {
+
+/**
+ * Part of the current frame an image viewport still has to upload. Region
+ * updates arriving between two draws are merged into their bounding rectangle;
+ * a full frame overrides any rectangle.
+ */
+struct PendingUpload {
+    bool pending = false;
+    bool full = false;
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+
+    void markFull() {
+        pending = true;
+        full = true;
+    }
+    void markRect(int rx, int ry, int rw, int rh);
+    void clear() { *this = PendingUpload(); }
+};
+
+/**
+ * Find the GL_UNPACK_ROW_LENGTH / GL_UNPACK_ALIGNMENT pair that steps rows
+ * |stride_bytes| apart. Returns false if GL cannot express the stride, in which
+ * case the rows have to be repacked.
+ */
+bool unpackForStride(std::ptrdiff_t stride_bytes, int bytes_per_pixel, int& row_length, int& alignment);
+
+/**
+ * Signed distance in bytes from one image row to the next (row_stride, or the
+ * packed row size when row_stride is 0).
+ */
+inline std::ptrdiff_t frameRowStride(const FrameData& frame, int bytes_per_pixel) {
+    return frame.row_stride != 0 ? static_cast<std::ptrdiff_t>(frame.row_stride)
+                                 : static_cast<std::ptrdiff_t>(frame.width) * bytes_per_pixel;
+}
+
+/**
+ * Upload the w x h rectangle at (x, y) of a frame into the same rectangle of a
+ * texture of the frame's size. Rows are read in place at the frame's stride,
+ * which must satisfy unpackForStride(). A frame with a negative stride is read
+ * from its lowest address, so its rows land bottom-up in the texture and it is
+ * drawn without the usual Y flip.
+ */
+void uploadTextureRect(pangolin::GlTexture& texture, const FrameData& frame, int bytes_per_pixel,
+                       int x, int y, int w, int h, GLenum gl_format, GLenum gl_type = GL_UNSIGNED_BYTE);
+
+/**
+ * Upload a whole frame; see uploadTextureRect().
+ */
+inline void uploadTexture(pangolin::GlTexture& texture, const FrameData& frame, int bytes_per_pixel, GLenum gl_format,
+                          GLenum gl_type = GL_UNSIGNED_BYTE) {
+    uploadTextureRect(texture, frame, bytes_per_pixel, 0, 0, frame.width, frame.height, gl_format, gl_type);
+}
+
+/**
+ * Link program from the shared full-viewport vertex shader, which passes the
+ * quad's texture coordinates on as "in vec2 v_uv", and fragment_shader. A
+ * failed build is remembered in failed and not retried. \return whether the
+ * program can be used.
+ */
+bool ensureQuadProgram(pangolin::GlSlProgram& program, bool& failed, const char* fragment_shader);
+
+/**
+ * Start a shader pass over the unit square: the projection maps
+ * [left, right] x [bottom, top] onto the viewport, unit0 and unit1 are bound to
+ * texture units 0 and 1 and program is bound, ready for its uniforms. Both
+ * matrices are saved; endQuadPass() draws the quad and restores them.
+ */
+void beginQuadPass(pangolin::GlSlProgram& program, const pangolin::GlTexture& unit0, const pangolin::GlTexture& unit1,
+                   double left, double right, double bottom, double top);
+
+/**
+ * Draw the unit square (texture coordinates equal to its positions), unbind
+ * what beginQuadPass() bound and restore the matrices.
+ */
+void endQuadPass(pangolin::GlSlProgram& program);
+
+} // namespace viewportal
+
+#endif // TEXTURE_UPLOAD_H
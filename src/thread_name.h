@@ -0,0 +1,27 @@
+#ifndef THREAD_NAME_H
+#define THREAD_NAME_H
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+namespace viewportal {
+
+/**
+ * Name the calling thread, as shown by debuggers, top -H and
+ * /proc/<pid>/task/<tid>/comm. Linux keeps the first 15 characters. No-op on
+ * platforms without pthread names.
+ */
+inline void setThreadName(const char* name) {
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), name);
+#elif defined(__APPLE__)
+    pthread_setname_np(name);
+#else
+    (void)name;
+#endif
+}
+
+} // namespace viewportal
+
+#endif // THREAD_NAME_H
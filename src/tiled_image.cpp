@@ -0,0 +1,251 @@
+#include "tiled_image.h"
+#include "texture_upload.h"
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+
+namespace viewportal {
+
+namespace {
+
+constexpr int kTiledThreshold = 4096;  // longest side above which images are tiled
+
+int formatBytes(ImageFormat fmt) {
+    switch (fmt) {
+        case ImageFormat::RGBA8: return 4;
+        case ImageFormat::Luminance8: return 1;
+        default: return 3;
+    }
+}
+
+GLenum glFormat(ImageFormat fmt) {
+    switch (fmt) {
+        case ImageFormat::RGBA8: return GL_RGBA;
+        case ImageFormat::Luminance8: return GL_LUMINANCE;
+        default: return GL_RGB;
+    }
+}
+
+std::uint64_t tileKey(int level, int tx, int ty) {
+    return (static_cast<std::uint64_t>(level) << 48) |
+           (static_cast<std::uint64_t>(ty) << 24) |
+           static_cast<std::uint64_t>(tx);
+}
+
+// 2x2 box filter; odd trailing rows/columns are clamped.
+void downsample(const std::uint8_t* src, std::ptrdiff_t src_stride, int sw, int sh, int bpp,
+                std::uint8_t* dst, int dw, int dh) {
+    for (int y = 0; y < dh; ++y) {
+        const std::uint8_t* r0 = src + std::min(2 * y, sh - 1) * src_stride;
+        const std::uint8_t* r1 = src + std::min(2 * y + 1, sh - 1) * src_stride;
+        std::uint8_t* out = dst + static_cast<size_t>(y) * dw * bpp;
+        for (int x = 0; x < dw; ++x) {
+            const int x0 = 2 * x * bpp;
+            const int x1 = std::min(2 * x + 1, sw - 1) * bpp;
+            for (int c = 0; c < bpp; ++c)
+                out[x * bpp + c] = static_cast<std::uint8_t>((r0[x0 + c] + r0[x1 + c] + r1[x0 + c] + r1[x1 + c] + 2) >> 2);
+        }
+    }
+}
+
+} // namespace
+
+TiledImage::TiledImage(int tile_size, size_t max_resident_tiles)
+    : tile_size_(tile_size), max_resident_tiles_(std::max<size_t>(max_resident_tiles, 4)) {}
+
+bool TiledImage::wanted(int width, int height) {
+    static GLint max_texture = 0;
+    if (max_texture == 0)
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture);
+    const int limit = std::min(kTiledThreshold, max_texture > 0 ? static_cast<int>(max_texture) : kTiledThreshold);
+    return width > limit || height > limit;
+}
+
+void TiledImage::setImage(const FrameData& frame) {
+    const int bpp = formatBytes(frame.format);
+    if (frame.width != width_ || frame.height != height_ || frame.format != format_) {
+        width_ = frame.width;
+        height_ = frame.height;
+        format_ = frame.format;
+        bpp_ = bpp;
+        tiles_.clear();
+        last_used_.clear();
+        lru_.clear();
+        levels_.clear();
+        int w = width_, h = height_;
+        while (true) {
+            Level l;
+            l.width = w;
+            l.height = h;
+            levels_.push_back(std::move(l));
+            if (w <= tile_size_ && h <= tile_size_) break;
+            w = std::max(1, (w + 1) / 2);
+            h = std::max(1, (h + 1) / 2);
+        }
+    }
+    ++generation_;
+    // Tiles are uploaded lazily, long after the frame's buffer may have been
+    // reused or freed: keep a packed copy
+    Level& base = levels_[0];
+    const std::ptrdiff_t stride = frameRowStride(frame, bpp);
+    const size_t row_bytes = static_cast<size_t>(width_) * bpp;
+    base.storage.resize(row_bytes * height_);
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(frame.data);
+    if (stride == static_cast<std::ptrdiff_t>(row_bytes)) {
+        std::memcpy(base.storage.data(), src, base.storage.size());
+    } else {
+        for (int y = 0; y < height_; ++y)
+            std::memcpy(base.storage.data() + y * row_bytes, src + y * stride, row_bytes);
+    }
+    base.data = base.storage.data();
+    base.stride = static_cast<std::ptrdiff_t>(row_bytes);
+    base.built = true;
+    for (size_t i = 1; i < levels_.size(); ++i)
+        levels_[i].built = false;
+}
+
+const TiledImage::Level& TiledImage::level(int index) {
+    Level& l = levels_[index];
+    if (!l.built) {
+        const Level& prev = level(index - 1);
+        l.storage.resize(static_cast<size_t>(l.width) * l.height * bpp_);
+        downsample(prev.data, prev.stride, prev.width, prev.height, bpp_, l.storage.data(), l.width, l.height);
+        l.data = l.storage.data();
+        l.stride = static_cast<std::ptrdiff_t>(l.width) * bpp_;
+        l.built = true;
+    }
+    return l;
+}
+
+void TiledImage::uploadTile(Tile& tile, int level_index, int tx, int ty) {
+    const Level& l = level(level_index);
+    const int x0 = tx * tile_size_;
+    const int y0 = ty * tile_size_;
+    const int w = std::min(tile_size_, l.width - x0);
+    const int h = std::min(tile_size_, l.height - y0);
+    const GLenum fmt = glFormat(format_);
+    if (!tile.texture.IsValid()) {
+        tile.texture.Reinitialise(tile_size_, tile_size_, fmt == GL_LUMINANCE ? GL_LUMINANCE8 : (fmt == GL_RGBA ? GL_RGBA8 : GL_RGB8),
+                                  true, 0, fmt, GL_UNSIGNED_BYTE);
+    }
+    const std::uint8_t* src = l.data + y0 * l.stride + static_cast<std::ptrdiff_t>(x0) * bpp_;
+    if (w < tile_size_ || h < tile_size_) {
+        // Edge tile: pad with the last column and row, so the mipmaps never
+        // average in texels that were not written
+        const size_t tile_row = static_cast<size_t>(tile_size_) * bpp_;
+        edge_tile_.resize(tile_row * tile_size_);
+        for (int y = 0; y < tile_size_; ++y) {
+            const std::uint8_t* row = src + std::min(y, h - 1) * l.stride;
+            std::uint8_t* out = edge_tile_.data() + y * tile_row;
+            std::memcpy(out, row, static_cast<size_t>(w) * bpp_);
+            for (int x = w; x < tile_size_; ++x)
+                std::memcpy(out + static_cast<size_t>(x) * bpp_, row + static_cast<size_t>(w - 1) * bpp_, bpp_);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        tile.texture.Upload(edge_tile_.data(), 0, 0, tile_size_, tile_size_, fmt, GL_UNSIGNED_BYTE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    } else {
+        int row_length = l.width, alignment = 1;
+        unpackForStride(l.stride, bpp_, row_length, alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+        tile.texture.Upload(src, 0, 0, w, h, fmt, GL_UNSIGNED_BYTE);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    tile.texture.Bind();
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    tile.generation = generation_;
+}
+
+TiledImage::Tile& TiledImage::residentTile(int level_index, int tx, int ty, std::uint64_t frame_stamp) {
+    const std::uint64_t key = tileKey(level_index, tx, ty);
+    auto it = tiles_.find(key);
+    if (it != tiles_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        last_used_[key] = frame_stamp;
+        if (it->second.generation != generation_)
+            uploadTile(it->second, level_index, tx, ty);
+        return it->second;
+    }
+
+    Tile tile;
+    // Evict the least recently used tile not needed this frame and reuse its texture.
+    if (tiles_.size() >= max_resident_tiles_ && !lru_.empty() && last_used_[lru_.back()] != frame_stamp) {
+        const std::uint64_t victim = lru_.back();
+        lru_.pop_back();
+        auto vit = tiles_.find(victim);
+        tile.texture = std::move(vit->second.texture);
+        tiles_.erase(vit);
+        last_used_.erase(victim);
+    }
+    lru_.push_front(key);
+    tile.lru = lru_.begin();
+    Tile& t = tiles_.emplace(key, std::move(tile)).first->second;
+    last_used_[key] = frame_stamp;
+    uploadTile(t, level_index, tx, ty);
+    return t;
+}
+
+void TiledImage::render(const ImageRegion& region, int view_width, int view_height) {
+    if (levels_.empty() || view_width <= 0 || view_height <= 0) return;
+    ++frame_stamp_;
+
+    // Pick the level whose resolution best matches the on-screen scale.
+    const float image_px_per_screen_px = std::max((region.x1 - region.x0) / view_width,
+                                                  (region.y1 - region.y0) / view_height);
+    int lvl = image_px_per_screen_px > 1.0f ? static_cast<int>(std::floor(std::log2(image_px_per_screen_px))) : 0;
+    lvl = std::clamp(lvl, 0, static_cast<int>(levels_.size()) - 1);
+    const Level& l = levels_[lvl];
+    const float scale = static_cast<float>(1 << lvl);  // level pixels -> image pixels
+    const float span = tile_size_ * scale;
+
+    const int tx0 = std::max(0, static_cast<int>(std::floor(region.x0 / span)));
+    const int ty0 = std::max(0, static_cast<int>(std::floor(region.y0 / span)));
+    const int tx1 = std::min((l.width - 1) / tile_size_, static_cast<int>(std::floor(region.x1 / span)));
+    const int ty1 = std::min((l.height - 1) / tile_size_, static_cast<int>(std::floor(region.y1 / span)));
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(region.x0, region.x1, region.y1, region.y0, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnable(GL_TEXTURE_2D);
+    for (int ty = ty0; ty <= ty1; ++ty) {
+        for (int tx = tx0; tx <= tx1; ++tx) {
+            Tile& tile = residentTile(lvl, tx, ty, frame_stamp_);
+            const int w = std::min(tile_size_, l.width - tx * tile_size_);
+            const int h = std::min(tile_size_, l.height - ty * tile_size_);
+            const GLfloat x0 = tx * span;
+            const GLfloat y0 = ty * span;
+            const GLfloat x1 = std::min(x0 + w * scale, static_cast<float>(width_));
+            const GLfloat y1 = std::min(y0 + h * scale, static_cast<float>(height_));
+            const GLfloat u1 = static_cast<GLfloat>(w) / tile_size_;
+            const GLfloat v1 = static_cast<GLfloat>(h) / tile_size_;
+            const GLfloat verts[] = {x0, y0, x1, y0, x1, y1, x0, y1};
+            const GLfloat tex[] = {0, 0, u1, 0, u1, v1, 0, v1};
+            tile.texture.Bind();
+            glVertexPointer(2, GL_FLOAT, 0, verts);
+            glTexCoordPointer(2, GL_FLOAT, 0, tex);
+            glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glPopClientAttrib();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+} // namespace viewportal
@@ -0,0 +1,82 @@
+#ifndef TILED_IMAGE_H
+#define TILED_IMAGE_H
+
+#include "viewportal.h"
+#include "image_zoom.h"
+#include <pangolin/gl/gl.h>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Displays images larger than a single texture (or too large to upload every
+ * frame) as a tiled, mipmapped pyramid. Level 0 is the source; each further
+ * level halves the resolution and is built on the CPU only when first needed.
+ * Only tiles visible in the current zoom region, at the level matching the
+ * on-screen scale, are uploaded; resident tiles are bounded by an LRU cache and
+ * evicted tiles' textures are reused.
+ */
+class TiledImage {
+public:
+    explicit TiledImage(int tile_size = 512, size_t max_resident_tiles = 96);
+
+    /**
+     * True if an image of this size should use the tiled path.
+     */
+    static bool wanted(int width, int height);
+
+    /**
+     * Set the current image. The pixels are copied, so the frame may be released
+     * right after; cached tiles are refreshed lazily when next visible.
+     */
+    void setImage(const FrameData& frame);
+
+    /**
+     * Draw the visible region into the active view, uploading missing tiles.
+     */
+    void render(const ImageRegion& region, int view_width, int view_height);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+private:
+    struct Level {
+        int width = 0;
+        int height = 0;
+        const std::uint8_t* data = nullptr;
+        std::ptrdiff_t stride = 0;          // bytes between rows
+        std::vector<std::uint8_t> storage;
+        bool built = false;
+    };
+
+    struct Tile {
+        pangolin::GlTexture texture;
+        std::uint64_t generation = 0;
+        std::list<std::uint64_t>::iterator lru;
+    };
+
+    const Level& level(int index);
+    Tile& residentTile(int level, int tx, int ty, std::uint64_t frame_stamp);
+    void uploadTile(Tile& tile, int level, int tx, int ty);
+
+    int tile_size_;
+    size_t max_resident_tiles_;
+    int width_ = 0;
+    int height_ = 0;
+    int bpp_ = 3;
+    ImageFormat format_ = ImageFormat::RGB8;
+    std::uint64_t generation_ = 0;   // bumped per image; tiles with an older one are stale
+    std::uint64_t frame_stamp_ = 0;  // bumped per render; tiles used this frame are not evicted
+    std::vector<Level> levels_;
+    std::unordered_map<std::uint64_t, Tile> tiles_;
+    std::unordered_map<std::uint64_t, std::uint64_t> last_used_;
+    std::list<std::uint64_t> lru_;  // front = most recently used
+    std::vector<std::uint8_t> edge_tile_;  // padded upload of a partial tile
+};
+
+} // namespace viewportal
+
+#endif // TILED_IMAGE_H
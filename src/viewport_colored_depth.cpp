@@ -1,37 +1,45 @@
 #include "viewport.h"
+#include "viewport_overlay.h"
+#include "viewport_mask.h"
+#include "colormap.h"
+#include "depth_range.h"
+#include "texture_upload.h"
+#include "buffer_pool.h"
+#include "image_format.h"
 #include <pangolin/display/display.h>
 #include <pangolin/gl/gl.h>
+#include <pangolin/gl/glsl.h>
 #include <pangolin/var/var.h>
+#include <algorithm>
 #include <memory>
 #include <cstring>
-#include <cmath>
-#include <algorithm>
 
 namespace viewportal {
 
 namespace {
 
-// JET-like colormap LUT: 256 entries, RGB (same order as GL_RGB)
-void buildJetRgbLut(unsigned char* lut) {
-    for (int i = 0; i < 256; ++i) {
-        float t = i / 255.0f;
-        float r = std::clamp(1.5f - 4.0f * std::abs(t - 0.75f), 0.0f, 1.0f);
-        float g = std::clamp(1.5f - 4.0f * std::abs(t - 0.5f),  0.0f, 1.0f);
-        float b = std::clamp(1.5f - 4.0f * std::abs(t - 0.25f), 0.0f, 1.0f);
-        lut[i * 3 + 0] = static_cast<unsigned char>(r * 255.0f);
-        lut[i * 3 + 1] = static_cast<unsigned char>(g * 255.0f);
-        lut[i * 3 + 2] = static_cast<unsigned char>(b * 255.0f);
+// Value -> [0, 1] -> colormap LUT; NaN and inf take the invalid color
+const char* kDepthFragmentShader = R"GLSL(
+#version 130
+uniform sampler2D u_depth;
+uniform sampler2D u_lut;
+uniform float u_low;
+uniform float u_scale;
+uniform vec4 u_invalid;
+in vec2 v_uv;
+void main() {
+    float v = texture(u_depth, v_uv).r;
+    if (isnan(v) || isinf(v)) {
+        gl_FragColor = u_invalid;
+        return;
     }
+    float t = clamp((v - u_low) * u_scale, 0.0, 1.0);
+    gl_FragColor = vec4(texture(u_lut, vec2((t * 255.0 + 0.5) / 256.0, 0.5)).rgb, 1.0);
 }
+)GLSL";
 
-void applyJetToG8(const unsigned char* g8, int width, int height, unsigned char* rgb, const unsigned char* lut) {
-    const size_t n = static_cast<size_t>(width) * height;
-    for (size_t i = 0; i < n; ++i) {
-        unsigned char v = g8[i];
-        rgb[i * 3 + 0] = lut[v * 3 + 0];
-        rgb[i * 3 + 1] = lut[v * 3 + 1];
-        rgb[i * 3 + 2] = lut[v * 3 + 2];
-    }
+unsigned char toByte(float v) {
+    return static_cast<unsigned char>(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
 }
 
 } // namespace
@@ -41,18 +49,11 @@ public:
     ColoredDepthViewport(const std::string& name, float aspect_ratio, int width, int height)
         : name_(name),
           width_(width),
-          height_(height),
-          rgb_buffer_(nullptr) {
-        rgb_buffer_ = new unsigned char[3 * width_ * height_];
-        colorTexture_ = pangolin::GlTexture(width_, height_, GL_RGB, false, 0, GL_RGB, GL_UNSIGNED_BYTE);
+          height_(height) {
         view_ = &pangolin::Display(name).SetAspect(aspect_ratio);
-    }
-
-    ~ColoredDepthViewport() override {
-        if (rgb_buffer_) {
-            delete[] rgb_buffer_;
-            rgb_buffer_ = nullptr;
-        }
+        buildColormapLut(params_.colormap, colormap_lut_);
+        setInvalidColor();
+        buildRangeLut(colormap_lut_, 0.0f, 255.0f, invalid_rgb_, lut_);
     }
 
     pangolin::View& getView() override { return *view_; }
@@ -60,35 +61,120 @@ public:
 
     void setFrame(const FrameData& frame) override {
         user_frame_ = frame;
+        upload_.markFull();
+    }
+
+    void setFrameRegion(const FrameData& frame, int x, int y, int w, int h) override {
+        user_frame_ = frame;
+        upload_.markRect(x, y, w, h);
+    }
+
+    bool retainsFrame() const override { return !(float_frame_ && gpu_colormap_); }  // a new colormap or range recolors it on the CPU
+
+    void reserve(int width, int height, ImageFormat format) override {
+        (void)format;  // the float texture follows the first frame's format
+        // Textures are created at this size by the first update(), so a viewport
+        // that is never shown allocates none
+        if (width == width_ && height == height_) return;
+        width_ = width;
+        height_ = height;
+        colorTexture_.Delete();
+        float_texture_.Delete();
+    }
+
+    bool imagePosition(float x, float y, float& image_x, float& image_y) const override {
+        const ImageRegion region{0.0f, 0.0f, static_cast<float>(width_), static_cast<float>(height_)};
+        return user_frame_.data != nullptr && viewToImage(*view_, region, x, y, image_x, image_y);
+    }
+
+    const pangolin::GlTexture* displayTexture(bool& bottom_up) const override {
+        bottom_up = false;
+        return (float_frame_ && gpu_colormap_) || !colorTexture_.IsValid() ? nullptr : &colorTexture_;  // the shader colors on the fly
+    }
+
+    void setOverlay(std::shared_ptr<const Overlay> overlay) override {
+        overlay_.set(std::move(overlay));
+    }
+
+    void setMask(std::shared_ptr<const MaskFrame> mask) override {
+        mask_.setMask(mask.get());
+    }
+
+    void setMaskPalette(std::shared_ptr<const MaskPalette> palette) override {
+        mask_.setPalette(std::move(palette));
+    }
+
+    void setColormap(std::shared_ptr<const ColormapParams> params) override {
+        params_ = params ? *params : ColormapParams();
+        buildColormapLut(params_.colormap, colormap_lut_);
+        setInvalidColor();
+        if (auto_range_var_) *auto_range_var_ = params_.auto_range;
+        auto_range_.reset();
+        lut_texture_dirty_ = true;
+        low_ = params_.min;
+        high_ = params_.max;
+        // The shader applies a new range as is; the RGB copy of 8-bit frames (and
+        // of float frames without the shader) has to be redone
+        if (user_frame_.data != nullptr && !(float_frame_ && gpu_colormap_)) upload_.markFull();
+    }
+
+    void prepare() override {
+        if (prepared_) return;
+        prepared_ = true;
+        prepared_upload_.clear();
+        rows_colored_ = false;
+        if (user_frame_.data == nullptr || user_frame_.width <= 0 || user_frame_.height <= 0 || !upload_.pending)
+            return;
+        prepared_upload_ = upload_;
+        upload_.clear();
+        if (isFloatFormat(user_frame_.format))
+            prepareFloat();
+        else
+            prepareG8();
     }
 
     void update() override {
+        prepare();  // unless the display already ran it on a worker
+        prepared_ = false;
         if (user_frame_.data != nullptr && user_frame_.width > 0 && user_frame_.height > 0) {
+            if (!prepared_upload_.pending) return;
+            cleared_ = false;
             ensureTextureSize(user_frame_.width, user_frame_.height);
-            if (user_frame_.format == ImageFormat::Luminance8) {
-                unsigned char jet_lut[256 * 3];
-                buildJetRgbLut(jet_lut);
-                const auto* g8 = static_cast<const unsigned char*>(user_frame_.data);
-                applyJetToG8(g8, user_frame_.width, user_frame_.height, rgb_buffer_, jet_lut);
-                colorTexture_.Upload(rgb_buffer_, GL_RGB, GL_UNSIGNED_BYTE);
+            if (float_frame_) {
+                updateFloat();
+                return;
             }
+            if (rows_colored_) uploadColored();
             return;
         }
-        std::memset(rgb_buffer_, 0, static_cast<size_t>(3 * width_ * height_));
-        colorTexture_.Upload(rgb_buffer_, GL_RGB, GL_UNSIGNED_BYTE);
+        // Black until the first frame; uploaded once
+        if (cleared_ && colorTexture_.IsValid()) return;
+        float_frame_ = false;
+        ensureTextureSize(width_, height_);
+        rgb_buffer_.resize(static_cast<size_t>(3 * width_ * height_));
+        std::memset(rgb_buffer_.data(), 0, rgb_buffer_.size());
+        colorTexture_.Upload(rgb_buffer_.data(), GL_RGB, GL_UNSIGNED_BYTE);
+        cleared_ = true;
     }
 
     void render() override {
         if (view_->IsShown()) {
             view_->Activate();
             glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-            colorTexture_.RenderToViewportFlipY();
+            if (float_frame_ && gpu_colormap_)
+                renderFloat();
+            else
+                colorTexture_.RenderToViewportFlipY();
+            const ImageRegion region{0.0f, 0.0f, static_cast<float>(width_), static_cast<float>(height_)};
+            mask_.render(region, width_, height_);
+            overlay_.render(region);
         }
     }
 
     void setupUI() override {
         std::string prefix = "ui." + name_ + ".";
         show_view_ = std::make_unique<pangolin::Var<bool>>(prefix + "Show", true, true);
+        auto_range_var_ = std::make_unique<pangolin::Var<bool>>(prefix + "Auto_Range", params_.auto_range, true);
     }
 
     bool isShown() const override {
@@ -96,26 +182,245 @@ public:
     }
 
 private:
-    void ensureTextureSize(int w, int h) {
-        if (w == width_ && h == height_) return;
+    /**
+     * Refresh lut_ for a full frame: the plain colormap, or stretched to the
+     * auto range after folding in this frame's samples.
+     */
+    void updateLut(const unsigned char* g8, std::ptrdiff_t stride, bool resized) {
+        if (!autoRange()) {
+            auto_range_.reset();
+            buildRangeLut(colormap_lut_, params_.min, params_.max, invalid_rgb_, lut_);
+            return;
+        }
+        if (resized) auto_range_.reset();  // probably a different stream
+        auto_range_.observe(g8, user_frame_.width, user_frame_.height, stride);
+        if (auto_range_.valid())
+            auto_range_.buildLut(colormap_lut_, invalid_rgb_, lut_);
+        else
+            buildRangeLut(colormap_lut_, 0.0f, 255.0f, invalid_rgb_, lut_);
+    }
+
+    bool autoRange() const {
+        return auto_range_var_ ? auto_range_var_->Get() : params_.auto_range;
+    }
+
+    void setInvalidColor() {
+        invalid_rgb_[0] = toByte(params_.invalid_color.r);
+        invalid_rgb_[1] = toByte(params_.invalid_color.g);
+        invalid_rgb_[2] = toByte(params_.invalid_color.b);
+    }
+
+    /** Colormap the rows of an 8-bit frame covered by the pending upload (prepare()). */
+    void prepareG8() {
+        const bool was_float = float_frame_;
+        float_frame_ = false;
+        const bool resized = textureStale(user_frame_.width, user_frame_.height) || was_float;
+        if (resized) {
+            prepared_upload_.markFull();
+            rgb_buffer_.resize(static_cast<size_t>(3 * user_frame_.width * user_frame_.height));
+        }
+        if (user_frame_.format != ImageFormat::Luminance8) return;
+        const auto* g8 = static_cast<const unsigned char*>(user_frame_.data);
+        const std::ptrdiff_t stride = frameRowStride(user_frame_, 1);
+        if (prepared_upload_.full) {
+            // The range follows full frames only; region updates reuse the current LUT
+            updateLut(g8, stride, resized);
+            if (stride == user_frame_.width) {
+                applyJetToG8(g8, user_frame_.width, user_frame_.height, rgb_buffer_.data(), lut_);
+            } else {
+                for (int row = 0; row < user_frame_.height; ++row)
+                    applyJetToG8(g8 + row * stride, user_frame_.width, 1,
+                                 rgb_buffer_.data() + static_cast<size_t>(row) * user_frame_.width * 3, lut_);
+            }
+        } else {
+            const PendingUpload& upload = prepared_upload_;
+            for (int row = upload.y; row < upload.y + upload.h; ++row) {
+                const size_t offset = static_cast<size_t>(row) * user_frame_.width + upload.x;
+                applyJetToG8(g8 + row * stride + upload.x, upload.w, 1, rgb_buffer_.data() + 3 * offset, lut_);
+            }
+        }
+        rows_colored_ = true;
+    }
+
+    /**
+     * Float frames: the raw values go to a single-channel float texture and the
+     * shader colors them, so range changes cost no upload. Without the shader,
+     * rows are colormapped on the CPU into the RGB texture. prepare() follows
+     * the range and, once the shader is known to be unavailable, colormaps.
+     */
+    void prepareFloat() {
+        const ImageFormat fmt = user_frame_.format;
+        const std::ptrdiff_t stride = frameRowStride(user_frame_, bytesPerPixel(fmt));
+        const bool reformatted = !float_frame_ || fmt != float_format_;
+        const bool resized = textureStale(user_frame_.width, user_frame_.height);
+        if (resized) rgb_buffer_.resize(static_cast<size_t>(3 * user_frame_.width * user_frame_.height));
+        if (reformatted || resized) prepared_upload_.markFull();
+        if (prepared_upload_.full) {
+            // The range follows full frames only, as for 8-bit depth
+            if (reformatted || resized || !autoRange()) auto_range_.reset();
+            if (autoRange())
+                auto_range_.observeFloat(user_frame_.data, fmt, user_frame_.width, user_frame_.height, stride);
+        }
+        float_frame_ = true;
+        float_format_ = fmt;
+        low_ = auto_range_.valid() ? auto_range_.low() : params_.min;
+        high_ = auto_range_.valid() ? auto_range_.high() : params_.max;
+        if (program_failed_) colormapFloatRows();
+    }
+
+    /** CPU fallback: colormap the pending rows of a float frame into the packed RGB copy. */
+    void colormapFloatRows() {
+        const ImageFormat fmt = user_frame_.format;
+        const int bpp = bytesPerPixel(fmt);
+        const std::ptrdiff_t stride = frameRowStride(user_frame_, bpp);
+        int x0, y0, w, h;
+        pendingRect(x0, y0, w, h);
+        const auto* top = static_cast<const std::uint8_t*>(user_frame_.data);
+        for (int row = y0; row < y0 + h; ++row) {
+            const std::uint8_t* src = top + row * stride + static_cast<std::ptrdiff_t>(x0) * bpp;
+            unsigned char* dst = rgb_buffer_.data() + (static_cast<size_t>(row) * user_frame_.width + x0) * 3;
+            if (fmt == ImageFormat::Float32)
+                colormapFloatRow(reinterpret_cast<const float*>(src), w, low_, high_, colormap_lut_, invalid_rgb_, dst);
+            else
+                colormapHalfRow(reinterpret_cast<const std::uint16_t*>(src), w, low_, high_, colormap_lut_, invalid_rgb_, dst);
+        }
+        rows_colored_ = true;
+    }
+
+    /** Upload the float frame, or its colormapped rows without the shader (display thread). */
+    void updateFloat() {
+        const ImageFormat fmt = user_frame_.format;
+        const int bpp = bytesPerPixel(fmt);
+        gpu_colormap_ = ensureProgram();
+        if (gpu_colormap_) {
+            const PendingUpload& upload = prepared_upload_;
+            const bool bottom_up = user_frame_.row_stride < 0;
+            const GLenum gl_type = fmt == ImageFormat::Float32 ? GL_FLOAT : GL_HALF_FLOAT;
+            const bool reallocated = ensureFloatTexture(fmt);
+            if (upload.full || reallocated || bottom_up != bottom_up_)
+                uploadTexture(float_texture_, user_frame_, bpp, GL_RED, gl_type);
+            else
+                uploadTextureRect(float_texture_, user_frame_, bpp, upload.x, upload.y, upload.w, upload.h, GL_RED, gl_type);
+            bottom_up_ = bottom_up;
+            return;
+        }
+        if (!rows_colored_) colormapFloatRows();  // the shader just failed to build
+        uploadColored();
+    }
+
+    /** Upload the colormapped rows of the pending upload to colorTexture_. */
+    void uploadColored() {
+        FrameData rgb;  // colormapped copy: packed, top row first
+        rgb.width = width_;
+        rgb.height = height_;
+        rgb.format = ImageFormat::RGB8;
+        rgb.data = rgb_buffer_.data();
+        int x0, y0, w, h;
+        pendingRect(x0, y0, w, h);
+        if (prepared_upload_.full)
+            uploadTexture(colorTexture_, rgb, 3, GL_RGB);
+        else
+            uploadTextureRect(colorTexture_, rgb, 3, x0, y0, w, h, GL_RGB);
+    }
+
+    /** Pixels covered by the pending upload: the whole frame or the changed rectangle. */
+    void pendingRect(int& x0, int& y0, int& w, int& h) const {
+        const PendingUpload& upload = prepared_upload_;
+        x0 = upload.full ? 0 : upload.x;
+        y0 = upload.full ? 0 : upload.y;
+        w = upload.full ? user_frame_.width : upload.w;
+        h = upload.full ? user_frame_.height : upload.h;
+    }
+
+    bool ensureProgram() {
+        return ensureQuadProgram(program_, program_failed_, kDepthFragmentShader);
+    }
+
+    void renderFloat() {
+        if (lut_texture_dirty_ || !lut_texture_.IsValid()) {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            lut_texture_.Reinitialise(256, 1, GL_RGB8, true, 0, GL_RGB, GL_UNSIGNED_BYTE, colormap_lut_);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            lut_texture_dirty_ = false;
+        }
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // Texture row 0 is the top image row unless the frame was uploaded bottom-up
+        beginQuadPass(program_, float_texture_, lut_texture_, 0.0, 1.0, bottom_up_ ? 0.0 : 1.0, bottom_up_ ? 1.0 : 0.0);
+        const float span = high_ - low_;
+        program_.SetUniform("u_depth", 0);
+        program_.SetUniform("u_lut", 1);
+        program_.SetUniform("u_low", low_);
+        program_.SetUniform("u_scale", span > 0.0f ? 1.0f / span : 0.0f);
+        program_.SetUniform("u_invalid", params_.invalid_color.r, params_.invalid_color.g,
+                            params_.invalid_color.b, params_.invalid_color.a);
+
+        endQuadPass(program_);
+        glPopAttrib();
+    }
+
+    /** True if ensureTextureSize(w, h) will reallocate; safe off the display thread. */
+    bool textureStale(int w, int h) const {
+        return w != width_ || h != height_ || !colorTexture_.IsValid();
+    }
+
+    /** \return true if the texture was reallocated and needs a full upload. */
+    bool ensureTextureSize(int w, int h) {
+        if (!textureStale(w, h)) return false;
         width_ = w;
         height_ = h;
-        if (rgb_buffer_) {
-            delete[] rgb_buffer_;
-            rgb_buffer_ = nullptr;
-        }
-        rgb_buffer_ = new unsigned char[3 * width_ * height_];
         colorTexture_ = pangolin::GlTexture(width_, height_, GL_RGB, false, 0, GL_RGB, GL_UNSIGNED_BYTE);
+        return true;
+    }
+
+    /** Size the shader's input texture for fmt frames; \return true if it was reallocated. */
+    bool ensureFloatTexture(ImageFormat fmt) {
+        if (float_texture_.IsValid() && float_texture_format_ == fmt &&
+            float_texture_.width == width_ && float_texture_.height == height_)
+            return false;
+        float_texture_.Reinitialise(width_, height_, fmt == ImageFormat::Float32 ? GL_R32F : GL_R16F, false, 0,
+                                    GL_RED, fmt == ImageFormat::Float32 ? GL_FLOAT : GL_HALF_FLOAT);
+        float_texture_format_ = fmt;
+        return true;
     }
 
     std::string name_;
     pangolin::View* view_;
     int width_;
     int height_;
-    unsigned char* rgb_buffer_;
+    PooledBuffer rgb_buffer_;  // colormapped frame, RGB
     pangolin::GlTexture colorTexture_;
     std::unique_ptr<pangolin::Var<bool>> show_view_;
+    MaskLayer mask_;
+    OverlayRenderer overlay_;
     FrameData user_frame_;
+    PendingUpload upload_;
+    // Handed from prepare() to update()
+    bool prepared_ = false;
+    PendingUpload prepared_upload_;  // what update() uploads; full after a reallocation
+    bool rows_colored_ = false;      // its rows are colormapped into rgb_buffer_
+    bool cleared_ = false;           // the black placeholder is uploaded
+    ColormapParams params_;
+    unsigned char colormap_lut_[256 * 3];
+    unsigned char lut_[256 * 3];  // applied by the 8-bit colormap pass
+    unsigned char invalid_rgb_[3];
+    DepthAutoRange auto_range_;
+    std::unique_ptr<pangolin::Var<bool>> auto_range_var_;
+    // Float frames
+    bool float_frame_ = false;     // the last frame was Float32/Float16
+    ImageFormat float_format_ = ImageFormat::Float32;
+    bool gpu_colormap_ = false;    // drawn by the shader rather than through colorTexture_
+    bool bottom_up_ = false;
+    float low_ = 0.0f;             // range applied to float frames
+    float high_ = 255.0f;
+    pangolin::GlTexture float_texture_;
+    ImageFormat float_texture_format_ = ImageFormat::Float32;
+    pangolin::GlTexture lut_texture_;
+    bool lut_texture_dirty_ = true;
+    pangolin::GlSlProgram program_;
+    bool program_failed_ = false;
 };
 
 std::unique_ptr<Viewport> createColoredDepthViewport(const std::string& name, float aspect_ratio, int width, int height) {
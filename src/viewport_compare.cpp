@@ -0,0 +1,182 @@
+#include "viewport.h"
+#include "texture_upload.h"
+#include <pangolin/display/display.h>
+#include <pangolin/gl/gl.h>
+#include <pangolin/gl/glsl.h>
+#include <pangolin/handler/handler.h>
+#include <pangolin/var/var.h>
+#include <algorithm>
+#include <memory>
+
+namespace viewportal {
+
+namespace {
+
+// v_uv has a top-left origin; textures store the top row first unless flipped
+const char* kCompareFragmentShader = R"GLSL(
+#version 130
+uniform sampler2D u_a;
+uniform sampler2D u_b;
+uniform int u_flip_a;
+uniform int u_flip_b;
+uniform int u_mode;
+uniform float u_gain;
+uniform float u_threshold;
+uniform float u_split;
+uniform float u_pixel;
+in vec2 v_uv;
+vec3 fetch(sampler2D t, int flip) {
+    return texture(t, flip != 0 ? vec2(v_uv.x, 1.0 - v_uv.y) : v_uv).rgb;
+}
+void main() {
+    vec3 a = fetch(u_a, u_flip_a);
+    vec3 b = fetch(u_b, u_flip_b);
+    vec3 c;
+    if (u_mode == 0) {
+        c = min(abs(a - b) * u_gain, vec3(1.0));
+    } else if (u_mode == 1) {
+        bool changed = any(greaterThan(abs(a - b), vec3(u_threshold)));
+        c = changed ? vec3(1.0, 0.15, 0.15) : vec3(0.6 * dot(a, vec3(0.299, 0.587, 0.114)));
+    } else {
+        c = v_uv.x < u_split ? a : b;
+        if (abs(v_uv.x - u_split) < u_pixel) c = vec3(1.0);
+    }
+    gl_FragColor = vec4(c, 1.0);
+}
+)GLSL";
+
+/** Swipe mode: dragging with the left button moves the divider. */
+class SwipeHandler : public pangolin::Handler {
+public:
+    explicit SwipeHandler(float& split) : split_(split) {}
+
+    bool enabled = false;
+
+    void Mouse(pangolin::View& view, pangolin::MouseButton button, int x, int y, bool pressed, int button_state) override {
+        if (enabled && button == pangolin::MouseButtonLeft) {
+            dragging_ = pressed;
+            if (pressed) moveTo(view, x);
+            return;
+        }
+        pangolin::Handler::Mouse(view, button, x, y, pressed, button_state);
+    }
+
+    void MouseMotion(pangolin::View& view, int x, int y, int button_state) override {
+        if (enabled && dragging_) {
+            moveTo(view, x);
+            return;
+        }
+        pangolin::Handler::MouseMotion(view, x, y, button_state);
+    }
+
+private:
+    void moveTo(const pangolin::View& view, int x) {
+        if (view.v.w > 0)
+            split_ = std::clamp(static_cast<float>(x - view.v.l) / view.v.w, 0.0f, 1.0f);
+    }
+
+    float& split_;
+    bool dragging_ = false;
+};
+
+} // namespace
+
+/**
+ * Compares the images two other viewports display: absolute difference, a
+ * thresholded change mask, or a split / swipe view. Both sources are sampled
+ * from their resident textures by one shader pass, so no frame is copied.
+ */
+class CompareViewport : public Viewport {
+public:
+    CompareViewport(const std::string& name, float aspect_ratio)
+        : name_(name),
+          swipe_(split_) {
+        view_ = &pangolin::Display(name).SetAspect(aspect_ratio).SetHandler(&swipe_);
+    }
+
+    pangolin::View& getView() override { return *view_; }
+    std::string getName() const override { return name_; }
+
+    void setCompareInputs(const Viewport* a, const Viewport* b) override {
+        a_ = a;
+        b_ = b;
+    }
+
+    void setCompareParams(std::shared_ptr<const CompareParams> params) override {
+        params_ = params ? *params : CompareParams();
+        split_ = std::clamp(params_.split, 0.0f, 1.0f);
+        if (mode_var_) *mode_var_ = static_cast<int>(params_.mode);
+        if (gain_var_) *gain_var_ = params_.gain;
+        if (threshold_var_) *threshold_var_ = params_.threshold;
+    }
+
+    void update() override {
+        if (mode_var_) params_.mode = static_cast<CompareMode>(std::clamp(mode_var_->Get(), 0, 3));
+        if (gain_var_) params_.gain = gain_var_->Get();
+        if (threshold_var_) params_.threshold = threshold_var_->Get();
+        swipe_.enabled = params_.mode == CompareMode::Swipe;
+    }
+
+    void render() override {
+        if (!view_->IsShown()) return;
+        view_->Activate();
+        bool flip_a = false, flip_b = false;
+        const pangolin::GlTexture* ta = a_ ? a_->displayTexture(flip_a) : nullptr;
+        const pangolin::GlTexture* tb = b_ ? b_->displayTexture(flip_b) : nullptr;
+        if (!ta || !tb || !ta->IsValid() || !tb->IsValid() || !ensureProgram()) return;
+
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        beginQuadPass(program_, *ta, *tb, 0.0, 1.0, 1.0, 0.0);
+        program_.SetUniform("u_a", 0);
+        program_.SetUniform("u_b", 1);
+        program_.SetUniform("u_flip_a", flip_a ? 1 : 0);
+        program_.SetUniform("u_flip_b", flip_b ? 1 : 0);
+        program_.SetUniform("u_mode", static_cast<int>(params_.mode));
+        program_.SetUniform("u_gain", params_.gain);
+        program_.SetUniform("u_threshold", params_.threshold);
+        program_.SetUniform("u_split", params_.mode == CompareMode::Split || params_.mode == CompareMode::Swipe ? split_ : 0.0f);
+        program_.SetUniform("u_pixel", view_->v.w > 0 ? 1.0f / view_->v.w : 0.0f);
+
+        endQuadPass(program_);
+        glPopAttrib();
+    }
+
+    void setupUI() override {
+        std::string prefix = "ui." + name_ + ".";
+        show_view_ = std::make_unique<pangolin::Var<bool>>(prefix + "Show", true, true);
+        mode_var_ = std::make_unique<pangolin::Var<int>>(prefix + "Mode", static_cast<int>(params_.mode), 0, 3);
+        gain_var_ = std::make_unique<pangolin::Var<float>>(prefix + "Gain", params_.gain, 1.0f, 32.0f);
+        threshold_var_ = std::make_unique<pangolin::Var<float>>(prefix + "Threshold", params_.threshold, 0.0f, 0.5f);
+    }
+
+    bool isShown() const override {
+        return show_view_ && show_view_->Get();
+    }
+
+private:
+    bool ensureProgram() {
+        return ensureQuadProgram(program_, program_failed_, kCompareFragmentShader);
+    }
+
+    std::string name_;
+    pangolin::View* view_;
+    const Viewport* a_ = nullptr;  // valid for the current frame only
+    const Viewport* b_ = nullptr;
+    CompareParams params_;
+    float split_ = 0.5f;
+    SwipeHandler swipe_;
+    pangolin::GlSlProgram program_;
+    bool program_failed_ = false;
+    std::unique_ptr<pangolin::Var<bool>> show_view_;
+    std::unique_ptr<pangolin::Var<int>> mode_var_;
+    std::unique_ptr<pangolin::Var<float>> gain_var_;
+    std::unique_ptr<pangolin::Var<float>> threshold_var_;
+};
+
+std::unique_ptr<Viewport> createCompareViewport(const std::string& name, float aspect_ratio) {
+    return std::make_unique<CompareViewport>(name, aspect_ratio);
+}
+
+} // namespace viewportal
@@ -1,24 +1,59 @@
 #include "viewport.h"
+#include "viewport_spec.h"
+#include "image_format.h"
 #include <pangolin/handler/handler.h>
 #include <stdexcept>
 
 namespace viewportal {
 
 // Forward declarations of factory functions from individual viewport files
-std::unique_ptr<Viewport> createRgb8Viewport(const std::string& name, float aspect_ratio);
+std::unique_ptr<Viewport> createRgb8Viewport(const std::string& name, float aspect_ratio, int width, int height);
 std::unique_ptr<Viewport> createG8Viewport(const std::string& name, float aspect_ratio, int width, int height);
 std::unique_ptr<Viewport> createColoredDepthViewport(const std::string& name, float aspect_ratio, int width, int height);
 std::unique_ptr<Viewport> createReconstructionViewport(const std::string& name, float aspect_ratio,
                                                         const pangolin::OpenGlRenderState& render_state);
 std::unique_ptr<Viewport> createPlotViewport(const std::string& name, float aspect_ratio);
+std::unique_ptr<Viewport> createHistogramViewport(const std::string& name, float aspect_ratio);
+std::unique_ptr<Viewport> createFlowViewport(const std::string& name, float aspect_ratio, int width, int height);
+std::unique_ptr<Viewport> createCompareViewport(const std::string& name, float aspect_ratio);
 
 namespace {
 const int kDefaultWidth = 320;
 const int kDefaultHeight = 240;
+const float kDefaultAspect = 640.0f / 480.0f;
 pangolin::OpenGlMatrix getDefaultProj() {
     static pangolin::OpenGlMatrix proj = pangolin::ProjectionMatrix(640, 480, 420, 420, 320, 240, 0.1, 1000);
     return proj;
 }
+
+std::unique_ptr<Viewport> createSizedViewport(ViewportType type, const std::string& name, float aspect_ratio,
+                                              int width, int height) {
+    switch (type) {
+    case ViewportType::RGB8:
+        return createRgb8Viewport(name, aspect_ratio, width, height);
+    case ViewportType::G8:
+        return createG8Viewport(name, aspect_ratio, width, height);
+    case ViewportType::ColoredDepth:
+        return createColoredDepthViewport(name, aspect_ratio, width, height);
+    case ViewportType::Reconstruction: {
+        pangolin::OpenGlRenderState render_state(
+            getDefaultProj(),
+            pangolin::ModelViewLookAt(0, 0.5, -3, 0, 0, 0, pangolin::AxisY)
+        );
+        return createReconstructionViewport(name, aspect_ratio, render_state);
+    }
+    case ViewportType::Plot:
+        return createPlotViewport(name, aspect_ratio);
+    case ViewportType::Histogram:
+        return createHistogramViewport(name, aspect_ratio);
+    case ViewportType::Flow:
+        return createFlowViewport(name, aspect_ratio, width, height);
+    case ViewportType::Compare:
+        return createCompareViewport(name, aspect_ratio);
+    default:
+        throw std::runtime_error("Unknown ViewportType");
+    }
+}
 } // namespace
 
 std::unique_ptr<Viewport> createViewport(const std::string& type,
@@ -27,7 +62,7 @@ std::unique_ptr<Viewport> createViewport(const std::string& type,
     pangolin::OpenGlMatrix proj = getDefaultProj();
 
     if (type == "rgb8") {
-        return createRgb8Viewport(name, aspect_ratio);
+        return createRgb8Viewport(name, aspect_ratio, kDefaultWidth, kDefaultHeight);
     }
     if (type == "g8") {
         return createG8Viewport(name, aspect_ratio, kDefaultWidth, kDefaultHeight);
@@ -45,31 +80,63 @@ std::unique_ptr<Viewport> createViewport(const std::string& type,
     if (type == "plot") {
         return createPlotViewport(name, aspect_ratio);
     }
+    if (type == "histogram") {
+        return createHistogramViewport(name, aspect_ratio);
+    }
+    if (type == "flow") {
+        return createFlowViewport(name, aspect_ratio, kDefaultWidth, kDefaultHeight);
+    }
+    if (type == "compare") {
+        return createCompareViewport(name, aspect_ratio);
+    }
     throw std::runtime_error("Unknown viewport type: " + type);
 }
 
 std::unique_ptr<Viewport> createViewport(ViewportType type,
                                          const std::string& name,
                                          float aspect_ratio) {
+    return createSizedViewport(type, name, aspect_ratio, kDefaultWidth, kDefaultHeight);
+}
+
+std::unique_ptr<Viewport> createViewport(ViewportType type,
+                                         const std::string& name,
+                                         const ViewportSpec& spec) {
+    const bool sized = spec.width > 0 && spec.height > 0;
+    std::unique_ptr<Viewport> v = createSizedViewport(type, name, specAspect(spec),
+                                                      sized ? spec.width : kDefaultWidth,
+                                                      sized ? spec.height : kDefaultHeight);
+    if (sized)
+        v->reserve(spec.width, spec.height, specFormat(type, spec));
+    return v;
+}
+
+bool acceptsFormat(ViewportType t, ImageFormat f) {
+    // Flow cells take Float32x2 only, single-channel floats go to ColoredDepth only
+    if (t == ViewportType::Flow || f == ImageFormat::Float32x2)
+        return t == ViewportType::Flow && f == ImageFormat::Float32x2;
+    return !isFloatFormat(f) || t == ViewportType::ColoredDepth;
+}
+
+ImageFormat specFormat(ViewportType type, const ViewportSpec& spec) {
+    if (spec.format && acceptsFormat(type, *spec.format))
+        return *spec.format;
     switch (type) {
-    case ViewportType::RGB8:
-        return createRgb8Viewport(name, aspect_ratio);
     case ViewportType::G8:
-        return createG8Viewport(name, aspect_ratio, kDefaultWidth, kDefaultHeight);
     case ViewportType::ColoredDepth:
-        return createColoredDepthViewport(name, aspect_ratio, kDefaultWidth, kDefaultHeight);
-    case ViewportType::Reconstruction: {
-        pangolin::OpenGlRenderState render_state(
-            getDefaultProj(),
-            pangolin::ModelViewLookAt(0, 0.5, -3, 0, 0, 0, pangolin::AxisY)
-        );
-        return createReconstructionViewport(name, aspect_ratio, render_state);
-    }
-    case ViewportType::Plot:
-        return createPlotViewport(name, aspect_ratio);
+        return ImageFormat::Luminance8;
+    case ViewportType::Flow:
+        return ImageFormat::Float32x2;
     default:
-        throw std::runtime_error("Unknown ViewportType");
+        return ImageFormat::RGB8;
     }
 }
 
+float specAspect(const ViewportSpec& spec) {
+    if (spec.aspect > 0.0f)
+        return spec.aspect;
+    if (spec.width > 0 && spec.height > 0)
+        return static_cast<float>(spec.width) / static_cast<float>(spec.height);
+    return kDefaultAspect;
+}
+
 } // namespace viewportal
@@ -0,0 +1,394 @@
+#include "viewport.h"
+#include "viewport_overlay.h"
+#include "viewport_mask.h"
+#include "flow_color.h"
+#include "texture_upload.h"
+#include "buffer_pool.h"
+#include <pangolin/display/display.h>
+#include <pangolin/gl/gl.h>
+#include <pangolin/gl/glsl.h>
+#include <pangolin/var/var.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace viewportal {
+
+namespace {
+
+// Middlebury coding: hue from the direction of -(u, v), saturation from magnitude
+const char* kFlowFragmentShader = R"GLSL(
+#version 130
+uniform sampler2D u_flow;
+uniform sampler2D u_wheel;
+uniform float u_inv_max;
+in vec2 v_uv;
+void main() {
+    vec2 f = texture(u_flow, v_uv).rg;
+    float m = length(f);
+    if (isnan(m) || isinf(m)) {
+        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    float t = atan(-f.y, -f.x) / 6.28318531 + 0.5;
+    int i = int(t * 256.0 + 0.5) & 255;
+    vec3 c = texelFetch(u_wheel, ivec2(i, 0), 0).rgb;
+    float r = m * u_inv_max;
+    gl_FragColor = vec4(r <= 1.0 ? vec3(1.0) - r * (vec3(1.0) - c) : 0.75 * c, 1.0);
+}
+)GLSL";
+
+constexpr int kArrowCells = 32;           // arrows along the longer image side
+constexpr float kArrowMinFraction = 0.05f;  // shorter vectors (of the color range) get no arrow
+
+} // namespace
+
+/**
+ * Dense optical flow viewport: Float32x2 (u, v) frames in the standard
+ * (Middlebury) flow color coding, optionally with sparse arrow glyphs. The raw
+ * vectors are uploaded to a GL_RG32F texture and colored by a shader; without
+ * shader support, rows are colored on the CPU. The magnitude shown at full
+ * saturation follows the scene (Auto_Scale) or the Max_Flow slider.
+ */
+class FlowViewport : public Viewport {
+public:
+    FlowViewport(const std::string& name, float aspect_ratio, int width, int height)
+        : name_(name),
+          width_(width),
+          height_(height) {
+        view_ = &pangolin::Display(name).SetAspect(aspect_ratio);
+        buildFlowWheelLut(wheel_lut_);
+    }
+
+    pangolin::View& getView() override { return *view_; }
+    std::string getName() const override { return name_; }
+
+    void setFrame(const FrameData& frame) override {
+        user_frame_ = frame;
+        upload_.markFull();
+    }
+
+    // A new manual scale recolors the frame on the CPU, and the Arrows toggle redraws its glyphs
+    bool retainsFrame() const override { return true; }
+
+    void reserve(int width, int height, ImageFormat format) override {
+        (void)format;
+        // Textures are created at this size by the first update(), so a viewport
+        // that is never shown allocates none
+        if (width == width_ && height == height_) return;
+        width_ = width;
+        height_ = height;
+        colorTexture_.Delete();
+        flow_texture_.Delete();
+        cleared_ = false;
+    }
+
+    void setFrameRegion(const FrameData& frame, int x, int y, int w, int h) override {
+        user_frame_ = frame;
+        upload_.markRect(x, y, w, h);
+    }
+
+    bool imagePosition(float x, float y, float& image_x, float& image_y) const override {
+        const ImageRegion region{0.0f, 0.0f, static_cast<float>(width_), static_cast<float>(height_)};
+        return user_frame_.data != nullptr && viewToImage(*view_, region, x, y, image_x, image_y);
+    }
+
+    const pangolin::GlTexture* displayTexture(bool& bottom_up) const override {
+        bottom_up = false;
+        return gpu_colormap_ || !colorTexture_.IsValid() ? nullptr : &colorTexture_;  // the shader colors on the fly
+    }
+
+    void setOverlay(std::shared_ptr<const Overlay> overlay) override {
+        overlay_.set(std::move(overlay));
+    }
+
+    void setMask(std::shared_ptr<const MaskFrame> mask) override {
+        mask_.setMask(mask.get());
+    }
+
+    void setMaskPalette(std::shared_ptr<const MaskPalette> palette) override {
+        mask_.setPalette(std::move(palette));
+    }
+
+    void prepare() override {
+        if (prepared_) return;
+        prepared_ = true;
+        prepared_upload_.clear();
+        rows_colored_ = false;
+        if (!hasFrame()) return;
+        // The CPU path bakes the scale into its RGB copy: a new manual scale redoes it
+        if (!gpu_colormap_ && !autoScale() && manualScale() != scale_) upload_.markFull();
+        const bool arrows = arrows_var_ && arrows_var_->Get();
+        if (!upload_.pending) {
+            if (arrows != arrows_on_) updateArrows(arrows, frameRowStride(user_frame_, 8));
+            return;
+        }
+        prepared_upload_ = upload_;
+        upload_.clear();
+
+        const int w = user_frame_.width;
+        const int h = user_frame_.height;
+        const std::ptrdiff_t stride = frameRowStride(user_frame_, 8);
+        const bool resized = textureStale(w, h);
+        if (resized) {
+            prepared_upload_.markFull();
+            rgb_buffer_.resize(static_cast<size_t>(3 * w * h));
+        }
+        if (prepared_upload_.full) {
+            // The scale follows full frames only, so region updates match the rest
+            if (resized || !autoScale()) auto_scale_.reset();
+            if (autoScale())
+                auto_scale_.observe(user_frame_.data, w, h, stride);
+        }
+        scale_ = auto_scale_.valid() ? auto_scale_.maxMagnitude() : manualScale();
+        if (program_failed_) colorRows();
+        updateArrows(arrows, stride);
+    }
+
+    void update() override {
+        prepare();  // unless the display already ran it on a worker
+        prepared_ = false;
+        if (!hasFrame()) {
+            if (!cleared_) {
+                ensureTextureSize(width_, height_);
+                rgb_buffer_.resize(static_cast<size_t>(3 * width_ * height_));
+                std::memset(rgb_buffer_.data(), 0, rgb_buffer_.size());
+                colorTexture_.Upload(rgb_buffer_.data(), GL_RGB, GL_UNSIGNED_BYTE);
+                gpu_colormap_ = false;
+                updateArrows(false, 0);
+                cleared_ = true;
+            }
+            return;
+        }
+        if (!prepared_upload_.pending) return;
+        cleared_ = false;
+        const PendingUpload& upload = prepared_upload_;
+        ensureTextureSize(user_frame_.width, user_frame_.height);
+
+        gpu_colormap_ = ensureProgram();
+        if (gpu_colormap_) {
+            const bool bottom_up = user_frame_.row_stride < 0;
+            bool whole = upload.full || bottom_up != bottom_up_;
+            if (!flow_texture_.IsValid() || flow_texture_.width != width_ || flow_texture_.height != height_) {
+                flow_texture_.Reinitialise(width_, height_, GL_RG32F, false, 0, GL_RG, GL_FLOAT);
+                whole = true;
+            }
+            if (whole)
+                uploadTexture(flow_texture_, user_frame_, 8, GL_RG, GL_FLOAT);
+            else
+                uploadTextureRect(flow_texture_, user_frame_, 8, upload.x, upload.y, upload.w, upload.h, GL_RG, GL_FLOAT);
+            bottom_up_ = bottom_up;
+        } else {
+            if (!rows_colored_) colorRows();  // the shader just failed to build
+            int x0, y0, w, h;
+            pendingRect(x0, y0, w, h);
+            FrameData rgb;
+            rgb.width = width_;
+            rgb.height = height_;
+            rgb.format = ImageFormat::RGB8;
+            rgb.data = rgb_buffer_.data();
+            uploadTextureRect(colorTexture_, rgb, 3, x0, y0, w, h, GL_RGB);
+        }
+    }
+
+    void render() override {
+        if (view_->IsShown()) {
+            view_->Activate();
+            glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+            if (gpu_colormap_)
+                renderFlow();
+            else
+                colorTexture_.RenderToViewportFlipY();
+            if (!arrows_.empty()) renderArrows();
+            const ImageRegion region{0.0f, 0.0f, static_cast<float>(width_), static_cast<float>(height_)};
+            mask_.render(region, width_, height_);
+            overlay_.render(region);
+        }
+    }
+
+    void setupUI() override {
+        std::string prefix = "ui." + name_ + ".";
+        show_view_ = std::make_unique<pangolin::Var<bool>>(prefix + "Show", true, true);
+        auto_scale_var_ = std::make_unique<pangolin::Var<bool>>(prefix + "Auto_Scale", true, true);
+        max_flow_var_ = std::make_unique<pangolin::Var<float>>(prefix + "Max_Flow", 10.0f, 0.5f, 100.0f);
+        arrows_var_ = std::make_unique<pangolin::Var<bool>>(prefix + "Arrows", false, true);
+    }
+
+    bool isShown() const override {
+        return show_view_ && show_view_->Get();
+    }
+
+private:
+    bool autoScale() const { return !auto_scale_var_ || auto_scale_var_->Get(); }
+    float manualScale() const { return max_flow_var_ ? std::max(max_flow_var_->Get(), 1e-3f) : 10.0f; }
+
+    bool hasFrame() const {
+        return user_frame_.data != nullptr && user_frame_.width > 0 && user_frame_.height > 0 &&
+               user_frame_.format == ImageFormat::Float32x2;
+    }
+
+    /** True if ensureTextureSize(w, h) will reallocate; safe off the display thread. */
+    bool textureStale(int w, int h) const {
+        return w != width_ || h != height_ || !colorTexture_.IsValid();
+    }
+
+    /** \return true if the texture was reallocated and needs a full upload. */
+    bool ensureTextureSize(int w, int h) {
+        if (!textureStale(w, h)) return false;
+        width_ = w;
+        height_ = h;
+        colorTexture_ = pangolin::GlTexture(width_, height_, GL_RGB, false, 0, GL_RGB, GL_UNSIGNED_BYTE);
+        return true;
+    }
+
+    /** CPU fallback: color the pending rows into the packed RGB copy. */
+    void colorRows() {
+        const std::ptrdiff_t stride = frameRowStride(user_frame_, 8);
+        int x0, y0, w, h;
+        pendingRect(x0, y0, w, h);
+        const auto* top = static_cast<const std::uint8_t*>(user_frame_.data);
+        for (int row = y0; row < y0 + h; ++row)
+            flowColorRow(reinterpret_cast<const float*>(top + row * stride) + 2 * x0, w, scale_, wheel_lut_,
+                         rgb_buffer_.data() + (static_cast<size_t>(row) * user_frame_.width + x0) * 3);
+        rows_colored_ = true;
+    }
+
+    /** Pixels covered by the pending upload: the whole frame or the changed rectangle. */
+    void pendingRect(int& x0, int& y0, int& w, int& h) const {
+        const PendingUpload& upload = prepared_upload_;
+        x0 = upload.full ? 0 : upload.x;
+        y0 = upload.full ? 0 : upload.y;
+        w = upload.full ? user_frame_.width : upload.w;
+        h = upload.full ? user_frame_.height : upload.h;
+    }
+
+    bool ensureProgram() {
+        return ensureQuadProgram(program_, program_failed_, kFlowFragmentShader);
+    }
+
+    /**
+     * One arrow per grid cell, from the cell centre along its flow vector; the
+     * color range's magnitude spans one cell. Stored as GL_LINES in image pixels.
+     */
+    void buildArrows(std::ptrdiff_t stride) {
+        arrows_.clear();
+        const int w = user_frame_.width;
+        const int h = user_frame_.height;
+        const int step = std::max(std::max(w, h) / kArrowCells, 4);
+        const float length_scale = 0.9f * step / scale_;
+        const auto* top = static_cast<const std::uint8_t*>(user_frame_.data);
+        for (int y = step / 2; y < h; y += step) {
+            const float* row = reinterpret_cast<const float*>(top + y * stride);
+            for (int x = step / 2; x < w; x += step) {
+                const float u = row[2 * x];
+                const float v = row[2 * x + 1];
+                const float m = std::sqrt(u * u + v * v);
+                if (!std::isfinite(m) || m < kArrowMinFraction * scale_) continue;
+                // Long vectors are capped at two cells so the glyphs stay readable
+                const float len = std::min(m * length_scale, 2.0f * step);
+                const float dx = u / m, dy = v / m;
+                const float x0 = x + 0.5f, y0 = y + 0.5f;
+                const float x1 = x0 + dx * len, y1 = y0 + dy * len;
+                const float head = 0.3f * len;
+                // Head: two strokes at +/-30 degrees back from the tip
+                const float c = 0.866f, s = 0.5f;
+                arrows_.insert(arrows_.end(), {x0, y0, x1, y1,
+                                               x1, y1, x1 - head * (dx * c - dy * s), y1 - head * (dy * c + dx * s),
+                                               x1, y1, x1 - head * (dx * c + dy * s), y1 - head * (dy * c - dx * s)});
+            }
+        }
+    }
+
+    void updateArrows(bool on, std::ptrdiff_t stride) {
+        arrows_on_ = on;
+        if (on)
+            buildArrows(stride);
+        else
+            arrows_.clear();
+    }
+
+    void renderArrows() {
+        glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_LINE_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glMatrixMode(GL_PROJECTION);
+        glPushMatrix();
+        glLoadIdentity();
+        glOrtho(0.0, width_, height_, 0.0, -1.0, 1.0);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glLoadIdentity();
+        glLineWidth(1.5f);
+        glColor4f(0.0f, 0.0f, 0.0f, 0.85f);
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, arrows_.data());
+        glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(arrows_.size() / 2));
+        glPopClientAttrib();
+        glMatrixMode(GL_MODELVIEW);
+        glPopMatrix();
+        glMatrixMode(GL_PROJECTION);
+        glPopMatrix();
+        glMatrixMode(GL_MODELVIEW);
+        glPopAttrib();
+    }
+
+    void renderFlow() {
+        if (!wheel_texture_.IsValid()) {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            wheel_texture_.Reinitialise(kFlowWheelSize, 1, GL_RGB8, false, 0, GL_RGB, GL_UNSIGNED_BYTE, wheel_lut_);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+        glDisable(GL_DEPTH_TEST);
+        // Texture row 0 is the top image row unless the frame was uploaded bottom-up
+        beginQuadPass(program_, flow_texture_, wheel_texture_, 0.0, 1.0, bottom_up_ ? 0.0 : 1.0, bottom_up_ ? 1.0 : 0.0);
+        program_.SetUniform("u_flow", 0);
+        program_.SetUniform("u_wheel", 1);
+        program_.SetUniform("u_inv_max", 1.0f / currentScale());
+
+        endQuadPass(program_);
+        glPopAttrib();
+    }
+
+    /** The shader applies a manual scale as soon as the slider moves. */
+    float currentScale() const { return autoScale() ? scale_ : manualScale(); }
+
+    std::string name_;
+    pangolin::View* view_;
+    int width_;
+    int height_;
+    PooledBuffer rgb_buffer_;  // CPU fallback: colored frame, RGB
+    pangolin::GlTexture colorTexture_;
+    pangolin::GlTexture flow_texture_;
+    pangolin::GlTexture wheel_texture_;
+    pangolin::GlSlProgram program_;
+    bool program_failed_ = false;
+    bool gpu_colormap_ = false;
+    bool bottom_up_ = false;
+    bool cleared_ = false;
+    unsigned char wheel_lut_[kFlowWheelSize * 3];
+    FlowAutoScale auto_scale_;
+    float scale_ = 10.0f;           // magnitude at full saturation for the last upload
+    std::vector<float> arrows_;     // x, y per line end, image pixels
+    bool arrows_on_ = false;        // Arrows toggle when arrows_ was last built
+    std::unique_ptr<pangolin::Var<bool>> show_view_;
+    std::unique_ptr<pangolin::Var<bool>> auto_scale_var_;
+    std::unique_ptr<pangolin::Var<float>> max_flow_var_;
+    std::unique_ptr<pangolin::Var<bool>> arrows_var_;
+    MaskLayer mask_;
+    OverlayRenderer overlay_;
+    FrameData user_frame_;
+    PendingUpload upload_;
+    // Handed from prepare() to update()
+    bool prepared_ = false;
+    PendingUpload prepared_upload_;  // what update() uploads; full after a reallocation
+    bool rows_colored_ = false;      // its rows are colored into rgb_buffer_
+};
+
+std::unique_ptr<Viewport> createFlowViewport(const std::string& name, float aspect_ratio, int width, int height) {
+    return std::make_unique<FlowViewport>(name, aspect_ratio, width, height);
+}
+
+} // namespace viewportal
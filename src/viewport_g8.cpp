@@ -1,4 +1,10 @@
 #include "viewport.h"
+#include "viewport_overlay.h"
+#include "viewport_mask.h"
+#include "image_zoom.h"
+#include "tiled_image.h"
+#include "texture_upload.h"
+#include "buffer_pool.h"
 #include <pangolin/display/display.h>
 #include <pangolin/gl/gl.h>
 #include <pangolin/var/var.h>
@@ -12,18 +18,8 @@ public:
     G8Viewport(const std::string& name, float aspect_ratio, int width, int height)
         : name_(name),
           width_(width),
-          height_(height),
-          imageBuffer_(nullptr) {
-        imageBuffer_ = new unsigned char[width_ * height_];
-        luminanceTexture_ = pangolin::GlTexture(width_, height_, GL_LUMINANCE, false, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE);
-        view_ = &pangolin::Display(name).SetAspect(aspect_ratio);
-    }
-
-    ~G8Viewport() override {
-        if (imageBuffer_) {
-            delete[] imageBuffer_;
-            imageBuffer_ = nullptr;
-        }
+          height_(height) {
+        view_ = &pangolin::Display(name).SetAspect(aspect_ratio).SetHandler(&zoom_);
     }
 
     pangolin::View& getView() override { return *view_; }
@@ -31,23 +27,101 @@ public:
 
     void setFrame(const FrameData& frame) override {
         user_frame_ = frame;
+        upload_.markFull();
+    }
+
+    void setFrameRegion(const FrameData& frame, int x, int y, int w, int h) override {
+        user_frame_ = frame;
+        upload_.markRect(x, y, w, h);
+    }
+
+    void reserve(int width, int height, ImageFormat format) override {
+        (void)format;
+        // Created at this size by the first update(), so a hidden viewport allocates none
+        if (TiledImage::wanted(width, height)) return;  // tiles are built from the first frame
+        if (width == width_ && height == height_) return;
+        width_ = width;
+        height_ = height;
+        luminanceTexture_.Delete();
+    }
+
+    bool imagePosition(float x, float y, float& image_x, float& image_y) const override {
+        return user_frame_.data != nullptr && viewToImage(*view_, zoom_.region(), x, y, image_x, image_y);
+    }
+
+    const pangolin::GlTexture* displayTexture(bool& bottom_up) const override {
+        bottom_up = bottom_up_;
+        return tiled_ || !luminanceTexture_.IsValid() ? nullptr : &luminanceTexture_;
+    }
+
+    void setOverlay(std::shared_ptr<const Overlay> overlay) override {
+        overlay_.set(std::move(overlay));
+    }
+
+    void setMask(std::shared_ptr<const MaskFrame> mask) override {
+        mask_.setMask(mask.get());
+    }
+
+    void setMaskPalette(std::shared_ptr<const MaskPalette> palette) override {
+        mask_.setPalette(std::move(palette));
+    }
+
+    void prepare() override {
+        if (prepared_ || hasFrame()) return;
+        prepared_ = true;
+        // The pattern only depends on the size: drawn once, off the display thread
+        const size_t size = static_cast<size_t>(width_ * height_);
+        if (placeholder_.size() == size) return;
+        placeholder_.resize(size);
+        setPlaceholderImageData(placeholder_.data(), width_, height_);
+        placeholder_fresh_ = true;
     }
 
     void update() override {
-        if (user_frame_.data != nullptr && user_frame_.width > 0 && user_frame_.height > 0) {
-            ensureTextureSize(user_frame_.width, user_frame_.height);
-            luminanceTexture_.Upload(user_frame_.data, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+        if (hasFrame()) {
+            if (!upload_.pending) return;
+            placeholder_.reset();
+            const PendingUpload upload = upload_;
+            upload_.clear();
+            zoom_.setImageSize(user_frame_.width, user_frame_.height);
+            const bool was_tiled = tiled_;
+            tiled_ = TiledImage::wanted(user_frame_.width, user_frame_.height);
+            if (tiled_) {
+                tiled_image_.setImage(user_frame_);
+                return;
+            }
+            const bool resized = ensureTextureSize(user_frame_.width, user_frame_.height);
+            const bool bottom_up = user_frame_.row_stride < 0;
+            if (upload.full || resized || was_tiled || bottom_up != bottom_up_)
+                uploadTexture(luminanceTexture_, user_frame_, 1, GL_LUMINANCE);
+            else
+                uploadTextureRect(luminanceTexture_, user_frame_, 1, upload.x, upload.y, upload.w, upload.h, GL_LUMINANCE);
+            bottom_up_ = bottom_up;
             return;
         }
-        setPlaceholderImageData(imageBuffer_, width_, height_);
-        luminanceTexture_.Upload(imageBuffer_, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+        prepare();  // unless the display already ran it on a worker
+        prepared_ = false;
+        zoom_.setImageSize(width_, height_);
+        if (ensureTextureSize(width_, height_) || placeholder_fresh_)
+            luminanceTexture_.Upload(placeholder_.data(), GL_LUMINANCE, GL_UNSIGNED_BYTE);
+        placeholder_fresh_ = false;
     }
 
     void render() override {
         if (view_->IsShown()) {
             view_->Activate();
             glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-            luminanceTexture_.RenderToViewportFlipY();
+            const ImageRegion region = zoom_.region();
+            if (tiled_)
+                tiled_image_.render(region, view_->v.w, view_->v.h);
+            else if (zoom_.isZoomed() || bottom_up_)
+                renderTextureRegion(luminanceTexture_, region, bottom_up_);
+            else
+                luminanceTexture_.RenderToViewportFlipY();
+            const int image_width = tiled_ ? tiled_image_.width() : width_;
+            const int image_height = tiled_ ? tiled_image_.height() : height_;
+            mask_.render(region, image_width, image_height);
+            overlay_.render(region);
         }
     }
 
@@ -61,16 +135,17 @@ public:
     }
 
 private:
-    void ensureTextureSize(int w, int h) {
-        if (w == width_ && h == height_) return;
+    bool hasFrame() const {
+        return user_frame_.data != nullptr && user_frame_.width > 0 && user_frame_.height > 0;
+    }
+
+    /** \return true if the texture was reallocated and needs a full upload. */
+    bool ensureTextureSize(int w, int h) {
+        if (w == width_ && h == height_ && luminanceTexture_.IsValid()) return false;
         width_ = w;
         height_ = h;
-        if (imageBuffer_) {
-            delete[] imageBuffer_;
-            imageBuffer_ = nullptr;
-        }
-        imageBuffer_ = new unsigned char[width_ * height_];
         luminanceTexture_ = pangolin::GlTexture(width_, height_, GL_LUMINANCE, false, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+        return true;
     }
 
     void setPlaceholderImageData(unsigned char* imageArray, int width, int height) {
@@ -88,10 +163,19 @@ private:
     pangolin::View* view_;
     int width_;
     int height_;
-    unsigned char* imageBuffer_;
+    PooledBuffer placeholder_;  // pattern shown until the first frame; released then
+    bool placeholder_fresh_ = false;  // drawn since the last upload
+    bool prepared_ = false;
     pangolin::GlTexture luminanceTexture_;
     std::unique_ptr<pangolin::Var<bool>> show_view_;
+    MaskLayer mask_;
+    OverlayRenderer overlay_;
     FrameData user_frame_;
+    PendingUpload upload_;
+    ImageZoom zoom_;
+    TiledImage tiled_image_;
+    bool tiled_ = false;
+    bool bottom_up_ = false;  // texture rows stored bottom-up (frame had a negative stride)
 };
 
 std::unique_ptr<Viewport> createG8Viewport(const std::string& name, float aspect_ratio, int width, int height) {
@@ -0,0 +1,280 @@
+#include "viewport_gallery.h"
+#include "colormap.h"
+#include "flow_color.h"
+#include "image_format.h"
+#include <pangolin/display/display.h>
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+
+namespace viewportal {
+
+namespace {
+
+constexpr int kMaxAtlasSize = 4096;
+constexpr int kFloatsPerVertex = 4;
+
+} // namespace
+
+GalleryViewport::GalleryViewport(const std::string& name, int tile_width, int tile_height)
+    : name_(name),
+      tile_width_(std::max(8, tile_width)),
+      tile_height_(std::max(8, tile_height)) {
+    GLint max_size = kMaxAtlasSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    const int atlas_size = std::min(kMaxAtlasSize, static_cast<int>(max_size));
+    atlas_cols_ = std::max(1, atlas_size / tile_width_);
+    atlas_rows_ = std::max(1, atlas_size / tile_height_);
+    tile_rgb_.resize(static_cast<size_t>(3) * tile_width_ * tile_height_);
+    buildJetRgbLut(jet_lut_);
+    buildFlowWheelLut(flow_lut_);
+    view_ = &pangolin::Display(name);
+}
+
+void GalleryViewport::setTileCount(size_t count) {
+    tile_count_ = count;
+    const size_t per_atlas = static_cast<size_t>(atlas_cols_) * atlas_rows_;
+    const size_t needed = (count + per_atlas - 1) / per_atlas;
+    atlases_.resize(needed);
+    for (size_t i = 0; i < needed; ++i) {
+        // Each atlas only spans the tile rows (and, when short of one row, columns) it holds
+        const size_t tiles = std::min(per_atlas, count - i * per_atlas);
+        const int cols = static_cast<int>(std::min<size_t>(tiles, atlas_cols_));
+        const int rows = static_cast<int>((tiles + atlas_cols_ - 1) / atlas_cols_);
+        const int aw = cols * tile_width_;
+        const int ah = rows * tile_height_;
+        if (!atlases_[i].IsValid() || atlases_[i].width != aw || atlases_[i].height != ah)
+            atlases_[i].Reinitialise(aw, ah, GL_RGB8, true, 0, GL_RGB, GL_UNSIGNED_BYTE);
+    }
+    std::fill(tile_rgb_.begin(), tile_rgb_.end(), 0);
+    for (size_t i = 0; i < count; ++i)
+        uploadTile(i, tile_rgb_.data());
+    layout_count_ = static_cast<size_t>(-1);  // force relayout
+}
+
+void GalleryViewport::uploadTile(size_t index, const unsigned char* rgb) {
+    const size_t per_atlas = static_cast<size_t>(atlas_cols_) * atlas_rows_;
+    const size_t atlas = index / per_atlas;
+    const size_t slot = index % per_atlas;
+    if (atlas >= atlases_.size()) return;
+    const int tx = static_cast<int>(slot % atlas_cols_) * tile_width_;
+    const int ty = static_cast<int>(slot / atlas_cols_) * tile_height_;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    atlases_[atlas].Upload(rgb, tx, ty, tile_width_, tile_height_, GL_RGB, GL_UNSIGNED_BYTE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void GalleryViewport::setTileFrame(size_t index, const FrameData& frame, bool colormap) {
+    if (index >= tile_count_ || !frame.data || frame.width <= 0 || frame.height <= 0) return;
+    const int bpp = bytesPerPixel(frame.format);
+    const std::ptrdiff_t src_stride = frame.row_stride != 0 ? static_cast<std::ptrdiff_t>(frame.row_stride)
+                                                            : static_cast<std::ptrdiff_t>(frame.width) * bpp;
+
+    if (sample_src_width_ != frame.width || sample_bpp_ != bpp) {
+        sample_src_width_ = frame.width;
+        sample_bpp_ = bpp;
+        sample_x_.resize(tile_width_);
+        for (int x = 0; x < tile_width_; ++x)
+            sample_x_[x] = ((2 * x + 1) * frame.width) / (2 * tile_width_) * bpp;
+    }
+    const unsigned char* src = static_cast<const unsigned char*>(frame.data);
+    if (isExactFormat(frame.format)) {
+        setFloatTile(index, frame, src, src_stride);
+        return;
+    }
+    const bool jet = colormap && frame.format == ImageFormat::Luminance8;
+    for (int y = 0; y < tile_height_; ++y) {
+        const int sy = ((2 * y + 1) * frame.height) / (2 * tile_height_);
+        const unsigned char* row = src + sy * src_stride;
+        unsigned char* dst = tile_rgb_.data() + static_cast<size_t>(y) * tile_width_ * 3;
+        for (int x = 0; x < tile_width_; ++x, dst += 3) {
+            const unsigned char* p = row + sample_x_[x];
+            if (bpp == 1) {
+                const unsigned char* c = jet ? jet_lut_ + p[0] * 3 : nullptr;
+                dst[0] = c ? c[0] : p[0];
+                dst[1] = c ? c[1] : p[0];
+                dst[2] = c ? c[2] : p[0];
+            } else {
+                dst[0] = p[0];
+                dst[1] = p[1];
+                dst[2] = p[2];
+            }
+        }
+    }
+    uploadTile(index, tile_rgb_.data());
+}
+
+void GalleryViewport::setFloatTile(size_t index, const FrameData& frame, const unsigned char* src,
+                                   std::ptrdiff_t src_stride) {
+    // Sample the tile grid, then stretch the tile's own finite range over the colormap
+    if (frame.format == ImageFormat::Float32x2) {
+        setFlowTile(index, frame, src, src_stride);
+        return;
+    }
+    tile_values_.resize(static_cast<size_t>(tile_width_) * tile_height_);
+    float low = INFINITY, high = -INFINITY;
+    float* out = tile_values_.data();
+    for (int y = 0; y < tile_height_; ++y) {
+        const int sy = ((2 * y + 1) * frame.height) / (2 * tile_height_);
+        const unsigned char* row = src + sy * src_stride;
+        for (int x = 0; x < tile_width_; ++x, ++out) {
+            const unsigned char* p = row + sample_x_[x];
+            float v;
+            if (frame.format == ImageFormat::Float32) {
+                std::memcpy(&v, p, sizeof(v));
+            } else {
+                std::uint16_t h;
+                std::memcpy(&h, p, sizeof(h));
+                v = halfToFloat(h);
+            }
+            *out = v;
+            if (std::isfinite(v)) {
+                low = std::min(low, v);
+                high = std::max(high, v);
+            }
+        }
+    }
+    static const unsigned char kInvalid[3] = {0, 0, 0};
+    for (int y = 0; y < tile_height_; ++y)
+        colormapFloatRow(tile_values_.data() + static_cast<size_t>(y) * tile_width_, tile_width_, low, high, jet_lut_,
+                         kInvalid, tile_rgb_.data() + static_cast<size_t>(y) * tile_width_ * 3);
+    uploadTile(index, tile_rgb_.data());
+}
+
+void GalleryViewport::setFlowTile(size_t index, const FrameData& frame, const unsigned char* src,
+                                  std::ptrdiff_t src_stride) {
+    // Flow coding at the tile's own largest finite magnitude
+    tile_values_.resize(static_cast<size_t>(2) * tile_width_ * tile_height_);
+    float max_magnitude = 0.0f;
+    float* out = tile_values_.data();
+    for (int y = 0; y < tile_height_; ++y) {
+        const int sy = ((2 * y + 1) * frame.height) / (2 * tile_height_);
+        const unsigned char* row = src + sy * src_stride;
+        for (int x = 0; x < tile_width_; ++x, out += 2) {
+            std::memcpy(out, row + sample_x_[x], 2 * sizeof(float));
+            const float m = std::sqrt(out[0] * out[0] + out[1] * out[1]);
+            if (std::isfinite(m)) max_magnitude = std::max(max_magnitude, m);
+        }
+    }
+    for (int y = 0; y < tile_height_; ++y)
+        flowColorRow(tile_values_.data() + static_cast<size_t>(2) * y * tile_width_, tile_width_, max_magnitude, flow_lut_,
+                     tile_rgb_.data() + static_cast<size_t>(y) * tile_width_ * 3);
+    uploadTile(index, tile_rgb_.data());
+}
+
+void GalleryViewport::layoutTiles() {
+    const int vw = view_->v.w;
+    const int vh = view_->v.h;
+    if (vw == layout_view_w_ && vh == layout_view_h_ && tile_count_ == layout_count_) return;
+    layout_view_w_ = vw;
+    layout_view_h_ = vh;
+    layout_count_ = tile_count_;
+    rects_.assign(tile_count_, TileRect{0, 0, 0, 0});
+    atlas_vertices_.assign(atlases_.size(), {});
+    if (tile_count_ == 0 || vw <= 0 || vh <= 0) return;
+
+    // Pick the column count that gives the largest tiles for this view.
+    int best_cols = 1;
+    float best_scale = 0.0f;
+    for (int c = 1; c <= static_cast<int>(tile_count_); ++c) {
+        const int r = static_cast<int>((tile_count_ + c - 1) / c);
+        const float scale = std::min(static_cast<float>(vw) / (c * tile_width_),
+                                     static_cast<float>(vh) / (r * tile_height_));
+        if (scale > best_scale) {
+            best_scale = scale;
+            best_cols = c;
+        }
+    }
+    const int cols = best_cols;
+    const float cell_w = best_scale * tile_width_ / vw;
+    const float cell_h = best_scale * tile_height_ / vh;
+    const int rows = static_cast<int>((tile_count_ + cols - 1) / cols);
+    const float off_x = (1.0f - cols * cell_w) * 0.5f;
+    const float off_y = (1.0f - rows * cell_h) * 0.5f;
+    const float gap_x = 1.0f / vw;  // one-pixel gap between tiles
+    const float gap_y = 1.0f / vh;
+
+    const size_t per_atlas = static_cast<size_t>(atlas_cols_) * atlas_rows_;
+    for (size_t i = 0; i < tile_count_; ++i) {
+        const int col = static_cast<int>(i % cols);
+        const int row = static_cast<int>(i / cols);
+        TileRect r;
+        r.x0 = off_x + col * cell_w + gap_x;
+        r.y0 = off_y + row * cell_h + gap_y;
+        r.x1 = off_x + (col + 1) * cell_w - gap_x;
+        r.y1 = off_y + (row + 1) * cell_h - gap_y;
+        rects_[i] = r;
+
+        const size_t slot = i % per_atlas;
+        const pangolin::GlTexture& atlas = atlases_[i / per_atlas];
+        const float atlas_w = static_cast<float>(atlas.width);
+        const float atlas_h = static_cast<float>(atlas.height);
+        const float u0 = (slot % atlas_cols_) * tile_width_ / atlas_w;
+        const float v0 = (slot / atlas_cols_) * tile_height_ / atlas_h;
+        const float u1 = u0 + tile_width_ / atlas_w;
+        const float v1 = v0 + tile_height_ / atlas_h;
+        const float quad[6][4] = {
+            {r.x0, r.y0, u0, v0}, {r.x1, r.y0, u1, v0}, {r.x1, r.y1, u1, v1},
+            {r.x0, r.y0, u0, v0}, {r.x1, r.y1, u1, v1}, {r.x0, r.y1, u0, v1},
+        };
+        std::vector<float>& out = atlas_vertices_[i / per_atlas];
+        for (const auto& vtx : quad)
+            out.insert(out.end(), vtx, vtx + kFloatsPerVertex);
+    }
+}
+
+void GalleryViewport::render() {
+    if (!view_->IsShown()) return;
+    view_->Activate();
+    layoutTiles();
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0.0, 1.0, 1.0, 0.0, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    const GLsizei stride = kFloatsPerVertex * sizeof(float);
+    for (size_t a = 0; a < atlases_.size() && a < atlas_vertices_.size(); ++a) {
+        const std::vector<float>& verts = atlas_vertices_[a];
+        if (verts.empty()) continue;
+        atlases_[a].Bind();
+        glVertexPointer(2, GL_FLOAT, stride, verts.data());
+        glTexCoordPointer(2, GL_FLOAT, stride, verts.data() + 2);
+        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(verts.size() / kFloatsPerVertex));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPopClientAttrib();
+
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+int GalleryViewport::tileAt(int x, int y) const {
+    const pangolin::Viewport& v = view_->v;
+    if (v.w <= 0 || v.h <= 0) return -1;
+    const float fx = static_cast<float>(x - v.l) / v.w;
+    const float fy = 1.0f - static_cast<float>(y - v.b) / v.h;  // Pangolin y is bottom-up
+    for (size_t i = 0; i < rects_.size(); ++i) {
+        const TileRect& r = rects_[i];
+        if (fx >= r.x0 && fx < r.x1 && fy >= r.y0 && fy < r.y1)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+} // namespace viewportal
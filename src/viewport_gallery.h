@@ -0,0 +1,79 @@
+#ifndef VIEWPORT_GALLERY_H
+#define VIEWPORT_GALLERY_H
+
+#include "viewport.h"
+#include <pangolin/gl/gl.h>
+#include <cstddef>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Large-grid ("gallery") viewport: shows many streams as downscaled tiles packed
+ * into shared atlas textures. Only tiles that received a new frame are re-uploaded
+ * (one glTexSubImage2D each), and the whole grid is drawn with one draw call per
+ * atlas texture instead of one view, texture and draw per stream.
+ */
+class GalleryViewport : public Viewport {
+public:
+    GalleryViewport(const std::string& name, int tile_width, int tile_height);
+
+    pangolin::View& getView() override { return *view_; }
+    std::string getName() const override { return name_; }
+    void render() override;
+
+    /**
+     * Set the number of tiles; all tiles are cleared to black.
+     */
+    void setTileCount(size_t count);
+
+    /**
+     * Downscale a frame into a tile and upload that tile only. Float frames are
+     * always colormapped, over the finite range of the tile's samples; flow
+     * frames are shown in flow color coding.
+     * \param colormap Map Luminance8 input through the jet colormap (ColoredDepth cells).
+     */
+    void setTileFrame(size_t index, const FrameData& frame, bool colormap);
+
+    /**
+     * Tile index under window pixel (x, y) (Pangolin window coordinates), or -1.
+     */
+    int tileAt(int x, int y) const;
+
+private:
+    struct TileRect {
+        float x0, y0, x1, y1;  // fraction of the view, top-left origin
+    };
+
+    void uploadTile(size_t index, const unsigned char* rgb);
+    void setFloatTile(size_t index, const FrameData& frame, const unsigned char* src, std::ptrdiff_t src_stride);
+    void setFlowTile(size_t index, const FrameData& frame, const unsigned char* src, std::ptrdiff_t src_stride);
+    void layoutTiles();
+
+    std::string name_;
+    pangolin::View* view_;
+    int tile_width_;
+    int tile_height_;
+    int atlas_cols_ = 1;
+    int atlas_rows_ = 1;
+    size_t tile_count_ = 0;
+    std::vector<pangolin::GlTexture> atlases_;
+    std::vector<unsigned char> tile_rgb_;
+    std::vector<float> tile_values_;  // float tiles: sampled values (u, v pairs for flow)
+    std::vector<int> sample_x_;  // source column for each tile column, per current source width
+    int sample_src_width_ = 0;
+    int sample_bpp_ = 0;
+    unsigned char jet_lut_[256 * 3];
+    unsigned char flow_lut_[256 * 3];
+
+    // Cached layout for the current view size and tile count
+    std::vector<TileRect> rects_;
+    std::vector<std::vector<float>> atlas_vertices_;  // per atlas: x, y, u, v per vertex
+    int layout_view_w_ = -1;
+    int layout_view_h_ = -1;
+    size_t layout_count_ = 0;
+};
+
+} // namespace viewportal
+
+#endif // VIEWPORT_GALLERY_H
@@ -0,0 +1,183 @@
+#include "viewport.h"
+#include "image_stats.h"
+#include <pangolin/display/display.h>
+#include <pangolin/gl/gl.h>
+#include <pangolin/gl/glfont.h>
+#include <pangolin/var/var.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Histogram of the image viewport bound with ViewPortal::setHistogramSource(),
+ * one curve per color channel, with min/max/mean and the valid-pixel count as
+ * text. Only draws; the statistics come from the window's stats worker.
+ */
+class HistogramViewport : public Viewport {
+public:
+    HistogramViewport(const std::string& name, float aspect_ratio) : name_(name) {
+        view_ = &pangolin::Display(name).SetAspect(aspect_ratio);
+    }
+
+    pangolin::View& getView() override { return *view_; }
+    std::string getName() const override { return name_; }
+
+    void setStats(std::shared_ptr<const ImageStats> stats) override {
+        stats_ = std::move(stats);
+        rebuild_ = true;
+    }
+
+    void update() override {
+        const bool log_scale = log_scale_ && log_scale_->Get();
+        if (log_scale != log_scale_shown_) {
+            log_scale_shown_ = log_scale;
+            rebuild_ = true;
+        }
+        if (rebuild_) buildCurves();
+    }
+
+    void render() override {
+        if (!view_->IsShown()) return;
+        view_->ActivatePixelOrthographic();
+        const float w = static_cast<float>(view_->v.w);
+        const float h = static_cast<float>(view_->v.h);
+
+        glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_CURRENT_BIT);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_TEXTURE_2D);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glColor4f(0.1f, 0.1f, 0.12f, 1.0f);
+        const GLfloat background[] = {0.0f, 0.0f, w, 0.0f, 0.0f, h, w, h};
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, background);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        // Curves are built in [0, 1] x [0, 1]; scale into the plot area below the text
+        const float plot_top = std::max(h - kTextRows * kLineHeight - kMargin, kMargin);
+        glMatrixMode(GL_MODELVIEW);
+        glPushMatrix();
+        glTranslatef(kMargin, kMargin, 0.0f);
+        glScalef(std::max(w - 2.0f * kMargin, 1.0f), std::max(plot_top - kMargin, 1.0f), 1.0f);
+        glLineWidth(1.0f);
+        for (size_t c = 0; c < fills_.size(); ++c) {
+            const float* rgb = channelColor(c);
+            glColor4f(rgb[0], rgb[1], rgb[2], 0.3f);
+            glVertexPointer(2, GL_FLOAT, 0, fills_[c].data());
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, static_cast<GLsizei>(fills_[c].size() / 2));
+            glColor4f(rgb[0], rgb[1], rgb[2], 0.9f);
+            glVertexPointer(2, GL_FLOAT, 0, lines_[c].data());
+            glDrawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(lines_[c].size() / 2));
+        }
+        glPopMatrix();
+        glPopClientAttrib();
+
+        glColor4f(0.9f, 0.9f, 0.9f, 1.0f);
+        float y = h - kLineHeight;
+        for (const std::string& line : text_) {
+            pangolin::default_font().Text(line).Draw(kMargin, y);
+            y -= kLineHeight;
+        }
+        glPopAttrib();
+    }
+
+    void setupUI() override {
+        std::string prefix = "ui." + name_ + ".";
+        show_view_ = std::make_unique<pangolin::Var<bool>>(prefix + "Show", true, true);
+        log_scale_ = std::make_unique<pangolin::Var<bool>>(prefix + "Log_Scale", false, true);
+    }
+
+    bool isShown() const override {
+        return show_view_ && show_view_->Get();
+    }
+
+private:
+    static constexpr float kMargin = 6.0f;
+    static constexpr float kLineHeight = 16.0f;
+    static constexpr int kTextRows = 5;  // reserved above the plot
+
+    const float* channelColor(size_t c) const {
+        static const float kGray[] = {0.85f, 0.85f, 0.85f};
+        static const float kRgb[3][3] = {{1.0f, 0.3f, 0.3f}, {0.3f, 1.0f, 0.3f}, {0.35f, 0.5f, 1.0f}};
+        return c < 3 && fills_colored_ ? kRgb[c] : kGray;
+    }
+
+    void buildCurves() {
+        rebuild_ = false;
+        fills_.clear();
+        lines_.clear();
+        text_.clear();
+        if (!stats_ || stats_->channels <= 0 || stats_->histogram.size() < static_cast<size_t>(stats_->channels) * kStatsBins) {
+            text_.push_back("no source frames");
+            return;
+        }
+        const ImageStats& s = *stats_;
+        const int shown = std::min(s.channels, 3);  // alpha is not plotted
+        fills_colored_ = shown > 1;
+        // Invalid 8-bit depth piles up in bin 0; leave it out so it does not flatten
+        // the curve. Float stats keep invalid samples out of the bins altogether.
+        std::uint64_t binned = 0;
+        for (int b = 0; b < kStatsBins && s.channels == 1; ++b)
+            binned += s.histogram[b];
+        const bool has_invalid = s.channels == 1 && s.valid < s.samples && binned == s.samples;
+        const int first_bin = has_invalid ? 1 : 0;
+
+        std::uint32_t peak = 1;
+        for (int c = 0; c < shown; ++c)
+            for (int b = first_bin; b < kStatsBins; ++b)
+                peak = std::max(peak, s.histogram[static_cast<size_t>(c) * kStatsBins + b]);
+        const double norm = log_scale_shown_ ? 1.0 / std::log1p(static_cast<double>(peak)) : 1.0 / peak;
+
+        fills_.resize(shown);
+        lines_.resize(shown);
+        for (int c = 0; c < shown; ++c) {
+            std::vector<float>& fill = fills_[c];
+            std::vector<float>& line = lines_[c];
+            fill.reserve(kStatsBins * 4);
+            line.reserve(kStatsBins * 2);
+            for (int b = first_bin; b < kStatsBins; ++b) {
+                const double count = s.histogram[static_cast<size_t>(c) * kStatsBins + b];
+                const float x = (b + 0.5f) / kStatsBins;
+                const float y = static_cast<float>((log_scale_shown_ ? std::log1p(count) : count) * norm);
+                fill.insert(fill.end(), {x, 0.0f, x, y});
+                line.insert(line.end(), {x, y});
+            }
+        }
+
+        static const char* kNames[4] = {"R", "G", "B", "A"};
+        char buf[128];
+        for (int c = 0; c < s.channels && c < 4; ++c) {
+            std::snprintf(buf, sizeof(buf), "%s min %g  max %g  mean %.4g", s.channels == 1 ? "" : kNames[c],
+                          static_cast<double>(s.min[c]), static_cast<double>(s.max[c]), static_cast<double>(s.mean[c]));
+            text_.push_back(buf[0] == ' ' ? buf + 1 : buf);
+        }
+        const double valid_pct = s.samples ? 100.0 * static_cast<double>(s.valid) / static_cast<double>(s.samples) : 0.0;
+        std::snprintf(buf, sizeof(buf), "samples %llu  valid %llu (%.1f%%)",
+                      static_cast<unsigned long long>(s.samples), static_cast<unsigned long long>(s.valid), valid_pct);
+        text_.push_back(buf);
+    }
+
+    std::string name_;
+    pangolin::View* view_;
+    std::shared_ptr<const ImageStats> stats_;
+    bool rebuild_ = true;
+    bool log_scale_shown_ = false;
+    bool fills_colored_ = false;
+    std::vector<std::vector<float>> fills_;  // per channel: triangle strip down to the axis
+    std::vector<std::vector<float>> lines_;  // per channel: curve outline
+    std::vector<std::string> text_;
+    std::unique_ptr<pangolin::Var<bool>> show_view_;
+    std::unique_ptr<pangolin::Var<bool>> log_scale_;
+};
+
+std::unique_ptr<Viewport> createHistogramViewport(const std::string& name, float aspect_ratio) {
+    return std::make_unique<HistogramViewport>(name, aspect_ratio);
+}
+
+} // namespace viewportal
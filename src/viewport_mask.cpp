@@ -0,0 +1,122 @@
+#include "viewport_mask.h"
+#include "texture_upload.h"
+#include <algorithm>
+#include <cmath>
+
+namespace viewportal {
+
+namespace {
+
+const char* kMaskFragmentShader = R"GLSL(
+#version 130
+uniform usampler2D u_mask;
+uniform sampler2D u_palette;
+uniform int u_palette_size;
+uniform float u_opacity;
+in vec2 v_uv;
+void main() {
+    ivec2 size = textureSize(u_mask, 0);
+    ivec2 p = clamp(ivec2(v_uv * vec2(size)), ivec2(0), size - 1);
+    uint label = texelFetch(u_mask, p, 0).r;
+    vec4 c = texelFetch(u_palette, ivec2(int(label % uint(u_palette_size)), 0), 0);
+    gl_FragColor = vec4(c.rgb, c.a * u_opacity);
+}
+)GLSL";
+
+constexpr int kDefaultPaletteSize = 256;
+
+// Class 0 transparent; other classes get well-separated hues (golden-ratio steps).
+std::vector<OverlayColor> buildDefaultPalette() {
+    std::vector<OverlayColor> colors(kDefaultPaletteSize);
+    colors[0].a = 0.0f;
+    float hue = 0.0f;
+    for (int i = 1; i < kDefaultPaletteSize; ++i) {
+        hue = std::fmod(hue + 0.618034f, 1.0f);
+        const float h6 = hue * 6.0f;
+        const float x = 1.0f - std::abs(std::fmod(h6, 2.0f) - 1.0f);
+        float r = 0.0f, g = 0.0f, b = 0.0f;
+        switch (static_cast<int>(h6)) {
+            case 0: r = 1.0f; g = x; break;
+            case 1: r = x; g = 1.0f; break;
+            case 2: g = 1.0f; b = x; break;
+            case 3: g = x; b = 1.0f; break;
+            case 4: r = x; b = 1.0f; break;
+            default: r = 1.0f; b = x; break;
+        }
+        colors[i] = OverlayColor{r, g, b, 1.0f};
+    }
+    return colors;
+}
+
+} // namespace
+
+void MaskLayer::setMask(const MaskFrame* mask) {
+    if (!mask || mask->width <= 0 || mask->height <= 0 || mask->data.empty()) {
+        has_mask_ = false;
+        return;
+    }
+    const bool is16 = mask->format == MaskFormat::Label16;
+    const GLenum gl_type = is16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+    if (!mask_texture_.IsValid() || mask->width != mask_width_ || mask->height != mask_height_ ||
+        mask->format != mask_format_) {
+        mask_width_ = mask->width;
+        mask_height_ = mask->height;
+        mask_format_ = mask->format;
+        mask_texture_.Reinitialise(mask_width_, mask_height_, is16 ? GL_R16UI : GL_R8UI, false, 0,
+                                   GL_RED_INTEGER, gl_type);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    mask_texture_.Upload(mask->data.data(), GL_RED_INTEGER, gl_type);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    has_mask_ = true;
+}
+
+void MaskLayer::setPalette(std::shared_ptr<const MaskPalette> palette) {
+    palette_ = std::move(palette);
+    palette_dirty_ = true;
+}
+
+bool MaskLayer::ensureProgram() {
+    return ensureQuadProgram(program_, program_failed_, kMaskFragmentShader);
+}
+
+void MaskLayer::uploadPalette() {
+    static const std::vector<OverlayColor> kDefaultPalette = buildDefaultPalette();
+    const std::vector<OverlayColor>& colors =
+        (palette_ && !palette_->colors.empty()) ? palette_->colors : kDefaultPalette;
+    palette_size_ = static_cast<int>(colors.size());
+    std::vector<float> rgba;
+    rgba.reserve(colors.size() * 4);
+    for (const OverlayColor& c : colors) {
+        rgba.push_back(c.r);
+        rgba.push_back(c.g);
+        rgba.push_back(c.b);
+        rgba.push_back(c.a);
+    }
+    palette_texture_.Reinitialise(palette_size_, 1, GL_RGBA8, false, 0, GL_RGBA, GL_FLOAT, rgba.data());
+    palette_dirty_ = false;
+}
+
+void MaskLayer::render(const ImageRegion& region, int image_width, int image_height) {
+    if (!has_mask_ || image_width <= 0 || image_height <= 0 || !ensureProgram()) return;
+    if (palette_dirty_) uploadPalette();
+    const float opacity = palette_ ? palette_->opacity : MaskPalette().opacity;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Mask spans [0, 1]^2 with a top-left origin, like the image rows.
+    beginQuadPass(program_, mask_texture_, palette_texture_, region.x0 / image_width, region.x1 / image_width,
+                  region.y1 / image_height, region.y0 / image_height);
+    program_.SetUniform("u_mask", 0);
+    program_.SetUniform("u_palette", 1);
+    program_.SetUniform("u_palette_size", palette_size_);
+    program_.SetUniform("u_opacity", opacity);
+
+    endQuadPass(program_);
+    glPopAttrib();
+}
+
+} // namespace viewportal
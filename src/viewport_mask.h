@@ -0,0 +1,65 @@
+#ifndef VIEWPORT_MASK_H
+#define VIEWPORT_MASK_H
+
+#include "viewportal.h"
+#include "image_zoom.h"
+#include <pangolin/gl/gl.h>
+#include <pangolin/gl/glsl.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Packed copy of a label mask, owned by the library.
+ */
+struct MaskFrame {
+    int width = 0;
+    int height = 0;
+    MaskFormat format = MaskFormat::Label8;
+    std::vector<std::uint8_t> data;
+};
+
+/**
+ * Blends a label mask over an image viewport on the GPU.
+ * The mask is uploaded as a GL_R8UI/GL_R16UI texture and the palette as a 1-row
+ * RGBA texture; a fragment shader looks up each label's color. The shader is
+ * compiled on first use, so viewports that never get a mask pay nothing.
+ */
+class MaskLayer {
+public:
+    /**
+     * Upload a new mask (display thread). nullptr clears the layer.
+     */
+    void setMask(const MaskFrame* mask);
+
+    void setPalette(std::shared_ptr<const MaskPalette> palette);
+
+    /**
+     * Draw the blended mask into the currently active view. The mask covers the
+     * whole image; region selects the visible part (image pixels of an image of
+     * image_width x image_height).
+     */
+    void render(const ImageRegion& region, int image_width, int image_height);
+
+private:
+    bool ensureProgram();
+    void uploadPalette();
+
+    pangolin::GlTexture mask_texture_;
+    pangolin::GlTexture palette_texture_;
+    pangolin::GlSlProgram program_;
+    bool program_failed_ = false;
+    bool has_mask_ = false;
+    bool palette_dirty_ = true;
+    int mask_width_ = 0;
+    int mask_height_ = 0;
+    MaskFormat mask_format_ = MaskFormat::Label8;
+    int palette_size_ = 0;
+    std::shared_ptr<const MaskPalette> palette_;
+};
+
+} // namespace viewportal
+
+#endif // VIEWPORT_MASK_H
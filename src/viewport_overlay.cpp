@@ -0,0 +1,103 @@
+#include "viewport_overlay.h"
+#include <pangolin/gl/gl.h>
+#include <pangolin/gl/glfont.h>
+
+namespace viewportal {
+
+namespace {
+
+constexpr int kFloatsPerVertex = 6;
+
+void pushVertex(std::vector<float>& out, float x, float y, const OverlayColor& c) {
+    out.push_back(x);
+    out.push_back(y);
+    out.push_back(c.r);
+    out.push_back(c.g);
+    out.push_back(c.b);
+    out.push_back(c.a);
+}
+
+void drawBatch(const std::vector<float>& vertices, GLenum mode) {
+    if (vertices.empty()) return;
+    const GLsizei stride = kFloatsPerVertex * sizeof(float);
+    glVertexPointer(2, GL_FLOAT, stride, vertices.data());
+    glColorPointer(4, GL_FLOAT, stride, vertices.data() + 2);
+    glDrawArrays(mode, 0, static_cast<GLsizei>(vertices.size() / kFloatsPerVertex));
+}
+
+} // namespace
+
+void OverlayRenderer::set(std::shared_ptr<const Overlay> overlay) {
+    overlay_ = std::move(overlay);
+    line_vertices_.clear();
+    point_vertices_.clear();
+    if (!overlay_) return;
+
+    // All primitives are offset by half a pixel so integer coordinates land on pixel centers.
+    constexpr float c = 0.5f;
+    line_vertices_.reserve((overlay_->boxes.size() * 8 + overlay_->lines.size() * 2) * kFloatsPerVertex);
+    for (const OverlayBox& b : overlay_->boxes) {
+        pushVertex(line_vertices_, b.x0 + c, b.y0 + c, b.color);
+        pushVertex(line_vertices_, b.x1 + c, b.y0 + c, b.color);
+        pushVertex(line_vertices_, b.x1 + c, b.y0 + c, b.color);
+        pushVertex(line_vertices_, b.x1 + c, b.y1 + c, b.color);
+        pushVertex(line_vertices_, b.x1 + c, b.y1 + c, b.color);
+        pushVertex(line_vertices_, b.x0 + c, b.y1 + c, b.color);
+        pushVertex(line_vertices_, b.x0 + c, b.y1 + c, b.color);
+        pushVertex(line_vertices_, b.x0 + c, b.y0 + c, b.color);
+    }
+    for (const OverlayLine& l : overlay_->lines) {
+        pushVertex(line_vertices_, l.x0 + c, l.y0 + c, l.color);
+        pushVertex(line_vertices_, l.x1 + c, l.y1 + c, l.color);
+    }
+    point_vertices_.reserve(overlay_->points.size() * kFloatsPerVertex);
+    for (const OverlayPoint& p : overlay_->points)
+        pushVertex(point_vertices_, p.x + c, p.y + c, p.color);
+}
+
+void OverlayRenderer::render(const ImageRegion& region) const {
+    if (!overlay_ || region.x1 <= region.x0 || region.y1 <= region.y0) return;
+    if (line_vertices_.empty() && point_vertices_.empty() && overlay_->texts.empty()) return;
+
+    glPushAttrib(GL_ENABLE_BIT | GL_LINE_BIT | GL_POINT_BIT | GL_CURRENT_BIT);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(region.x0, region.x1, region.y1, region.y0, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glLineWidth(overlay_->line_width);
+    drawBatch(line_vertices_, GL_LINES);
+    glPointSize(overlay_->point_size);
+    drawBatch(point_vertices_, GL_POINTS);
+    glPopClientAttrib();
+
+    for (const OverlayText& t : overlay_->texts) {
+        glColor4f(t.color.r, t.color.g, t.color.b, t.color.a);
+        // Glyphs are laid out y-up: flip them back under the y-down image projection
+        glPushMatrix();
+        glTranslatef(t.x, t.y, 0.0f);
+        glScalef(1.0f, -1.0f, 1.0f);
+        pangolin::default_font().Text(t.text).Draw(0.0f, 0.0f);
+        glPopMatrix();
+    }
+
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopAttrib();
+}
+
+} // namespace viewportal
@@ -0,0 +1,38 @@
+#ifndef VIEWPORT_OVERLAY_H
+#define VIEWPORT_OVERLAY_H
+
+#include "viewportal.h"
+#include "image_zoom.h"
+#include <memory>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Draws an Overlay on top of an image viewport.
+ * Vertex data is rebuilt only when the overlay changes; each frame then costs one
+ * GL_LINES draw (boxes and lines), one GL_POINTS draw, and one call per text label.
+ */
+class OverlayRenderer {
+public:
+    /**
+     * Replace the overlay; nullptr or an empty overlay disables drawing.
+     */
+    void set(std::shared_ptr<const Overlay> overlay);
+
+    /**
+     * Draw into the currently active view, mapping the given image region (image
+     * pixels, top-left origin) onto the view.
+     */
+    void render(const ImageRegion& region) const;
+
+private:
+    // Interleaved x, y, r, g, b, a
+    std::vector<float> line_vertices_;
+    std::vector<float> point_vertices_;
+    std::shared_ptr<const Overlay> overlay_;
+};
+
+} // namespace viewportal
+
+#endif // VIEWPORT_OVERLAY_H
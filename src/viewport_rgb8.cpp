@@ -1,30 +1,25 @@
 #include "viewport.h"
+#include "viewport_overlay.h"
+#include "viewport_mask.h"
+#include "image_zoom.h"
+#include "tiled_image.h"
+#include "texture_upload.h"
+#include "buffer_pool.h"
 #include <pangolin/display/display.h>
 #include <pangolin/gl/gl.h>
 #include <pangolin/var/var.h>
-#include <cstdlib>
+#include <cstdint>
 #include <memory>
 
 namespace viewportal {
 
 class Rgb8Viewport : public Viewport {
 public:
-    Rgb8Viewport(const std::string& name, float aspect_ratio)
+    Rgb8Viewport(const std::string& name, float aspect_ratio, int width, int height)
         : name_(name),
-          width_(320),
-          height_(240),
-          colorImageArray_(nullptr) {
-        size_t color_buffer_size = 3 * width_ * height_;
-        colorImageArray_ = new unsigned char[color_buffer_size];
-        colorTexture_ = pangolin::GlTexture(width_, height_, GL_RGB, false, 0, GL_RGB, GL_UNSIGNED_BYTE);
-        view_ = &pangolin::Display(name).SetAspect(aspect_ratio);
-    }
-
-    ~Rgb8Viewport() override {
-        if (colorImageArray_) {
-            delete[] colorImageArray_;
-            colorImageArray_ = nullptr;
-        }
+          width_(width),
+          height_(height) {
+        view_ = &pangolin::Display(name).SetAspect(aspect_ratio).SetHandler(&zoom_);
     }
 
     pangolin::View& getView() override { return *view_; }
@@ -32,23 +27,100 @@ public:
 
     void setFrame(const FrameData& frame) override {
         user_frame_ = frame;
+        upload_.markFull();
+    }
+
+    void setFrameRegion(const FrameData& frame, int x, int y, int w, int h) override {
+        user_frame_ = frame;
+        upload_.markRect(x, y, w, h);
+    }
+
+    void reserve(int width, int height, ImageFormat format) override {
+        // The texture is created at this size by the first update(), so a viewport
+        // that is never shown allocates none
+        if (TiledImage::wanted(width, height)) return;  // tiles are built from the first frame
+        if (width == width_ && height == height_ && format == last_format_) return;
+        width_ = width;
+        height_ = height;
+        last_format_ = format;
+        colorTexture_.Delete();
+    }
+
+    bool imagePosition(float x, float y, float& image_x, float& image_y) const override {
+        return user_frame_.data != nullptr && viewToImage(*view_, zoom_.region(), x, y, image_x, image_y);
+    }
+
+    const pangolin::GlTexture* displayTexture(bool& bottom_up) const override {
+        bottom_up = bottom_up_;
+        return tiled_ || !colorTexture_.IsValid() ? nullptr : &colorTexture_;
+    }
+
+    void setOverlay(std::shared_ptr<const Overlay> overlay) override {
+        overlay_.set(std::move(overlay));
+    }
+
+    void setMask(std::shared_ptr<const MaskFrame> mask) override {
+        mask_.setMask(mask.get());
+    }
+
+    void setMaskPalette(std::shared_ptr<const MaskPalette> palette) override {
+        mask_.setPalette(std::move(palette));
+    }
+
+    void prepare() override {
+        // Noise until the first frame, drawn here so the display thread only uploads it
+        if (prepared_ || hasFrame()) return;
+        prepared_ = true;
+        placeholder_.resize(static_cast<size_t>(3 * width_ * height_));
+        setColorImageData(placeholder_.data(), 3 * width_ * height_);
     }
 
     void update() override {
-        if (user_frame_.data != nullptr && user_frame_.width > 0 && user_frame_.height > 0) {
-            ensureTextureSize(user_frame_.width, user_frame_.height, user_frame_.format);
-            uploadFrame(user_frame_);
+        if (hasFrame()) {
+            if (!upload_.pending) return;
+            placeholder_.reset();
+            const PendingUpload upload = upload_;
+            upload_.clear();
+            zoom_.setImageSize(user_frame_.width, user_frame_.height);
+            const bool was_tiled = tiled_;
+            tiled_ = TiledImage::wanted(user_frame_.width, user_frame_.height);
+            if (tiled_) {
+                tiled_image_.setImage(user_frame_);
+                return;
+            }
+            const bool resized = ensureTextureSize(user_frame_.width, user_frame_.height, user_frame_.format);
+            const bool bottom_up = user_frame_.row_stride < 0;
+            const int bpp = glFormatBytes(user_frame_.format);
+            if (upload.full || resized || was_tiled || bottom_up != bottom_up_)
+                uploadTexture(colorTexture_, user_frame_, bpp, glFormat(user_frame_.format));
+            else
+                uploadTextureRect(colorTexture_, user_frame_, bpp, upload.x, upload.y, upload.w, upload.h,
+                                  glFormat(user_frame_.format));
+            bottom_up_ = bottom_up;
             return;
         }
-        setColorImageData(colorImageArray_, 3 * width_ * height_);
-        colorTexture_.Upload(colorImageArray_, GL_RGB, GL_UNSIGNED_BYTE);
+        prepare();  // unless the display already ran it on a worker
+        prepared_ = false;
+        zoom_.setImageSize(width_, height_);
+        ensureTextureSize(width_, height_, last_format_);
+        colorTexture_.Upload(placeholder_.data(), GL_RGB, GL_UNSIGNED_BYTE);
     }
 
     void render() override {
         if (view_->IsShown()) {
             view_->Activate();
             glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-            colorTexture_.RenderToViewportFlipY();
+            const ImageRegion region = zoom_.region();
+            if (tiled_)
+                tiled_image_.render(region, view_->v.w, view_->v.h);
+            else if (zoom_.isZoomed() || bottom_up_)
+                renderTextureRegion(colorTexture_, region, bottom_up_);
+            else
+                colorTexture_.RenderToViewportFlipY();
+            const int image_width = tiled_ ? tiled_image_.width() : width_;
+            const int image_height = tiled_ ? tiled_image_.height() : height_;
+            mask_.render(region, image_width, image_height);
+            overlay_.render(region);
         }
     }
 
@@ -62,14 +134,25 @@ public:
     }
 
 private:
+    bool hasFrame() const {
+        return user_frame_.data != nullptr && user_frame_.width > 0 && user_frame_.height > 0;
+    }
+
     void setColorImageData(unsigned char* imageArray, int size) {
+        // xorshift32 per viewport: rand() is shared, and viewports prepare in parallel
+        std::uint32_t s = noise_state_;
         for (int i = 0; i < size; i++) {
-            imageArray[i] = (unsigned char)(rand() / (RAND_MAX / 255.0));
+            s ^= s << 13;
+            s ^= s >> 17;
+            s ^= s << 5;
+            imageArray[i] = static_cast<unsigned char>(s >> 24);
         }
+        noise_state_ = s;
     }
 
-    void ensureTextureSize(int w, int h, ImageFormat fmt) {
-        if (w == width_ && h == height_ && fmt == last_format_) return;
+    /** \return true if the texture was reallocated and needs a full upload. */
+    bool ensureTextureSize(int w, int h, ImageFormat fmt) {
+        if (w == width_ && h == height_ && fmt == last_format_ && colorTexture_.IsValid()) return false;
         width_ = w;
         height_ = h;
         last_format_ = fmt;
@@ -83,29 +166,44 @@ private:
             gl_format = GL_LUMINANCE;
         }
         colorTexture_ = pangolin::GlTexture(w, h, gl_internal, false, 0, gl_format, GL_UNSIGNED_BYTE);
+        return true;
     }
 
-    void uploadFrame(const FrameData& frame) {
-        GLenum gl_format = GL_RGB;
-        if (frame.format == ImageFormat::RGBA8) gl_format = GL_RGBA;
-        else if (frame.format == ImageFormat::Luminance8) gl_format = GL_LUMINANCE;
-        colorTexture_.Upload(frame.data, gl_format, GL_UNSIGNED_BYTE);
+    static GLenum glFormat(ImageFormat fmt) {
+        if (fmt == ImageFormat::RGBA8) return GL_RGBA;
+        if (fmt == ImageFormat::Luminance8) return GL_LUMINANCE;
+        return GL_RGB;
+    }
+
+    static int glFormatBytes(ImageFormat fmt) {
+        if (fmt == ImageFormat::RGBA8) return 4;
+        if (fmt == ImageFormat::Luminance8) return 1;
+        return 3;
     }
 
     FrameData user_frame_;
+    PendingUpload upload_;
     ImageFormat last_format_ = ImageFormat::RGB8;
 
     std::string name_;
     pangolin::View* view_;
     int width_;
     int height_;
-    unsigned char* colorImageArray_;
+    PooledBuffer placeholder_;  // noise shown until the first frame; released then
+    std::uint32_t noise_state_ = 2463534242u;
+    bool prepared_ = false;     // placeholder_ holds the noise for the next update()
     pangolin::GlTexture colorTexture_;
     std::unique_ptr<pangolin::Var<bool>> show_view_;
+    MaskLayer mask_;
+    OverlayRenderer overlay_;
+    ImageZoom zoom_;
+    TiledImage tiled_image_;
+    bool tiled_ = false;
+    bool bottom_up_ = false;  // texture rows stored bottom-up (frame had a negative stride)
 };
 
-std::unique_ptr<Viewport> createRgb8Viewport(const std::string& name, float aspect_ratio) {
-    return std::make_unique<Rgb8Viewport>(name, aspect_ratio);
+std::unique_ptr<Viewport> createRgb8Viewport(const std::string& name, float aspect_ratio, int width, int height) {
+    return std::make_unique<Rgb8Viewport>(name, aspect_ratio, width, height);
 }
 
 } // namespace viewportal
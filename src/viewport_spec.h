@@ -0,0 +1,26 @@
+#ifndef VIEWPORT_SPEC_H
+#define VIEWPORT_SPEC_H
+
+#include "viewportal.h"
+
+namespace viewportal {
+
+/**
+ * Whether image viewports of type t take frames of format f.
+ */
+bool acceptsFormat(ViewportType t, ImageFormat f);
+
+/**
+ * Format a viewport of the given type is prepared for: spec.format if the type
+ * takes it, else the type's usual format.
+ */
+ImageFormat specFormat(ViewportType type, const ViewportSpec& spec);
+
+/**
+ * Display aspect announced by spec (see ViewportSpec::aspect).
+ */
+float specAspect(const ViewportSpec& spec);
+
+} // namespace viewportal
+
+#endif // VIEWPORT_SPEC_H
@@ -1,6 +1,23 @@
 #include "viewportal.h"
 #include "viewportal_params.h"
 #include "viewport.h"
+#include "viewport_spec.h"
+#include "display_manager.h"
+#include "viewport_mask.h"
+#include "viewport_gallery.h"
+#include "buffer_pool.h"
+#include "texture_upload.h"
+#include "image_format.h"
+#include "stats_worker.h"
+#include "worker_pool.h"
+#include "spsc_ring.h"
+#include "latency_histogram.h"
+#ifdef VIEWPORTAL_WITH_STREAMING
+#include "stream_server.h"
+#endif
+#ifdef VIEWPORTAL_WITH_SHM
+#include "shm_consumer.h"
+#endif
 #include <pangolin/var/var.h>
 #include <pangolin/gl/gl.h>
 #include <pangolin/display/display.h>
@@ -15,66 +32,426 @@
 #include <cmath>
 #include <string>
 #include <stdexcept>
-#include <thread>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include <cstring>
+#include <cstdlib>
+#include <cstddef>
+#include <thread>
 #include <set>
+#include <map>
+#include <deque>
+#include <limits>
+#include <algorithm>
 
 namespace viewportal {
 
 namespace {
 
-constexpr float kDefaultAspect = 640.0f / 480.0f;
-
-static int bytesPerPixel(ImageFormat fmt) {
-    switch (fmt) {
-        case ImageFormat::RGB8: return 3;
-        case ImageFormat::RGBA8: return 4;
-        case ImageFormat::Luminance8: return 1;
-        default: return 3;
-    }
-}
-
+/** Bytes from the lowest to the highest address a frame's rows touch. */
 static size_t frameByteSize(const FrameData& f) {
+    const size_t row_bytes = static_cast<size_t>(f.width) * bytesPerPixel(f.format);
     if (f.row_stride != 0)
-        return static_cast<size_t>(f.height) * static_cast<size_t>(f.row_stride);
-    return static_cast<size_t>(f.width) * static_cast<size_t>(f.height) * bytesPerPixel(f.format);
+        return static_cast<size_t>(f.height - 1) * static_cast<size_t>(std::abs(f.row_stride)) + row_bytes;
+    return row_bytes * static_cast<size_t>(f.height);
 }
 
 static bool isImageViewport(ViewportType t) {
-    return t == ViewportType::RGB8 || t == ViewportType::G8 || t == ViewportType::ColoredDepth;
+    return t == ViewportType::RGB8 || t == ViewportType::G8 || t == ViewportType::ColoredDepth ||
+           t == ViewportType::Flow;
+}
+
+struct DirtyRect {
+    int x = 0, y = 0, w = 0, h = 0;  // w == 0: empty
+};
+
+void unionRect(DirtyRect& acc, const DirtyRect& r) {
+    if (r.w <= 0 || r.h <= 0) return;
+    if (acc.w <= 0 || acc.h <= 0) {
+        acc = r;
+        return;
+    }
+    const int x1 = std::max(acc.x + acc.w, r.x + r.w);
+    const int y1 = std::max(acc.y + acc.h, r.y + r.h);
+    acc.x = std::min(acc.x, r.x);
+    acc.y = std::min(acc.y, r.y);
+    acc.w = x1 - acc.x;
+    acc.h = y1 - acc.y;
+}
+
+/** frame_seq_shown value that forces the next frame to be taken in full. */
+constexpr std::uint64_t kNeverShown = ~std::uint64_t(0);
+
+/** Region list per buffer before it is cheaper to copy the whole frame across. */
+constexpr size_t kMaxStaleRects = 16;
+
+/** How long a blocked producer sleeps between checks for quit or a hidden cell. */
+constexpr std::chrono::milliseconds kDeliveryPoll(50);
+
+/** Viewports of one type parked for reuse by later adds; further removed ones are destroyed. */
+constexpr size_t kMaxRetiredPerType = 4;
+
+/** Default cap on threads preparing viewports; the uploads that follow stay serial. */
+constexpr int kMaxPrepareThreads = 4;
+
+/** A hidden cell still copies one frame per interval, so it is not far behind once shown. */
+constexpr std::int64_t kHiddenFrameIntervalNs = 250000000;
+
+/**
+ * A frame waiting for its presentation time (sync_timestamps mode) or its turn
+ * on screen (queued delivery policies); owner keeps the pixels alive.
+ */
+struct QueuedFrame {
+    FrameData frame;
+    std::shared_ptr<const void> owner;
+};
+
+/**
+ * Queue entry for frame: without an owner the pixels are copied, since the
+ * caller may reuse them once updateFrame() returns.
+ */
+QueuedFrame queuedFrame(const FrameData& frame, std::shared_ptr<const void> owner) {
+    QueuedFrame queued{frame, std::move(owner)};
+    if (queued.owner) return queued;
+    const size_t row_bytes = static_cast<size_t>(frame.width) * bytesPerPixel(frame.format);
+    const std::ptrdiff_t stride = frame.row_stride == 0 ? static_cast<std::ptrdiff_t>(row_bytes) : frame.row_stride;
+    auto copy = std::make_shared<PooledBuffer>();
+    copy->resize(row_bytes * static_cast<size_t>(frame.height));
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(frame.data);
+    for (int y = 0; y < frame.height; ++y)
+        std::memcpy(copy->data() + static_cast<size_t>(y) * row_bytes, src + y * stride, row_bytes);
+    queued.frame.data = copy->data();
+    queued.frame.row_stride = 0;
+    queued.owner = std::move(copy);
+    return queued;
 }
 
 struct ViewportFrameState {
-    std::vector<std::uint8_t> buffers[2];
+    PooledBuffer buffers[2];
     int width[2] = {0, 0};
+    int stride[2] = {0, 0};  // row stride kept from the producer (0 = packed); negative = bottom-up
+    // Externally owned frames: slot i shows the caller's pixels instead of buffers[i].
+    // Dropping the last reference runs the caller's release.
+    std::shared_ptr<const void> external[2];              // guarded by mutex
+    const std::uint8_t* external_lowest[2] = {nullptr, nullptr};  // lowest address of the external rows
+    bool released[2] = {false, false};                    // external frame already handed back
+    std::shared_ptr<const void> display_hold;             // display thread only: frame being uploaded
+    int display_slot = -1;                                // guarded by mutex; slot being uploaded, -1 if none
+    int pins[2] = {0, 0};                                 // guarded by mutex; readers of slot i outside the lock
+    // Viewports keep pointing at the last frame they were handed (e.g. to recolor
+    // it), so a block given up by that frame's slot is kept until the next one.
+    int shown_slot = -1;                                  // guarded by mutex; slot of that frame, -1 once retired
+    PooledBuffer retired;                                 // guarded by mutex
+    std::condition_variable slot_cv;                      // a slot was unpinned
     int height[2] = {0, 0};
     ImageFormat format[2] = {ImageFormat::RGB8, ImageFormat::RGB8};
     std::atomic<int> write_index{0};
+    std::atomic<std::uint64_t> frame_seq{0};  // bumped by updateFrame after each publish
+    std::uint64_t frame_seq_shown = 0;        // display thread only
+    std::uint64_t displayed_seq = 0;          // guarded by mutex; frame_seq last taken by the display
     std::mutex mutex;
+    // Region updates write one buffer only; these record what each buffer is missing
+    // relative to the newest frame, caught up before the buffer is written again.
+    bool stale_full[2] = {false, false};     // guarded by mutex
+    std::vector<DirtyRect> stale[2];         // guarded by mutex
+    bool pending_full = false;               // guarded by mutex; changed since the display last took a frame
+    DirtyRect pending_dirty;                 // guarded by mutex
+
+    /** Signed bytes from one image row to the next in buffer i. */
+    std::ptrdiff_t rowStep(int i) const {
+        return stride[i] != 0 ? stride[i] : static_cast<std::ptrdiff_t>(width[i]) * bytesPerPixel(format[i]);
+    }
+
+    /** Lowest address of slot i's rows: the external frame or the owned buffer. */
+    const std::uint8_t* lowest(int i) const {
+        return external[i] ? external_lowest[i] : buffers[i].data();
+    }
+
+    /** Top image row of slot i (rows are stored from their lowest address). */
+    const std::uint8_t* topRow(int i) const {
+        return lowest(i) + (stride[i] < 0 ? static_cast<std::ptrdiff_t>(height[i] - 1) * -stride[i] : 0);
+    }
+
+    /** Top image row of the owned buffer of slot i. */
+    std::uint8_t* ownedTopRow(int i) {
+        return buffers[i].data() + (stride[i] < 0 ? static_cast<std::ptrdiff_t>(height[i] - 1) * -stride[i] : 0);
+    }
+
+    /** Bytes spanned by slot i's rows. */
+    size_t span(int i) const {
+        const std::ptrdiff_t step = rowStep(i);
+        const size_t row_bytes = static_cast<size_t>(width[i]) * bytesPerPixel(format[i]);
+        return static_cast<size_t>(height[i] - 1) * static_cast<size_t>(step < 0 ? -step : step) + row_bytes;
+    }
+
+    bool hasPixels(int i) const {
+        return width[i] > 0 && height[i] > 0 && !released[i] && (external[i] || !buffers[i].empty());
+    }
+    std::shared_ptr<const Overlay> overlay;  // guarded by mutex; latest-wins
+    std::uint64_t overlay_seq = 0;           // guarded by mutex
+    std::uint64_t overlay_seq_shown = 0;     // display thread only
+    std::shared_ptr<MaskFrame> mask;         // guarded by mutex; latest-wins
+    std::shared_ptr<MaskFrame> mask_spare;   // guarded by mutex; recycled mask storage
+    std::shared_ptr<const MaskPalette> mask_palette;  // guarded by mutex
+    std::uint64_t mask_seq = 0;              // guarded by mutex; bumped on mask or palette change
+    std::uint64_t mask_seq_shown = 0;        // display thread only
+    std::shared_ptr<const ColormapParams> colormap;  // guarded by mutex; ColoredDepth cells
+    std::uint64_t colormap_seq = 0;          // guarded by mutex
+    std::uint64_t colormap_seq_shown = 0;    // display thread only
+    std::shared_ptr<const ImageStats> stats; // guarded by mutex; Histogram cells: latest result
+    std::uint64_t stats_seq = 0;             // guarded by mutex
+    std::uint64_t stats_seq_shown = 0;       // display thread only
+    std::weak_ptr<ViewportFrameState> compare_a;  // guarded by mutex; Compare cells: source cells
+    std::weak_ptr<ViewportFrameState> compare_b;  // guarded by mutex
+    std::shared_ptr<const CompareParams> compare_params;  // guarded by mutex
+    std::uint64_t compare_seq = 0;           // guarded by mutex
+    std::uint64_t compare_seq_shown = 0;     // display thread only
+    std::weak_ptr<ViewportFrameState> stats_source;  // guarded by mutex; Histogram cells: source cell
+    // Set by the display thread: false while nothing reads this cell's frames
+    // (hidden, not compared, sampled or streamed), so ingest only counts them.
+    std::atomic<bool> wanted{true};
+    std::atomic<std::uint64_t> hidden_frames{0};  // frames dropped while not wanted
+    bool catch_up = false;                   // guarded by mutex; a frame was dropped since the newest full frame
+    DeliveryParams delivery;                 // guarded by mutex
+    std::deque<QueuedFrame> delivery_queue;  // guarded by mutex; frames behind the newest published one
+    std::condition_variable delivery_cv;     // a frame was displayed or left the queue
+    std::deque<QueuedFrame> sync_queue;      // guarded by mutex; oldest capture time first
+    std::int64_t sync_newest_ns = 0;         // guarded by mutex; newest capture time received
+    std::chrono::steady_clock::time_point sync_arrival;  // guarded by mutex; when it arrived
+    std::uint64_t sync_presented = 0;        // guarded by mutex
+    std::uint64_t sync_dropped = 0;          // guarded by mutex
+    std::int64_t sync_shown_ns = 0;          // guarded by mutex
+    int sync_ring_cap = 0;                   // guarded by mutex; shm-fed cells: most frames the ring can spare to sync_queue
+    // displayStats() counters
+    std::uint64_t published_frames = 0;      // guarded by mutex
+    std::uint64_t replaced_frames = 0;       // guarded by mutex
+    std::uint64_t displayed_frames = 0;      // guarded by mutex
+    std::atomic<std::uint64_t> dropped_frames{0};  // besides hidden_frames
+    std::int64_t published_ns = 0;           // guarded by mutex; when the newest frame was published
+    LatencyHistogram latency;                // guarded by mutex; publish to display
 };
 
+std::int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * The display takes the newest frame (seq) for drawing. Caller holds fs.mutex.
+ */
+void markDisplayed(ViewportFrameState& fs, std::uint64_t seq) {
+    fs.displayed_seq = seq;
+    ++fs.displayed_frames;
+    if (fs.published_ns != 0) fs.latency.record(steadyNowNs() - fs.published_ns);
+}
+
+/**
+ * Make slot w (just filled with frame) the newest frame: the other slot is now
+ * stale in full and the display takes the whole frame. Caller holds fs.mutex.
+ */
+void publishFrame(ViewportFrameState& fs, int w, const FrameData& frame) {
+    fs.width[w] = frame.width;
+    fs.height[w] = frame.height;
+    fs.format[w] = frame.format;
+    fs.released[w] = false;
+    fs.stale_full[w] = false;
+    fs.stale[w].clear();
+    fs.stale_full[1 - w] = true;
+    fs.stale[1 - w].clear();
+    fs.pending_full = true;
+    fs.catch_up = false;
+    ++fs.published_frames;
+    if (fs.frame_seq.load(std::memory_order_relaxed) != fs.displayed_seq) ++fs.replaced_frames;
+    fs.published_ns = steadyNowNs();
+    fs.write_index.store(1 - w, std::memory_order_release);
+    fs.frame_seq.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * Resize the buffer of slot i; the block the display was last handed is kept
+ * until it takes the next frame. Caller holds fs.mutex.
+ */
+void resizeSlot(ViewportFrameState& fs, int i, size_t bytes) {
+    if (i == fs.shown_slot && !fs.buffers[i].keepsBlock(bytes)) {
+        fs.retired = std::move(fs.buffers[i]);
+        fs.shown_slot = -1;
+    }
+    fs.buffers[i].resize(bytes);
+}
+
+/**
+ * Slot a full frame is copied into: the write slot, or, while the display or
+ * the stream encoder is still reading that one outside the lock, the newest
+ * frame, which is then replaced in place. Waits if both are being read.
+ */
+int copySlot(ViewportFrameState& fs, std::unique_lock<std::mutex>& lock) {
+    for (;;) {
+        const int w = fs.write_index.load(std::memory_order_relaxed);
+        if (fs.pins[w] == 0) return w;
+        if (fs.pins[1 - w] == 0) return 1 - w;
+        fs.slot_cv.wait(lock);
+    }
+}
+
+/**
+ * Make an externally owned frame the newest frame without copying it; the
+ * owner it replaces is returned in replaced, to be dropped after the lock.
+ * Caller holds fs.mutex.
+ */
+void publishExternalFrame(ViewportFrameState& fs, const FrameData& frame, std::shared_ptr<const void> owner,
+                          std::shared_ptr<const void>& replaced) {
+    const int w = fs.write_index.load(std::memory_order_relaxed);
+    replaced = std::move(fs.external[w]);
+    fs.external[w] = std::move(owner);
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(frame.data);
+    fs.external_lowest[w] = frame.row_stride < 0 ? src + static_cast<std::ptrdiff_t>(frame.height - 1) * frame.row_stride : src;
+    fs.stride[w] = frame.row_stride;
+    publishFrame(fs, w, frame);
+}
+
+/**
+ * Forget the frames of a cell that was retyped or removed: the newest frame and
+ * everything queued was sent for the old type. Buffer capacity is kept; the
+ * owners of external frames are moved to released, to be dropped after the
+ * lock. Caller holds fs.mutex.
+ */
+void discardFrames(ViewportFrameState& fs, std::vector<std::shared_ptr<const void>>& released) {
+    for (int k = 0; k < 2; ++k) {
+        // The display keeps its own reference to a frame it is uploading (display_hold)
+        if (fs.external[k]) {
+            released.push_back(std::move(fs.external[k]));
+            fs.released[k] = true;
+        }
+        fs.width[k] = 0;
+        fs.height[k] = 0;
+        fs.stride[k] = 0;
+        fs.stale_full[k] = true;
+        fs.stale[k].clear();
+    }
+    fs.dropped_frames.fetch_add(fs.delivery_queue.size(), std::memory_order_relaxed);
+    fs.sync_dropped += fs.sync_queue.size();
+    for (QueuedFrame& q : fs.delivery_queue)
+        released.push_back(std::move(q.owner));
+    for (QueuedFrame& q : fs.sync_queue)
+        released.push_back(std::move(q.owner));
+    fs.delivery_queue.clear();
+    fs.sync_queue.clear();
+    fs.catch_up = false;
+    // Nothing is left to show, so waitUntilDisplayed() need not wait for it
+    fs.displayed_seq = fs.frame_seq.load(std::memory_order_relaxed);
+}
+
+/**
+ * One cell of the requested layout. The frame state is shared so that a cell
+ * keeps its ingest buffers when it is retyped or moved by add/remove.
+ */
+struct LayoutEntry {
+    ViewportType type = ViewportType::RGB8;
+    std::shared_ptr<ViewportFrameState> frame_state;
+    ViewportSpec spec;
+};
+
+/**
+ * A new cell; with a sized spec, both ingest buffers are allocated up front and
+ * the spec's colormap is queued as by setColormap().
+ */
+LayoutEntry makeLayoutEntry(ViewportType type, const ViewportSpec& spec) {
+    LayoutEntry e{type, std::make_shared<ViewportFrameState>(), spec};
+    if (!isImageViewport(type)) return e;
+    ViewportFrameState& fs = *e.frame_state;
+    if (spec.width > 0 && spec.height > 0) {
+        const size_t bytes = static_cast<size_t>(spec.width) * static_cast<size_t>(spec.height) *
+                             bytesPerPixel(specFormat(type, spec));
+        // Touched now: otherwise the first frames still pay the page faults
+        for (PooledBuffer& buffer : fs.buffers) {
+            buffer.resize(bytes);
+            std::memset(buffer.data(), 0, bytes);
+        }
+    }
+    if (spec.colormap && type == ViewportType::ColoredDepth) {
+        fs.colormap = std::make_shared<const ColormapParams>(*spec.colormap);
+        ++fs.colormap_seq;
+    }
+    return e;
+}
+
+constexpr size_t kInputEventCapacity = 4096;
+
+int inputModifiers(int button_state) {
+    return ((button_state & pangolin::KeyModifierShift) ? InputModifierShift : 0) |
+           ((button_state & pangolin::KeyModifierCtrl) ? InputModifierCtrl : 0) |
+           ((button_state & pangolin::KeyModifierAlt) ? InputModifierAlt : 0);
+}
+
 struct DoubleClickFullscreenHandler : pangolin::Handler {
     static constexpr double kDoubleClickTimeSec = 0.35;
     static constexpr int kDoubleClickSlopPx = 8;
+    static constexpr int kButtonMask = pangolin::MouseButtonLeft | pangolin::MouseButtonMiddle | pangolin::MouseButtonRight;
 
-    std::function<void(int view_id)> on_double_click;
+    std::function<void(int view_id, int x, int y)> on_double_click;
     std::function<void(int)> on_key_press;
+    std::function<void(InputEvent& event, float x, float y)> on_input;  // every event, before it is handled
     double last_click_time = 0.0;
     int last_click_x = 0;
     int last_click_y = 0;
     int last_click_view_id = 0;
 
     void Keyboard(pangolin::View& view, unsigned char key, int x, int y, bool pressed) override {
+        if (on_input) {
+            InputEvent e;
+            e.type = pressed ? InputEventType::KeyDown : InputEventType::KeyUp;
+            e.key = static_cast<int>(key);
+            on_input(e, static_cast<float>(x), static_cast<float>(y));
+        }
         if (pressed && on_key_press)
             on_key_press(static_cast<int>(key));
         pangolin::Handler::Keyboard(view, key, x, y, pressed);
     }
 
+    void MouseMotion(pangolin::View& view, int x, int y, int button_state) override {
+        motion(x, y, button_state);
+        pangolin::Handler::MouseMotion(view, x, y, button_state);
+    }
+
+    void PassiveMouseMotion(pangolin::View& view, int x, int y, int button_state) override {
+        motion(x, y, button_state);
+        pangolin::Handler::PassiveMouseMotion(view, x, y, button_state);
+    }
+
+    void Special(pangolin::View& view, pangolin::InputSpecial type, float x, float y,
+                 float p1, float p2, float p3, float p4, int button_state) override {
+        if (on_input && type == pangolin::InputSpecialScroll) {
+            InputEvent e;
+            e.type = InputEventType::Scroll;
+            e.buttons = button_state & kButtonMask;
+            e.modifiers = inputModifiers(button_state);
+            e.scroll_x = p1;
+            e.scroll_y = p2;
+            on_input(e, x, y);
+        }
+        pangolin::Handler::Special(view, type, x, y, p1, p2, p3, p4, button_state);
+    }
+
     void Mouse(pangolin::View& view, pangolin::MouseButton button, int x, int y, bool pressed, int button_state) override {
-        (void)button_state;
+        if (on_input) {
+            InputEvent e;
+            e.buttons = button_state & kButtonMask;
+            e.modifiers = inputModifiers(button_state);
+            if (button == pangolin::MouseWheelUp || button == pangolin::MouseWheelDown) {
+                e.type = InputEventType::Scroll;
+                e.scroll_y = button == pangolin::MouseWheelUp ? 1.0f : -1.0f;
+            } else if (button == pangolin::MouseWheelRight || button == pangolin::MouseWheelLeft) {
+                e.type = InputEventType::Scroll;
+                e.scroll_x = button == pangolin::MouseWheelRight ? 1.0f : -1.0f;
+            } else {
+                e.type = pressed ? InputEventType::MouseDown : InputEventType::MouseUp;
+                e.button = static_cast<int>(button);
+            }
+            // Wheels report press and release; one step is one event
+            if (e.type != InputEventType::Scroll || pressed)
+                on_input(e, static_cast<float>(x), static_cast<float>(y));
+        }
         if (button == pangolin::MouseButtonLeft && pressed && on_double_click) {
             int view_id = 0;
             for (size_t i = 0; i < view.NumChildren(); ++i) {
@@ -90,7 +467,7 @@ struct DoubleClickFullscreenHandler : pangolin::Handler {
                     last_click_view_id == view_id &&
                     std::abs(x - last_click_x) <= kDoubleClickSlopPx &&
                     std::abs(y - last_click_y) <= kDoubleClickSlopPx) {
-                    on_double_click(view_id);
+                    on_double_click(view_id, x, y);
                     last_click_time = 0.0;
                     return;
                 }
@@ -102,34 +479,107 @@ struct DoubleClickFullscreenHandler : pangolin::Handler {
         }
         pangolin::Handler::Mouse(view, button, x, y, pressed, button_state);
     }
+
+private:
+    void motion(int x, int y, int button_state) {
+        if (!on_input) return;
+        InputEvent e;
+        e.type = InputEventType::MouseMove;
+        e.buttons = button_state & kButtonMask;
+        e.modifiers = inputModifiers(button_state);
+        on_input(e, static_cast<float>(x), static_cast<float>(y));
+    }
 };
 
 } // namespace
 
-struct ViewPortal::Impl {
+#ifndef VIEWPORTAL_WITH_STREAMING
+/** Placeholders so that the window compiles without the socket server. */
+class StreamSource {
+public:
+    virtual ~StreamSource() = default;
+};
+class StreamServer {};
+#endif
+#ifndef VIEWPORTAL_WITH_SHM
+class ShmConsumer {};
+#endif
+
+struct ViewPortal::Impl : HostedWindow, StreamSource {
     ViewPortalParams params;
     std::string window_title_storage;  // when non-empty, params.window_title points into this
-    std::vector<ViewportType> viewport_types;  // stored for updateFrame image check
+    std::vector<ViewportType> viewport_types;  // display-side type of each entry in viewports
+    std::vector<ViewportSpec> viewport_specs;  // display-side, parallel to viewport_types
     std::vector<std::unique_ptr<Viewport>> viewports;
-    std::vector<std::unique_ptr<ViewportFrameState>> frame_states;  // one per viewport; used only for image viewports
+    std::vector<std::shared_ptr<ViewportFrameState>> frame_states;  // display-side, parallel to viewports
+    std::vector<bool> refreshed;  // display-side, parallel to frame_states: fed and updated this step
+    std::map<ViewportType, std::vector<std::unique_ptr<Viewport>>> retired_viewports;  // parked for reuse
+    int next_view_id = 0;
+    std::vector<std::string> free_view_names;  // of destroyed viewports; their Pangolin views and Vars are reused
+
+    // Requested layout; written by the public API from any thread, applied by the display thread.
+    mutable std::mutex layout_mutex;
+    std::vector<LayoutEntry> layout;
+    std::uint64_t layout_version = 0;
+    std::uint64_t applied_layout_version = 0;  // only touched on display thread
     int fullscreen_view = 0;
     bool state_saved = false;
     std::vector<pangolin::Attach> saved_top, saved_left, saved_right, saved_bottom;
     std::vector<bool> saved_visible;
+    std::vector<double> saved_aspect;
     std::unique_ptr<DoubleClickFullscreenHandler> double_click_handler;
     std::string window_name;
 
-    std::thread display_thread;
+    std::unique_ptr<DisplayManager> owned_manager;  // set when not hosted on a shared manager
+    DisplayManager* manager = nullptr;
+    std::atomic<bool> dirty{true};
+    std::atomic<bool> animated{false};  // layout has viewports that change every frame (e.g. Plot)
     std::atomic<bool> quit_requested{false};
+    std::atomic<std::uint64_t> display_steps{0};
     std::atomic<bool> init_done{false};
     std::mutex init_mutex;
     std::condition_variable init_cv;
 
+    // Gallery (large-grid) mode; display thread only
+    std::unique_ptr<GalleryViewport> gallery;
+    int gallery_native = -1;  // cell shown at native resolution, -1 while the grid is shown
+    ViewportType gallery_native_type = ViewportType::RGB8;
+    std::unique_ptr<Viewport> gallery_native_viewport;
+
     mutable std::mutex key_mutex;
     mutable std::set<int> pending_keys;
 
     int init_rows = 0;
     int init_cols = 0;
+
+    // Remote viewing; the server's threads read frames through the StreamSource interface
+    std::mutex stream_mutex;
+    std::shared_ptr<StreamServer> stream_server;
+    // The composite is read back into two pixel-pack buffers in turn: the window
+    // goes into one while the other, read a frame earlier, is mapped and handed
+    // over, so glReadPixels does not wait for drawing to finish. Display thread only.
+    GLuint composite_pbo[2] = {0, 0};
+    size_t composite_pbo_bytes[2] = {0, 0};
+    int composite_pbo_size[2][2] = {{0, 0}, {0, 0}};  // width, height read into each
+    int composite_pending = -1;                       // buffer read but not handed over yet
+    // Shared-memory rings feeding image viewports; created on first attach
+    std::mutex shm_mutex;
+    std::unique_ptr<ShmConsumer> shm_consumer;
+    // Statistics for Histogram cells; created on first setHistogramSource()
+    std::mutex stats_mutex;
+    std::unique_ptr<StatsWorker> stats_worker;
+    // Viewport prepare() work; created by the first frame with two cells to prepare
+    std::unique_ptr<WorkerPool> prepare_pool;          // display thread only
+    std::vector<Viewport*> prepare_cells;              // display thread only
+    std::vector<std::function<void()>> prepare_tasks;  // display thread only
+    // sync_timestamps mode
+    std::int64_t sync_presentation_ns = 0;  // display thread only
+    mutable std::mutex sync_mutex;
+    SyncStats sync_stats;                   // guarded by sync_mutex
+    // Input events for pollEvent(): produced on the display thread, consumed by the app
+    SpscRing<InputEvent> input_events{kInputEventCapacity};
+    std::atomic<bool> input_events_enabled{false};  // set by the first pollEvent()
+    std::atomic<std::uint64_t> input_events_dropped{0};
     std::vector<int> keys_to_watch;
     bool keys_to_watch_pending = false;
     std::set<int> keys_registered;  // only touched on display thread
@@ -141,6 +591,7 @@ struct ViewPortal::Impl {
         saved_right.resize(n);
         saved_bottom.resize(n);
         saved_visible.resize(n);
+        saved_aspect.resize(n);
         for (size_t i = 0; i < n; ++i) {
             pangolin::View& v = viewports[i]->getView();
             saved_top[i] = v.top;
@@ -148,15 +599,16 @@ struct ViewPortal::Impl {
             saved_right[i] = v.right;
             saved_bottom[i] = v.bottom;
             saved_visible[i] = v.IsShown();
+            saved_aspect[i] = v.aspect;
         }
         state_saved = true;
     }
 
     void exitFullscreen() {
         if (fullscreen_view != 0 && state_saved) {
-            viewports[static_cast<size_t>(fullscreen_view - 1)]->getView().SetAspect(static_cast<double>(kDefaultAspect));
             for (size_t i = 0; i < viewports.size(); ++i) {
                 pangolin::View& v = viewports[i]->getView();
+                v.SetAspect(saved_aspect[i]);
                 v.SetBounds(saved_bottom[i], saved_top[i], saved_left[i], saved_right[i]);
                 v.Show(saved_visible[i]);
             }
@@ -178,24 +630,1030 @@ struct ViewPortal::Impl {
             // Bounds (0,1,0,1) = fill parent "multi" (area right of panel); no extra left margin
             v.SetBounds(0.0, 1.0, 0.0, 1.0);
             // Negative aspect: fill width, letterbox top/bottom (avoids left/right borders on wide windows)
-            v.SetAspect(-static_cast<double>(kDefaultAspect));
+            v.SetAspect(-std::abs(v.aspect));
         }
         for (size_t i = 0; i < viewports.size(); ++i) {
             viewports[i]->getView().Show(i == idx);
         }
         fullscreen_view = view_id;
     }
+
+    /**
+     * Decide which cells need frames this step and publish it to the ingest side
+     * (display thread). A cell is refreshed when shown or read by a shown Compare
+     * cell; its frames are also wanted while a Histogram samples it or the window
+     * is streamed. Other cells keep no GL work and no frame copies.
+     */
+    void publishVisibility() {
+        bool streaming = false;
+#ifdef VIEWPORTAL_WITH_STREAMING
+        {
+            std::lock_guard<std::mutex> lock(stream_mutex);
+            streaming = stream_server != nullptr;
+        }
+#endif
+        const size_t n = frame_states.size();
+        auto indexOf = [&](const std::shared_ptr<ViewportFrameState>& state) {
+            for (size_t j = 0; j < n; ++j) {
+                if (state && frame_states[j] == state) return j;
+            }
+            return n;
+        };
+        refreshed.assign(n, false);
+        if (gallery) {
+            // The grid draws every tile; the native view only its cell
+            for (size_t i = 0; i < n; ++i)
+                refreshed[i] = gallery_native < 0 || static_cast<int>(i) == gallery_native;
+        } else {
+            for (size_t i = 0; i < n && i < viewports.size(); ++i)
+                refreshed[i] = viewports[i]->isShown() && viewports[i]->getView().IsShown();
+            for (size_t i = 0; i < n; ++i) {
+                if (!refreshed[i] || viewport_types[i] != ViewportType::Compare) continue;
+                std::shared_ptr<ViewportFrameState> a, b;
+                {
+                    std::lock_guard<std::mutex> lock(frame_states[i]->mutex);
+                    a = frame_states[i]->compare_a.lock();
+                    b = frame_states[i]->compare_b.lock();
+                }
+                for (size_t j : {indexOf(a), indexOf(b)}) {
+                    if (j < n) refreshed[j] = true;
+                }
+            }
+        }
+        std::vector<bool> wanted = refreshed;
+        for (size_t i = 0; i < n; ++i) {
+            if (viewport_types[i] != ViewportType::Histogram) continue;
+            std::shared_ptr<ViewportFrameState> source;
+            {
+                std::lock_guard<std::mutex> lock(frame_states[i]->mutex);
+                source = frame_states[i]->stats_source.lock();
+            }
+            const size_t j = indexOf(source);
+            if (j < n) wanted[j] = true;
+        }
+        for (size_t i = 0; i < n; ++i)
+            frame_states[i]->wanted.store(streaming || wanted[i], std::memory_order_relaxed);
+    }
+
+    /**
+     * Stamp an input event with its time, viewport and image position, and queue
+     * it for pollEvent() (display thread).
+     */
+    void pushInputEvent(InputEvent& e, float x, float y) {
+        if (!input_events_enabled.load(std::memory_order_relaxed)) return;
+        e.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        const Viewport* v = nullptr;
+        if (gallery) {
+            if (gallery_native >= 0) {
+                e.viewport = gallery_native;
+                v = gallery_native_viewport.get();
+            } else {
+                e.viewport = gallery->tileAt(static_cast<int>(x), static_cast<int>(y));  // tiles map no image position
+            }
+        } else {
+            for (size_t i = 0; i < viewports.size(); ++i) {
+                pangolin::View& view = viewports[i]->getView();
+                if (view.IsShown() && view.GetBounds().Contains(static_cast<int>(x), static_cast<int>(y))) {
+                    e.viewport = static_cast<int>(i);
+                    v = viewports[i].get();
+                    break;
+                }
+            }
+        }
+        if (v)
+            e.in_image = v->imagePosition(x, y, e.image_x, e.image_y);
+        if (!input_events.push(e))
+            input_events_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Request a redraw from the display manager (any thread).
+     */
+    void markDirty() {
+        dirty.store(true, std::memory_order_release);
+        if (manager)
+            manager->impl_->wake();
+    }
+
+#ifdef VIEWPORTAL_WITH_STREAMING
+    void streamLayout(int& rows, int& cols, std::vector<std::uint8_t>& types) override {
+        std::lock_guard<std::mutex> lock(layout_mutex);
+        rows = init_rows;
+        cols = init_cols;
+        types.clear();
+        for (const LayoutEntry& e : layout)
+            types.push_back(static_cast<std::uint8_t>(e.type));
+    }
+
+    bool streamSnapshot(size_t index, std::uint64_t last_seq, StreamImage& out) override {
+        std::shared_ptr<ViewportFrameState> state;
+        {
+            std::lock_guard<std::mutex> lock(layout_mutex);
+            if (index >= layout.size() || !isImageViewport(layout[index].type)) return false;
+            state = layout[index].frame_state;
+        }
+        ViewportFrameState& fs = *state;
+        // Pin the newest frame and copy it without the lock, so producers are not
+        // held up; an external frame is kept alive by its owner meanwhile
+        int ri = 0;
+        const std::uint8_t* top = nullptr;
+        std::ptrdiff_t step = 0;
+        std::shared_ptr<const void> owner;
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            const std::uint64_t seq = fs.frame_seq.load(std::memory_order_acquire);
+            ri = 1 - fs.write_index.load(std::memory_order_acquire);
+            if (seq == last_seq || !fs.hasPixels(ri)) return false;
+            out.format = fs.format[ri];
+            out.width = fs.width[ri];
+            out.height = fs.height[ri];
+            out.seq = seq;
+            top = fs.topRow(ri);
+            step = fs.rowStep(ri);
+            owner = fs.external[ri];
+            ++fs.pins[ri];
+        }
+        const size_t row_bytes = static_cast<size_t>(out.width) * bytesPerPixel(out.format);
+        out.pixels.resize(row_bytes * out.height);
+        for (int y = 0; y < out.height; ++y)
+            std::memcpy(out.pixels.data() + y * row_bytes, top + y * step, row_bytes);
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            --fs.pins[ri];
+        }
+        fs.slot_cv.notify_all();
+        return true;
+    }
+
+    /**
+     * Read back the drawn window for composite streaming when the server asks
+     * for it, and hand over the one read the frame before. Display thread, before
+     * the buffers are swapped.
+     */
+    void streamComposite() {
+        std::shared_ptr<StreamServer> server;
+        {
+            std::lock_guard<std::mutex> lock(stream_mutex);
+            server = stream_server;
+        }
+        const int ready = composite_pending;
+        composite_pending = -1;
+        if (!server) return;
+        const pangolin::Viewport& vp = pangolin::DisplayBase().v;
+        if (server->wantsComposite() && vp.w > 0 && vp.h > 0) {
+            const int next = ready == 0 ? 1 : 0;
+            if (composite_pbo[0] == 0) glGenBuffers(2, composite_pbo);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, composite_pbo[next]);
+            const size_t bytes = static_cast<size_t>(vp.w) * vp.h * 3;
+            if (composite_pbo_bytes[next] != bytes) {
+                glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(bytes), nullptr, GL_STREAM_READ);
+                composite_pbo_bytes[next] = bytes;
+            }
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(vp.l, vp.b, vp.w, vp.h, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            composite_pbo_size[next][0] = vp.w;
+            composite_pbo_size[next][1] = vp.h;
+            composite_pending = next;
+            dirty.store(true, std::memory_order_release);  // hand it over next frame even if idle
+        }
+        if (ready >= 0) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, composite_pbo[ready]);
+            const void* pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+            if (pixels) {
+                server->submitComposite(composite_pbo_size[ready][0], composite_pbo_size[ready][1],
+                                        static_cast<const std::uint8_t*>(pixels));
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+        }
+        if (ready >= 0 || composite_pending >= 0) glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+#else
+    void streamComposite() {}
+#endif
+
+    /**
+     * Whether to skip copying a frame for a cell nothing reads (any thread). One
+     * frame per kHiddenFrameIntervalNs is still taken, so a frame sent once is
+     * shown when the cell is, and a stream is at most that far behind until its
+     * next frame. A skipped frame marks the cell as behind (catch_up), which holds
+     * off region updates until the next full frame.
+     */
+    static bool dropUnwanted(ViewportFrameState& fs) {
+        if (fs.wanted.load(std::memory_order_relaxed)) return false;
+        std::lock_guard<std::mutex> lock(fs.mutex);
+        if (steadyNowNs() - fs.published_ns >= kHiddenFrameIntervalNs) return false;
+        fs.catch_up = true;
+        fs.hidden_frames.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * In sync_timestamps mode, queue a timestamped frame until presentSynced()
+     * reaches its capture time; false if it should be shown right away (any thread).
+     */
+    bool enqueueSynced(ViewportFrameState& fs, const FrameData& frame, std::shared_ptr<const void> owner,
+                       FrameStatus& status) {
+        if (!params.sync_timestamps || frame.timestamp_ns == 0) return false;
+        QueuedFrame queued = queuedFrame(frame, std::move(owner));
+        const std::int64_t timestamp_ns = frame.timestamp_ns;
+        std::vector<std::shared_ptr<const void>> evicted;  // released after the lock is dropped
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            auto pos = std::upper_bound(fs.sync_queue.begin(), fs.sync_queue.end(), timestamp_ns,
+                                        [](std::int64_t t, const QueuedFrame& e) { return t < e.frame.timestamp_ns; });
+            const size_t position = static_cast<size_t>(pos - fs.sync_queue.begin());
+            fs.sync_queue.insert(pos, std::move(queued));
+            size_t depth = static_cast<size_t>(std::max(1, params.sync_queue_depth));
+            if (fs.sync_ring_cap > 0) depth = std::min(depth, static_cast<size_t>(fs.sync_ring_cap));
+            const size_t excess = fs.sync_queue.size() > depth ? fs.sync_queue.size() - depth : 0;
+            for (size_t k = 0; k < excess; ++k) {
+                evicted.push_back(std::move(fs.sync_queue.front().owner));
+                fs.sync_queue.pop_front();
+                ++fs.sync_dropped;
+            }
+            // Older than everything kept: the frame itself was evicted
+            status = position < excess ? FrameStatus::Dropped
+                   : excess > 0        ? FrameStatus::Replaced
+                                       : FrameStatus::Accepted;
+            if (status == FrameStatus::Dropped) fs.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+            fs.replaced_frames += excess - (status == FrameStatus::Dropped ? 1 : 0);
+            fs.sync_newest_ns = std::max(fs.sync_newest_ns, timestamp_ns);
+            fs.sync_arrival = std::chrono::steady_clock::now();
+        }
+        markDirty();
+        return true;
+    }
+
+    /**
+     * Queue a frame for a BlockWhenFull or DropOldest cell (any thread); false
+     * for LatestWins cells, which publish in place. The frame is published at
+     * once when nothing is waiting ahead of it, otherwise advanceQueues() hands
+     * it on after the frames before it were displayed.
+     */
+    bool enqueueDelivery(ViewportFrameState& fs, const FrameData& frame, std::shared_ptr<const void> owner,
+                         FrameStatus& status) {
+        DeliveryParams delivery;
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            delivery = fs.delivery;
+        }
+        if (delivery.policy == DeliveryPolicy::LatestWins) return false;
+        QueuedFrame queued = queuedFrame(frame, std::move(owner));
+        std::shared_ptr<const void> released;  // dropped after the lock
+        {
+            std::unique_lock<std::mutex> lock(fs.mutex);
+            const size_t depth = static_cast<size_t>(std::max(1, delivery.queue_depth));
+            if (delivery.policy == DeliveryPolicy::BlockWhenFull) {
+                const auto deadline = std::chrono::steady_clock::now() +
+                                      std::chrono::milliseconds(std::max(0, delivery.block_timeout_ms));
+                while (fs.delivery_queue.size() >= depth) {
+                    // Nothing would ever drain the queue of a closed window or a hidden cell
+                    if (quit_requested.load(std::memory_order_acquire) ||
+                        !fs.wanted.load(std::memory_order_relaxed) ||
+                        (delivery.block_timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline)) {
+                        status = FrameStatus::Dropped;
+                        fs.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    fs.delivery_cv.wait_for(lock, kDeliveryPoll);
+                }
+            }
+            status = FrameStatus::Accepted;
+            if (fs.delivery_queue.empty() && fs.frame_seq.load(std::memory_order_relaxed) == fs.displayed_seq) {
+                publishExternalFrame(fs, queued.frame, std::move(queued.owner), released);
+            } else {
+                if (fs.delivery_queue.size() >= depth) {
+                    released = std::move(fs.delivery_queue.front().owner);
+                    fs.delivery_queue.pop_front();
+                    ++fs.replaced_frames;
+                    status = FrameStatus::Replaced;
+                }
+                fs.delivery_queue.push_back(std::move(queued));
+            }
+        }
+        markDirty();
+        return true;
+    }
+
+    /**
+     * Take the newest frame of each cell that is read but not drawn, only by a
+     * Histogram or the stream (display thread). Producers then see later frames
+     * as Accepted, not Replaced, and waitUntilDisplayed() returns at the next
+     * display step. Not counted as displayed.
+     */
+    void consumeUndrawn() {
+        for (size_t i = 0; i < frame_states.size(); ++i) {
+            if (i < refreshed.size() && refreshed[i]) continue;
+            ViewportFrameState& fs = *frame_states[i];
+            if (!fs.wanted.load(std::memory_order_relaxed)) continue;
+            {
+                std::lock_guard<std::mutex> lock(fs.mutex);
+                const std::uint64_t seq = fs.frame_seq.load(std::memory_order_relaxed);
+                if (seq == fs.displayed_seq) continue;
+                fs.displayed_seq = seq;
+            }
+            fs.delivery_cv.notify_all();
+        }
+    }
+
+    /**
+     * Publish the next queued frame of each BlockWhenFull or DropOldest cell
+     * once the frame before it was displayed (display thread). Cells that are
+     * not refreshed drain one frame per step.
+     */
+    void advanceQueues() {
+        std::vector<std::shared_ptr<const void>> released;  // dropped after the locks
+        bool pending = false;
+        for (size_t i = 0; i < frame_states.size(); ++i) {
+            ViewportFrameState& fs = *frame_states[i];
+            {
+                std::lock_guard<std::mutex> lock(fs.mutex);
+                if (fs.delivery_queue.empty()) continue;
+                pending = true;
+                const bool shown = i < refreshed.size() && refreshed[i];
+                if (shown && fs.frame_seq.load(std::memory_order_relaxed) != fs.displayed_seq) continue;
+                QueuedFrame& next = fs.delivery_queue.front();
+                released.emplace_back();
+                publishExternalFrame(fs, next.frame, std::move(next.owner), released.back());
+                fs.delivery_queue.pop_front();
+            }
+            fs.delivery_cv.notify_all();
+        }
+        // One queued frame per display step: keep stepping until the queues are empty
+        if (pending) markDirty();
+    }
+
+    /**
+     * Publish the queued frames due at the common presentation time (display thread).
+     * A viewport that received nothing for sync_timeout_ms no longer holds the
+     * others back and shows its newest frame.
+     */
+    void presentSynced() {
+        if (!params.sync_timestamps) return;
+        std::vector<std::shared_ptr<ViewportFrameState>> states;
+        {
+            std::lock_guard<std::mutex> lock(layout_mutex);
+            states.resize(layout.size());
+            for (size_t i = 0; i < layout.size(); ++i) {
+                if (isImageViewport(layout[i].type))
+                    states[i] = layout[i].frame_state;
+            }
+        }
+        const auto now = std::chrono::steady_clock::now();
+        const auto timeout = std::chrono::milliseconds(std::max(0, params.sync_timeout_ms));
+        auto isActive = [&](const ViewportFrameState& fs) {
+            return fs.sync_newest_ns != 0 && now - fs.sync_arrival <= timeout &&
+                   fs.wanted.load(std::memory_order_relaxed);
+        };
+
+        // The latest instant every active viewport has data for; never moves back
+        std::int64_t target = std::numeric_limits<std::int64_t>::max();
+        for (const auto& state : states) {
+            if (!state) continue;
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (isActive(*state))
+                target = std::min(target, state->sync_newest_ns);
+        }
+        if (target != std::numeric_limits<std::int64_t>::max())
+            sync_presentation_ns = std::max(sync_presentation_ns, target);
+
+        SyncStats stats;
+        stats.presentation_ns = sync_presentation_ns;
+        stats.viewports.resize(states.size());
+        std::int64_t shown_min = std::numeric_limits<std::int64_t>::max();
+        std::int64_t shown_max = std::numeric_limits<std::int64_t>::min();
+        std::vector<std::shared_ptr<const void>> released;  // released after the locks are dropped
+        for (size_t i = 0; i < states.size(); ++i) {
+            if (!states[i]) continue;
+            ViewportFrameState& fs = *states[i];
+            SyncViewportStats& vs = stats.viewports[i];
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            vs.active = isActive(fs);
+            size_t due = fs.sync_queue.size();
+            if (vs.active) {
+                due = 0;
+                while (due < fs.sync_queue.size() && fs.sync_queue[due].frame.timestamp_ns <= sync_presentation_ns)
+                    ++due;
+            }
+            if (due > 0) {
+                // Only the newest due frame is shown; the ones before it were superseded
+                for (size_t k = 0; k + 1 < due; ++k)
+                    released.push_back(std::move(fs.sync_queue[k].owner));
+                fs.sync_dropped += due - 1;
+                fs.replaced_frames += due - 1;
+                QueuedFrame& shown = fs.sync_queue[due - 1];
+                std::shared_ptr<const void> replaced;
+                publishExternalFrame(fs, shown.frame, std::move(shown.owner), replaced);
+                released.push_back(std::move(replaced));
+                fs.sync_shown_ns = shown.frame.timestamp_ns;
+                ++fs.sync_presented;
+                fs.sync_queue.erase(fs.sync_queue.begin(), fs.sync_queue.begin() + static_cast<std::ptrdiff_t>(due));
+            }
+            vs.queued = fs.sync_queue.size();
+            vs.presented = fs.sync_presented;
+            vs.dropped = fs.sync_dropped;
+            vs.shown_ns = fs.sync_shown_ns;
+            stats.dropped += fs.sync_dropped;
+            if (vs.active && vs.shown_ns != 0) {
+                shown_min = std::min(shown_min, vs.shown_ns);
+                shown_max = std::max(shown_max, vs.shown_ns);
+            }
+        }
+        if (shown_min <= shown_max)
+            stats.skew_ns = shown_max - shown_min;
+
+        std::lock_guard<std::mutex> lock(sync_mutex);
+        stats.max_skew_ns = std::max(sync_stats.max_skew_ns, stats.skew_ns);
+        sync_stats = std::move(stats);
+    }
+
+    /**
+     * Record the slot count of the shared-memory ring feeding a cell, 0 when none
+     * does (any thread). Frames waiting in sync_queue keep their slots, and the
+     * display holds up to two more; the queue is kept short enough to leave the
+     * producer a slot to write, so a deep sync_queue_depth cannot stall the ring.
+     */
+    void setRingSlots(size_t index, int slot_count) {
+        if (!params.sync_timestamps) return;
+        std::shared_ptr<ViewportFrameState> state;
+        {
+            std::lock_guard<std::mutex> lock(layout_mutex);
+            if (index < layout.size()) state = layout[index].frame_state;
+        }
+        if (!state) return;
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->sync_ring_cap = slot_count > 0 ? std::max(1, slot_count - 3) : 0;
+    }
+
+    /**
+     * Ingest state of an image viewport, or null if the index or frame is invalid
+     * (any thread).
+     */
+    std::shared_ptr<ViewportFrameState> imageFrameState(size_t index, const FrameData& frame) {
+        if (!frame.data || frame.width <= 0 || frame.height <= 0) return nullptr;
+        const size_t row_bytes = static_cast<size_t>(frame.width) * bytesPerPixel(frame.format);
+        if (frame.row_stride != 0 && static_cast<size_t>(std::abs(frame.row_stride)) < row_bytes) return nullptr;
+        std::lock_guard<std::mutex> lock(layout_mutex);
+        if (index >= layout.size()) return nullptr;
+        if (!isImageViewport(layout[index].type)) return nullptr;
+        if (!acceptsFormat(layout[index].type, frame.format)) return nullptr;
+        return layout[index].frame_state;
+    }
+
+    bool open(const std::string& context_name) override {
+        window_name = context_name;
+        try {
+            ViewPortal::initOnDisplayThread(this);
+        } catch (...) {
+            quit_requested = true;
+            {
+                std::lock_guard<std::mutex> lock(init_mutex);
+                init_done = true;
+            }
+            init_cv.notify_one();
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(init_mutex);
+            init_done = true;
+        }
+        init_cv.notify_one();
+        return true;
+    }
+
+    bool step() override {
+        if (quit_requested) return false;
+        pangolin::BindToContext(window_name);
+        dirty.store(false, std::memory_order_release);
+        ViewPortal::stepFrame(this);
+        if (pangolin::ShouldQuit()) {
+            quit_requested = true;
+            return false;
+        }
+        return true;
+    }
+
+    void close() override {
+        pangolin::BindToContext(window_name);
+        quit_requested = true;
+        viewports.clear();
+        retired_viewports.clear();
+        gallery_native_viewport.reset();
+        gallery.reset();
+        double_click_handler.reset();
+        if (composite_pbo[0] != 0) glDeleteBuffers(2, composite_pbo);
+        pangolin::DestroyWindow(window_name);
+    }
+
+    std::string title() const override { return window_title_storage; }
+
+    bool isDirty() const override {
+        return dirty.load(std::memory_order_acquire) || animated.load(std::memory_order_relaxed);
+    }
+
+    void initLayout(const std::vector<ViewportType>& types) {
+        std::lock_guard<std::mutex> lock(layout_mutex);
+        layout.clear();
+        for (size_t i = 0; i < types.size(); ++i) {
+            const ViewportSpec spec = i < params.viewport_specs.size() ? params.viewport_specs[i] : ViewportSpec();
+            layout.push_back(makeLayoutEntry(types[i], spec));
+        }
+        ++layout_version;
+    }
+
+    /**
+     * Take a viewport of the given type from the retired pool (keeping its GL
+     * texture and view), or create a new one, prepared for spec. Display thread only.
+     */
+    std::unique_ptr<Viewport> acquireViewport(ViewportType type, const ViewportSpec& spec) {
+        auto it = retired_viewports.find(type);
+        if (it != retired_viewports.end() && !it->second.empty()) {
+            std::unique_ptr<Viewport> v = std::move(it->second.back());
+            it->second.pop_back();
+            v->getView().SetAspect(static_cast<double>(specAspect(spec)));
+            if (spec.width > 0 && spec.height > 0)
+                v->reserve(spec.width, spec.height, specFormat(type, spec));
+            return v;
+        }
+        std::string name;
+        if (!free_view_names.empty()) {
+            name = std::move(free_view_names.back());
+            free_view_names.pop_back();
+        } else {
+            name = viewNamePrefix() + "v" + std::to_string(next_view_id++);
+        }
+        std::unique_ptr<Viewport> v = createViewport(type, name, spec);
+        v->setupUI();
+        return v;
+    }
+
+    /**
+     * Window name plus a dot: view names, and with them the "ui.<name>.*" Vars
+     * in Pangolin's process-wide registry, differ between windows.
+     */
+    std::string viewNamePrefix() const {
+        std::string prefix = window_name;
+        std::replace(prefix.begin(), prefix.end(), '.', '_');  // dots nest Vars
+        return prefix + ".";
+    }
+
+    /**
+     * Park a viewport that left the layout, or destroy it when kMaxRetiredPerType
+     * of its type are parked already. Display thread only.
+     */
+    void retireViewport(ViewportType type, std::unique_ptr<Viewport> v) {
+        v->getView().Show(false);
+        // The cell's frame state may be freed: drop every pointer into it
+        v->setFrame(FrameData());
+        v->setOverlay(nullptr);
+        v->setMask(nullptr);
+        v->setCompareInputs(nullptr, nullptr);
+        v->setStats(nullptr);
+        std::vector<std::unique_ptr<Viewport>>& parked = retired_viewports[type];
+        if (parked.size() < kMaxRetiredPerType) {
+            parked.push_back(std::move(v));
+            return;
+        }
+        // Pangolin keeps the view and the UI Vars registered by name: the next
+        // new viewport takes the name over instead of adding more panel entries
+        v->getView().SetHandler(&pangolin::StaticHandler);
+        free_view_names.push_back(v->getName());
+    }
+
+    /**
+     * Reconcile the displayed viewports with the requested layout. Viewports whose
+     * frame state and type are unchanged are kept as-is; removed or retyped ones are
+     * parked so a later add of the same type reuses them. Display thread only.
+     */
+    void applyLayout() {
+        std::vector<LayoutEntry> requested;
+        {
+            std::lock_guard<std::mutex> lock(layout_mutex);
+            if (layout_version == applied_layout_version) return;
+            requested = layout;
+            applied_layout_version = layout_version;
+        }
+        if (gallery) {
+            applyGalleryLayout(requested);
+            return;
+        }
+        exitFullscreen();
+
+        std::vector<std::unique_ptr<Viewport>> next_viewports;
+        std::vector<ViewportType> next_types;
+        std::vector<ViewportSpec> next_specs;
+        std::vector<std::shared_ptr<ViewportFrameState>> next_states;
+        for (const LayoutEntry& e : requested) {
+            std::unique_ptr<Viewport> v;
+            for (size_t j = 0; j < viewports.size(); ++j) {
+                if (viewports[j] && frame_states[j] == e.frame_state) {
+                    if (viewport_types[j] == e.type)
+                        v = std::move(viewports[j]);
+                    else
+                        retireViewport(viewport_types[j], std::move(viewports[j]));
+                    break;
+                }
+            }
+            if (!v) {
+                v = acquireViewport(e.type, e.spec);
+                // Hand the current frame, overlay, mask and colormap to the new viewport.
+                e.frame_state->frame_seq_shown = kNeverShown;
+                e.frame_state->overlay_seq_shown = kNeverShown;
+                e.frame_state->mask_seq_shown = kNeverShown;
+                e.frame_state->colormap_seq_shown = kNeverShown;
+                e.frame_state->stats_seq_shown = kNeverShown;
+                e.frame_state->compare_seq_shown = kNeverShown;
+            }
+            next_viewports.push_back(std::move(v));
+            next_types.push_back(e.type);
+            next_specs.push_back(e.spec);
+            next_states.push_back(e.frame_state);
+        }
+        for (size_t j = 0; j < viewports.size(); ++j) {
+            if (viewports[j])
+                retireViewport(viewport_types[j], std::move(viewports[j]));
+        }
+        viewports = std::move(next_viewports);
+        viewport_types = std::move(next_types);
+        viewport_specs = std::move(next_specs);
+        frame_states = std::move(next_states);
+        animated = std::find(viewport_types.begin(), viewport_types.end(), ViewportType::Plot) != viewport_types.end();
+
+        pangolin::View& multi = pangolin::Display("multi");
+        multi.views.clear();
+        for (auto& v : viewports) {
+            v->getView().Show(true);
+            multi.AddDisplay(v->getView());
+        }
+        multi.ResizeChildren();
+    }
+
+    void applyGalleryLayout(const std::vector<LayoutEntry>& requested) {
+        exitGalleryNative();
+        viewport_types.clear();
+        viewport_specs.clear();
+        frame_states.clear();
+        for (const LayoutEntry& e : requested) {
+            viewport_types.push_back(e.type);
+            viewport_specs.push_back(e.spec);
+            frame_states.push_back(e.frame_state);
+            e.frame_state->frame_seq_shown = kNeverShown;  // refill the tile from the current frame
+        }
+        gallery->setTileCount(requested.size());
+        animated = false;
+    }
+
+    /**
+     * Hand the latest frame, overlay and mask of a cell to its image viewport.
+     */
+    void feedImageViewport(Viewport* v, ViewportFrameState& fs) {
+        FrameData fd;
+        DirtyRect dirty;
+        bool have_frame = false;
+        bool full = false;
+        std::shared_ptr<const void> previous;  // released outside the lock
+        PooledBuffer retired;                  // likewise
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            const int read_index = 1 - fs.write_index.load(std::memory_order_acquire);
+            const std::uint64_t seq = fs.frame_seq.load(std::memory_order_acquire);
+            if (seq != fs.frame_seq_shown && fs.hasPixels(read_index)) {
+                // A viewport that has not shown this state yet needs the whole frame
+                full = fs.pending_full || fs.frame_seq_shown == kNeverShown;
+                dirty = fs.pending_dirty;
+                fs.pending_full = false;
+                fs.pending_dirty = DirtyRect();
+                fs.frame_seq_shown = seq;
+                markDisplayed(fs, seq);
+                fd.width = fs.width[read_index];
+                fd.height = fs.height[read_index];
+                fd.format = fs.format[read_index];
+                fd.data = fs.topRow(read_index);
+                fd.row_stride = fs.stride[read_index];
+                previous = std::move(fs.display_hold);
+                fs.display_hold = fs.external[read_index];
+                fs.display_slot = read_index;
+                ++fs.pins[read_index];
+                fs.shown_slot = read_index;
+                retired = std::move(fs.retired);
+                have_frame = true;
+            }
+        }
+        if (have_frame) {
+            fs.delivery_cv.notify_all();
+            fs.slot_cv.notify_all();  // a retained slot was let go for this one
+
+            if (full || dirty.w <= 0 || dirty.h <= 0)
+                v->setFrame(fd);
+            else
+                v->setFrameRegion(fd, dirty.x, dirty.y, dirty.w, dirty.h);
+        }
+        std::shared_ptr<const Overlay> overlay;
+        std::shared_ptr<const MaskFrame> mask;
+        std::shared_ptr<const MaskPalette> mask_palette;
+        std::shared_ptr<const ColormapParams> colormap;
+        bool overlay_changed = false;
+        bool mask_changed = false;
+        bool colormap_changed = false;
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            if (fs.overlay_seq != fs.overlay_seq_shown) {
+                fs.overlay_seq_shown = fs.overlay_seq;
+                overlay = fs.overlay;
+                overlay_changed = true;
+            }
+            if (fs.mask_seq != fs.mask_seq_shown) {
+                fs.mask_seq_shown = fs.mask_seq;
+                mask = fs.mask;
+                mask_palette = fs.mask_palette;
+                mask_changed = true;
+            }
+            if (fs.colormap_seq != fs.colormap_seq_shown) {
+                fs.colormap_seq_shown = fs.colormap_seq;
+                colormap = fs.colormap;
+                colormap_changed = true;
+            }
+        }
+        if (colormap_changed)
+            v->setColormap(std::move(colormap));
+        if (overlay_changed)
+            v->setOverlay(std::move(overlay));
+        if (mask_changed) {
+            v->setMaskPalette(std::move(mask_palette));
+            v->setMask(std::move(mask));  // uploaded immediately; the reference is dropped here
+        }
+    }
+
+    /**
+     * Run prepare() of the cells about to be updated on the worker pool, the
+     * display thread helping, so colormapping and other CPU work of several
+     * viewports overlaps; update() is then left with the GL uploads. With a
+     * single cell or thread, update() prepares on the display thread.
+     */
+    void prepareViewports() {
+        int threads = params.prepare_threads;
+        if (threads <= 0) threads = std::min(kMaxPrepareThreads, static_cast<int>(std::thread::hardware_concurrency()));
+        if (threads < 2 || prepare_cells.size() < 2) return;
+        if (!prepare_pool) prepare_pool = std::make_unique<WorkerPool>(threads - 1, "vp-prepare");
+        prepare_tasks.clear();
+        for (Viewport* v : prepare_cells)
+            prepare_tasks.push_back([v]() { v->prepare(); });
+        prepare_pool->run(prepare_tasks);
+    }
+
+    /**
+     * Hand the latest statistics of a Histogram cell to its viewport.
+     */
+    void feedStats(Viewport* v, ViewportFrameState& fs) {
+        std::shared_ptr<const ImageStats> stats;
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            if (fs.stats_seq == fs.stats_seq_shown) return;
+            fs.stats_seq_shown = fs.stats_seq;
+            stats = fs.stats;
+        }
+        v->setStats(std::move(stats));
+    }
+
+    /**
+     * Hand a Compare cell its parameters and the viewports currently showing its
+     * two sources (display thread).
+     */
+    void feedCompare(Viewport* v, ViewportFrameState& fs) {
+        std::shared_ptr<ViewportFrameState> a, b;
+        std::shared_ptr<const CompareParams> params;
+        bool params_changed = false;
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            a = fs.compare_a.lock();
+            b = fs.compare_b.lock();
+            if (fs.compare_seq != fs.compare_seq_shown) {
+                fs.compare_seq_shown = fs.compare_seq;
+                params = fs.compare_params;
+                params_changed = true;
+            }
+        }
+        if (params_changed)
+            v->setCompareParams(std::move(params));
+        v->setCompareInputs(viewportFor(a.get()), viewportFor(b.get()));
+    }
+
+    /** Image viewport of the cell with the given state, or null (display thread). */
+    const Viewport* viewportFor(const ViewportFrameState* state) const {
+        if (!state) return nullptr;
+        for (size_t i = 0; i < frame_states.size() && i < viewports.size(); ++i) {
+            if (frame_states[i].get() == state)
+                return isImageViewport(viewport_types[i]) ? viewports[i].get() : nullptr;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Copy every row_step-th row of the newest frame of a cell for the stats
+     * worker, if it is newer than last_frame (stats worker thread).
+     */
+    static bool sampleFrame(ViewportFrameState& fs, size_t max_samples, bool depth, std::uint64_t last_frame,
+                            StatsSample& sample) {
+        // Pin the newest frame and copy it without the lock, as streamSnapshot does
+        int ri = 0;
+        int w = 0;
+        int h = 0;
+        ImageFormat format = ImageFormat::RGB8;
+        std::uint64_t seq = 0;
+        const std::uint8_t* top = nullptr;
+        std::ptrdiff_t step = 0;
+        std::shared_ptr<const void> owner;
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            seq = fs.frame_seq.load(std::memory_order_acquire);
+            ri = 1 - fs.write_index.load(std::memory_order_acquire);
+            if (seq == last_frame || !fs.hasPixels(ri)) return false;
+            w = fs.width[ri];
+            h = fs.height[ri];
+            format = fs.format[ri];
+            top = fs.topRow(ri);
+            step = fs.rowStep(ri);
+            owner = fs.external[ri];
+            ++fs.pins[ri];
+        }
+        const size_t pixels = static_cast<size_t>(w) * h;
+        // Whole rows keep the copy and the SIMD pass contiguous
+        const int row_step = max_samples > 0 && pixels > max_samples
+                                 ? static_cast<int>((pixels + max_samples - 1) / max_samples) : 1;
+        const int bpp = bytesPerPixel(format);
+        const bool is_float = isFloatFormat(format);
+        // Samples are stored as floats for float frames, as bytes otherwise
+        const size_t row_bytes = static_cast<size_t>(w) * (is_float ? sizeof(float) : static_cast<size_t>(bpp));
+        const int rows = (h + row_step - 1) / row_step;
+        sample.channels = is_float ? 1 : bpp;
+        sample.ignore_zero = depth && !is_float;
+        sample.is_float = is_float;
+        sample.frame = seq;
+        sample.count = static_cast<size_t>(rows) * w;
+        sample.data.resize(static_cast<size_t>(rows) * row_bytes);
+        for (int r = 0; r < rows; ++r) {
+            const std::uint8_t* src = top + static_cast<std::ptrdiff_t>(r) * row_step * step;
+            std::uint8_t* dst = sample.data.data() + r * row_bytes;
+            if (format == ImageFormat::Float16) {
+                auto* out = reinterpret_cast<float*>(dst);
+                for (int x = 0; x < w; ++x) {
+                    std::uint16_t half;
+                    std::memcpy(&half, src + 2 * x, sizeof(half));
+                    out[x] = halfToFloat(half);
+                }
+            } else {
+                std::memcpy(dst, src, row_bytes);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            --fs.pins[ri];
+        }
+        fs.slot_cv.notify_all();
+        return true;
+    }
+
+    /**
+     * Store a result for a Histogram cell; false once the cell is gone or no
+     * longer a Histogram (stats worker thread).
+     */
+    bool publishStats(const std::weak_ptr<ViewportFrameState>& target, std::shared_ptr<const ImageStats> stats) {
+        std::shared_ptr<ViewportFrameState> fs = target.lock();
+        if (!fs) return false;
+        {
+            std::lock_guard<std::mutex> lock(layout_mutex);
+            auto it = std::find_if(layout.begin(), layout.end(),
+                                   [&](const LayoutEntry& e) { return e.frame_state == fs; });
+            if (it == layout.end() || it->type != ViewportType::Histogram) return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(fs->mutex);
+            fs->stats = std::move(stats);
+            ++fs->stats_seq;
+        }
+        markDirty();
+        return true;
+    }
+
+    /**
+     * Once a frame is uploaded, let go of its slot so that producers may write it
+     * again, and hand an externally owned frame back to its owner unless the
+     * viewport still reads its pixels (it is then kept until the next frame). The
+     * release runs here on the display thread, outside the lock.
+     */
+    void releaseShownFrame(ViewportFrameState& fs, bool retained) {
+        std::shared_ptr<const void> hold;  // released outside the lock
+        {
+            std::lock_guard<std::mutex> lock(fs.mutex);
+            const int k = fs.display_slot;
+            if (k < 0) return;
+            fs.display_slot = -1;
+            --fs.pins[k];
+            if (!retained && fs.display_hold) {
+                // Same owner, not just the same address: a recycled buffer may have
+                // come back as a newer frame with an owner of its own
+                const std::shared_ptr<const void>& ext = fs.external[k];
+                if (ext && !ext.owner_before(fs.display_hold) && !fs.display_hold.owner_before(ext)) {
+                    fs.external[k].reset();
+                    fs.released[k] = true;
+                }
+                hold = std::move(fs.display_hold);
+            }
+        }
+        fs.slot_cv.notify_all();
+    }
+
+    /**
+     * Show one gallery cell at native resolution in a regular viewport of its type.
+     */
+    void enterGalleryNative(int index) {
+        if (index < 0 || static_cast<size_t>(index) >= viewport_types.size()) return;
+        if (!isImageViewport(viewport_types[index])) return;
+        exitGalleryNative();
+        gallery_native = index;
+        gallery_native_type = viewport_types[index];
+        gallery_native_viewport = acquireViewport(gallery_native_type, viewport_specs[index]);
+        ViewportFrameState& fs = *frame_states[index];
+        fs.frame_seq_shown = kNeverShown;
+        fs.overlay_seq_shown = kNeverShown;
+        fs.mask_seq_shown = kNeverShown;
+        fs.colormap_seq_shown = kNeverShown;
+        pangolin::View& v = gallery_native_viewport->getView();
+        v.SetAspect(-std::abs(v.aspect));
+        v.Show(true);
+        gallery->getView().Show(false);
+        pangolin::View& multi = pangolin::Display("multi");
+        multi.views.clear();
+        multi.AddDisplay(v);
+        multi.ResizeChildren();
+    }
+
+    void exitGalleryNative() {
+        if (gallery_native < 0) return;
+        if (static_cast<size_t>(gallery_native) < frame_states.size())
+            frame_states[gallery_native]->frame_seq_shown = kNeverShown;
+        retireViewport(gallery_native_type, std::move(gallery_native_viewport));
+        gallery_native = -1;
+        pangolin::View& multi = pangolin::Display("multi");
+        multi.views.clear();
+        gallery->getView().Show(true);
+        multi.AddDisplay(gallery->getView());
+        multi.ResizeChildren();
+    }
+
+    /**
+     * Gallery frame: upload only tiles whose cell received a new frame, then draw
+     * the grid; or render the cell selected for native-resolution display.
+     */
+    void stepGallery() {
+        if (gallery_native >= 0) {
+            Viewport* v = gallery_native_viewport.get();
+            feedImageViewport(v, *frame_states[gallery_native]);
+            v->update();
+            releaseShownFrame(*frame_states[gallery_native], v->retainsFrame());
+            v->render();
+            return;
+        }
+        for (size_t i = 0; i < frame_states.size(); ++i) {
+            if (!isImageViewport(viewport_types[i])) continue;
+            ViewportFrameState& fs = *frame_states[i];
+            FrameData fd;
+            {
+                std::lock_guard<std::mutex> lock(fs.mutex);
+                const std::uint64_t seq = fs.frame_seq.load(std::memory_order_acquire);
+                if (seq == fs.frame_seq_shown) continue;
+                fs.frame_seq_shown = seq;
+                const int read_index = 1 - fs.write_index.load(std::memory_order_acquire);
+                if (!fs.hasPixels(read_index)) continue;
+                markDisplayed(fs, seq);
+                fd.width = fs.width[read_index];
+                fd.height = fs.height[read_index];
+                fd.format = fs.format[read_index];
+                fd.data = fs.topRow(read_index);
+                fd.row_stride = fs.stride[read_index];
+                fs.display_hold = fs.external[read_index];
+                fs.display_slot = read_index;
+                ++fs.pins[read_index];
+            }
+            fs.delivery_cv.notify_all();
+            gallery->setTileFrame(i, fd, viewport_types[i] == ViewportType::ColoredDepth);
+            releaseShownFrame(fs, false);
+        }
+        gallery->render();
+    }
 };
 
 void ViewPortal::initOnDisplayThread(Impl* impl) {
     const ViewPortalParams& params = impl->params;
-    impl->window_name = params.window_title;
-    const int rows = impl->init_rows;
-    const int cols = impl->init_cols;
-    const std::vector<ViewportType>& types = impl->viewport_types;
-    const size_t n = static_cast<size_t>(rows * cols);
 
-    pangolin::CreateWindowAndBind(params.window_title, params.window_width, params.window_height);
+    if (params.headless) {
+        pangolin::CreateWindowAndBind(impl->window_name, params.window_width, params.window_height,
+                                      pangolin::Params({{"scheme", "headless"}}));
+    } else {
+        pangolin::CreateWindowAndBind(impl->window_name, params.window_width, params.window_height);
+    }
 
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
@@ -205,22 +1663,14 @@ void ViewPortal::initOnDisplayThread(Impl* impl) {
         .SetBounds(0.0, 1.0, pangolin::Attach::Pix(params.panel_width), 1.0)
         .SetLayout(pangolin::LayoutEqual);
 
-    const float aspect = kDefaultAspect;
-    for (size_t i = 0; i < n; ++i) {
-        std::string name = "v" + std::to_string(i);
-        impl->viewports.push_back(createViewport(types[i], name, aspect));
-    }
-
-    for (auto& v : impl->viewports) {
-        pangolin::Display("multi").AddDisplay(v->getView());
-    }
-
     pangolin::CreatePanel("ui")
         .SetBounds(0.0, 1.0, 0.0, pangolin::Attach::Pix(params.panel_width));
 
-    for (auto& v : impl->viewports) {
-        v->setupUI();
+    if (params.gallery_mode) {
+        impl->gallery = std::make_unique<GalleryViewport>("gallery", params.gallery_tile_width, params.gallery_tile_height);
+        pangolin::Display("multi").AddDisplay(impl->gallery->getView());
     }
+    impl->applyLayout();
 
     pangolin::RegisterKeyPressCallback('`', []() {
         pangolin::ShowConsole(pangolin::TrueFalseToggle::Toggle);
@@ -230,7 +1680,14 @@ void ViewPortal::initOnDisplayThread(Impl* impl) {
     });
 
     impl->double_click_handler = std::make_unique<DoubleClickFullscreenHandler>();
-    impl->double_click_handler->on_double_click = [impl](int view_id) {
+    impl->double_click_handler->on_double_click = [impl](int view_id, int x, int y) {
+        if (impl->gallery) {
+            if (impl->gallery_native >= 0)
+                impl->exitGalleryNative();
+            else
+                impl->enterGalleryNative(impl->gallery->tileAt(x, y));
+            return;
+        }
         if (impl->fullscreen_view == view_id) {
             impl->exitFullscreen();
         } else {
@@ -241,6 +1698,9 @@ void ViewPortal::initOnDisplayThread(Impl* impl) {
         std::lock_guard<std::mutex> lock(impl->key_mutex);
         impl->pending_keys.insert(key);
     };
+    impl->double_click_handler->on_input = [impl](InputEvent& e, float x, float y) {
+        impl->pushInputEvent(e, x, y);
+    };
     pangolin::Display("multi").SetHandler(impl->double_click_handler.get());
 
     pangolin::RegisterKeyPressCallback('p', [impl]() {
@@ -260,62 +1720,86 @@ void ViewPortal::stepFrame(Impl* impl) {
                 if (impl->keys_registered.count(key) == 0) {
                     impl->keys_registered.insert(key);
                     pangolin::RegisterKeyPressCallback(key, [impl, key]() {
-                        std::lock_guard<std::mutex> lk(impl->key_mutex);
-                        impl->pending_keys.insert(key);
+                        {
+                            std::lock_guard<std::mutex> lk(impl->key_mutex);
+                            impl->pending_keys.insert(key);
+                        }
+                        // Registered keys bypass the view handlers; no pointer position
+                        InputEvent e;
+                        e.key = key;
+                        impl->pushInputEvent(e, -1.0f, -1.0f);
                     });
                 }
             }
         }
     }
+    impl->applyLayout();
+    impl->publishVisibility();
+    impl->advanceQueues();
+    impl->presentSynced();
+    impl->consumeUndrawn();
+    impl->display_steps.fetch_add(1, std::memory_order_relaxed);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (impl->gallery) {
+        impl->stepGallery();
+        impl->streamComposite();
+        pangolin::FinishFrame();
+        return;
+    }
     const size_t n = impl->viewports.size();
-    for (size_t i = 0; i < n; ++i) {
+    // Take the new frames first, so the image cells can be prepared together
+    impl->prepare_cells.clear();
+    for (size_t i = 0; i < n && i < impl->frame_states.size(); ++i) {
+        // Hidden cells are only refreshed for the Compare cells reading them
+        if (i >= impl->refreshed.size() || !impl->refreshed[i]) continue;
         Viewport* v = impl->viewports[i].get();
-        if (!v->isShown() || !v->getView().IsShown())
-            continue;
-        if (i < impl->frame_states.size() && isImageViewport(impl->viewport_types[i])) {
-            ViewportFrameState& fs = *impl->frame_states[i];
-            const int read_index = 1 - fs.write_index.load(std::memory_order_acquire);
-            if (fs.width[read_index] > 0 && fs.height[read_index] > 0 &&
-                fs.buffers[read_index].size() > 0) {
-                FrameData fd;
-                fd.width = fs.width[read_index];
-                fd.height = fs.height[read_index];
-                fd.format = fs.format[read_index];
-                fd.data = fs.buffers[read_index].data();
-                fd.row_stride = 0;
-                v->setFrame(fd);
-            }
+        if (isImageViewport(impl->viewport_types[i])) {
+            impl->feedImageViewport(v, *impl->frame_states[i]);
+            impl->prepare_cells.push_back(v);
+        } else if (impl->viewport_types[i] == ViewportType::Histogram) {
+            impl->feedStats(v, *impl->frame_states[i]);
+        }
+    }
+    impl->prepareViewports();
+    // Compare cells read the textures of other cells: draw them after those are updated
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < n; ++i) {
+            Viewport* v = impl->viewports[i].get();
+            const bool compare = i < impl->viewport_types.size() && impl->viewport_types[i] == ViewportType::Compare;
+            if (compare != (pass == 1) || i >= impl->refreshed.size() || !impl->refreshed[i])
+                continue;
+            if (compare && i < impl->frame_states.size())
+                impl->feedCompare(v, *impl->frame_states[i]);
+            v->update();
+            if (i < impl->frame_states.size() && isImageViewport(impl->viewport_types[i]))
+                impl->releaseShownFrame(*impl->frame_states[i], v->retainsFrame());
+            if (v->isShown() && v->getView().IsShown())
+                v->render();
         }
-        v->update();
-        v->render();
     }
+    impl->streamComposite();
     pangolin::FinishFrame();
 }
 
-void ViewPortal::displayThreadMain(Impl* impl) {
-    try {
-        initOnDisplayThread(impl);
-    } catch (...) {
-        impl->init_done = true;
-        impl->init_cv.notify_one();
-        impl->quit_requested = true;
-        return;
+void ViewPortal::startDisplay(DisplayManager* manager) {
+    if (impl_->params.frame_memory_budget_mb > 0)
+        setFrameMemoryBudget(static_cast<size_t>(impl_->params.frame_memory_budget_mb) * 1024 * 1024);
+    if (!manager) {
+        impl_->owned_manager = std::make_unique<DisplayManager>();
+        manager = impl_->owned_manager.get();
     }
+    impl_->manager = manager;
+    manager->impl_->attach(impl_);
     {
-        std::lock_guard<std::mutex> lock(impl->init_mutex);
-        impl->init_done = true;
+        std::unique_lock<std::mutex> lock(impl_->init_mutex);
+        impl_->init_cv.wait(lock, [this]() { return impl_->init_done.load(); });
     }
-    impl->init_cv.notify_one();
-
-    while (!impl->quit_requested && !pangolin::ShouldQuit()) {
-        stepFrame(impl);
+    if (impl_->quit_requested) {
+        manager->impl_->detach(impl_);
+        delete impl_;
+        impl_ = nullptr;
+        throw std::runtime_error("ViewPortal: display thread failed to initialize");
     }
-    impl->quit_requested = true;
-
-    impl->viewports.clear();
-    impl->double_click_handler.reset();
-    pangolin::DestroyWindow(impl->window_name);
 }
 
 ViewPortal::ViewPortal(int rows, int cols, const std::vector<ViewportType>& types, const char* window_title)
@@ -333,22 +1817,8 @@ ViewPortal::ViewPortal(int rows, int cols, const std::vector<ViewportType>& type
     }
     impl_->init_rows = rows;
     impl_->init_cols = cols;
-    impl_->viewport_types = types;
-    impl_->frame_states.resize(n);
-    for (size_t i = 0; i < n; ++i)
-        impl_->frame_states[i] = std::make_unique<ViewportFrameState>();
-    impl_->display_thread = std::thread(&ViewPortal::displayThreadMain, impl_);
-    {
-        std::unique_lock<std::mutex> lock(impl_->init_mutex);
-        impl_->init_cv.wait(lock, [this]() { return impl_->init_done.load(); });
-    }
-    if (impl_->quit_requested) {
-        if (impl_->display_thread.joinable())
-            impl_->display_thread.join();
-        delete impl_;
-        impl_ = nullptr;
-        throw std::runtime_error("ViewPortal: display thread failed to initialize");
-    }
+    impl_->initLayout(types);
+    startDisplay(nullptr);
 }
 
 ViewPortal::ViewPortal(int rows, int cols, const std::vector<ViewportType>& types,
@@ -356,6 +1826,8 @@ ViewPortal::ViewPortal(int rows, int cols, const std::vector<ViewportType>& type
     : impl_(new Impl)
 {
     impl_->params = params;
+    impl_->window_title_storage = params.window_title ? params.window_title : "";
+    impl_->params.window_title = impl_->window_title_storage.c_str();
     const size_t n = static_cast<size_t>(rows * cols);
     if (types.size() != n) {
         delete impl_;
@@ -364,61 +1836,345 @@ ViewPortal::ViewPortal(int rows, int cols, const std::vector<ViewportType>& type
     }
     impl_->init_rows = rows;
     impl_->init_cols = cols;
-    impl_->viewport_types = types;
-    impl_->frame_states.resize(n);
-    for (size_t i = 0; i < n; ++i)
-        impl_->frame_states[i] = std::make_unique<ViewportFrameState>();
-    impl_->display_thread = std::thread(&ViewPortal::displayThreadMain, impl_);
-    {
-        std::unique_lock<std::mutex> lock(impl_->init_mutex);
-        impl_->init_cv.wait(lock, [this]() { return impl_->init_done.load(); });
-    }
-    if (impl_->quit_requested) {
-        if (impl_->display_thread.joinable())
-            impl_->display_thread.join();
+    impl_->initLayout(types);
+    startDisplay(nullptr);
+}
+
+ViewPortal::ViewPortal(DisplayManager& manager, int rows, int cols, const std::vector<ViewportType>& types,
+                       const ViewPortalParams& params)
+    : impl_(new Impl)
+{
+    impl_->params = params;
+    impl_->window_title_storage = params.window_title ? params.window_title : "";
+    impl_->params.window_title = impl_->window_title_storage.c_str();
+    const size_t n = static_cast<size_t>(rows * cols);
+    if (types.size() != n) {
         delete impl_;
         impl_ = nullptr;
-        throw std::runtime_error("ViewPortal: display thread failed to initialize");
+        throw std::invalid_argument("ViewPortal: types.size() must equal rows * cols");
     }
+    impl_->init_rows = rows;
+    impl_->init_cols = cols;
+    impl_->initLayout(types);
+    startDisplay(&manager);
 }
 
 ViewPortal::~ViewPortal() {
+    stopStreaming();  // the server reads frames from impl_
     if (impl_) {
+        std::unique_ptr<ShmConsumer> consumer;
+        {
+            std::lock_guard<std::mutex> lock(impl_->shm_mutex);
+            consumer = std::move(impl_->shm_consumer);
+        }
+        consumer.reset();  // joins the thread that feeds updateFrame()
+        std::unique_ptr<StatsWorker> stats_worker;
+        {
+            std::lock_guard<std::mutex> lock(impl_->stats_mutex);
+            stats_worker = std::move(impl_->stats_worker);
+        }
+        stats_worker.reset();  // its bindings call back into impl_
         impl_->quit_requested = true;
-        if (impl_->display_thread.joinable())
-            impl_->display_thread.join();
+        impl_->manager->impl_->detach(impl_);
     }
     delete impl_;
     impl_ = nullptr;
 }
 
-void ViewPortal::updateFrame(size_t viewportIndex, const FrameData& frame) {
-    if (!impl_ || viewportIndex >= impl_->frame_states.size()) return;
-    if (!isImageViewport(impl_->viewport_types[viewportIndex])) return;
-    if (!frame.data || frame.width <= 0 || frame.height <= 0) return;
-
-    ViewportFrameState& fs = *impl_->frame_states[viewportIndex];
-    const size_t byte_size = frameByteSize(frame);
-    if (byte_size == 0) return;
+FrameStatus ViewPortal::updateFrame(size_t viewportIndex, const FrameData& frame) {
+    std::shared_ptr<ViewportFrameState> state = impl_ ? impl_->imageFrameState(viewportIndex, frame) : nullptr;
+    if (!state) return FrameStatus::Dropped;
 
-    std::lock_guard<std::mutex> lock(fs.mutex);
-    const int w = fs.write_index.load(std::memory_order_relaxed);
-    if (fs.buffers[w].size() < byte_size)
-        fs.buffers[w].resize(byte_size);
+    ViewportFrameState& fs = *state;
+    if (Impl::dropUnwanted(fs)) return FrameStatus::Dropped;
+    FrameStatus status = FrameStatus::Accepted;
+    if (impl_->enqueueSynced(fs, frame, nullptr, status)) return status;
+    if (impl_->enqueueDelivery(fs, frame, nullptr, status)) return status;
     const int bpp = bytesPerPixel(frame.format);
     const size_t row_bytes = static_cast<size_t>(frame.width) * bpp;
-    if (frame.row_stride != 0) {
-        const int stride = frame.row_stride;
-        const std::uint8_t* src = static_cast<const std::uint8_t*>(frame.data);
-        for (int y = 0; y < frame.height; ++y)
-            std::memcpy(fs.buffers[w].data() + static_cast<size_t>(y) * row_bytes, src + static_cast<size_t>(y) * stride, row_bytes);
+    const size_t byte_size = frameByteSize(frame);
+
+    std::shared_ptr<const void> replaced;  // released after the lock is dropped
+    std::unique_lock<std::mutex> lock(fs.mutex);
+    const int w = copySlot(fs, lock);
+    resizeSlot(fs, w, byte_size);  // keeps the block unless the size class changed
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(frame.data);
+    int row_length = 0, alignment = 0;
+    if (frame.row_stride == 0 || frame.row_stride == static_cast<int>(row_bytes)) {
+        std::memcpy(fs.buffers[w].data(), src, byte_size);
+        fs.stride[w] = 0;
+    } else if (unpackForStride(frame.row_stride, bpp, row_length, alignment)) {
+        // Keep the stride: one bulk copy from the lowest address, uploaded in place later
+        const std::ptrdiff_t lowest = frame.row_stride < 0 ? static_cast<std::ptrdiff_t>(frame.height - 1) * frame.row_stride : 0;
+        std::memcpy(fs.buffers[w].data(), src + lowest, byte_size);
+        fs.stride[w] = frame.row_stride;
     } else {
-        std::memcpy(fs.buffers[w].data(), frame.data, byte_size);
+        // Padding GL cannot step over: repack rows
+        for (int y = 0; y < frame.height; ++y)
+            std::memcpy(fs.buffers[w].data() + static_cast<size_t>(y) * row_bytes,
+                        src + static_cast<std::ptrdiff_t>(y) * frame.row_stride, row_bytes);
+        fs.stride[w] = 0;
     }
-    fs.width[w] = frame.width;
-    fs.height[w] = frame.height;
-    fs.format[w] = frame.format;
-    fs.write_index.store(1 - w, std::memory_order_release);
+    replaced = std::move(fs.external[w]);
+    if (fs.frame_seq.load(std::memory_order_relaxed) != fs.displayed_seq) status = FrameStatus::Replaced;
+    publishFrame(fs, w, frame);
+    impl_->markDirty();
+    return status;
+}
+
+FrameStatus ViewPortal::updateFrame(size_t viewportIndex, const FrameData& frame, std::shared_ptr<const void> owner) {
+    std::shared_ptr<ViewportFrameState> state = impl_ ? impl_->imageFrameState(viewportIndex, frame) : nullptr;
+    if (!state) return FrameStatus::Dropped;
+    int row_length = 0, alignment = 0;
+    if (!owner || (frame.row_stride != 0 && !unpackForStride(frame.row_stride, bytesPerPixel(frame.format), row_length, alignment))) {
+        // No owner to keep the pixels alive, or a stride GL cannot upload in place
+        return updateFrame(viewportIndex, frame);
+    }
+
+    // Published even for a hidden cell: only the reference is kept, nothing is copied
+    ViewportFrameState& fs = *state;
+    FrameStatus status = FrameStatus::Accepted;
+    if (impl_->enqueueSynced(fs, frame, owner, status)) return status;
+    if (impl_->enqueueDelivery(fs, frame, owner, status)) return status;
+    std::shared_ptr<const void> replaced;  // released after the lock is dropped
+    std::lock_guard<std::mutex> lock(fs.mutex);
+    if (fs.frame_seq.load(std::memory_order_relaxed) != fs.displayed_seq) status = FrameStatus::Replaced;
+    publishExternalFrame(fs, frame, std::move(owner), replaced);
+    impl_->markDirty();
+    return status;
+}
+
+FrameStatus ViewPortal::updateFrame(size_t viewportIndex, const FrameData& frame, std::function<void()> release) {
+    std::shared_ptr<const void> owner;
+    if (release) {
+        owner = std::shared_ptr<const void>(frame.data, [release = std::move(release)](const void*) { release(); });
+    }
+    return updateFrame(viewportIndex, frame, std::move(owner));
+}
+
+void ViewPortal::setDeliveryPolicy(size_t viewportIndex, const DeliveryParams& delivery) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        if (!isImageViewport(impl_->layout[viewportIndex].type)) return;
+        state = impl_->layout[viewportIndex].frame_state;
+    }
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->delivery = delivery;
+    }
+    // Blocked producers re-check against the new depth; frames already queued still drain
+    state->delivery_cv.notify_all();
+}
+
+bool ViewPortal::waitUntilDisplayed(size_t viewportIndex, int timeout_ms) {
+    if (!impl_) return false;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return false;
+        if (!isImageViewport(impl_->layout[viewportIndex].type)) return false;
+        state = impl_->layout[viewportIndex].frame_state;
+    }
+    ViewportFrameState& fs = *state;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(0, timeout_ms));
+    std::unique_lock<std::mutex> lock(fs.mutex);
+    while (!fs.delivery_queue.empty() || !fs.sync_queue.empty() ||
+           fs.frame_seq.load(std::memory_order_relaxed) != fs.displayed_seq) {
+        if (impl_->quit_requested.load(std::memory_order_acquire) || !fs.wanted.load(std::memory_order_relaxed))
+            return false;
+        if (timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline) return false;
+        fs.delivery_cv.wait_for(lock, kDeliveryPoll);
+    }
+    return true;
+}
+
+void ViewPortal::displayStats(DisplayStats& stats, bool reset_latency) const {
+    stats = DisplayStats();
+    if (!impl_) return;
+    std::vector<std::shared_ptr<ViewportFrameState>> states;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        for (const LayoutEntry& e : impl_->layout)
+            states.push_back(isImageViewport(e.type) ? e.frame_state : nullptr);
+    }
+    stats.steps = impl_->display_steps.load(std::memory_order_relaxed);
+    stats.viewports.resize(states.size());
+    LatencyHistogram all;
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (!states[i]) continue;
+        ViewportFrameState& fs = *states[i];
+        ViewportStats& vs = stats.viewports[i];
+        vs.dropped = fs.hidden_frames.load(std::memory_order_relaxed) + fs.dropped_frames.load(std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(fs.mutex);
+        vs.published = fs.published_frames;
+        vs.displayed = fs.displayed_frames;
+        vs.replaced = fs.replaced_frames;
+        vs.latency = fs.latency.stats();
+        all.merge(fs.latency);
+        if (reset_latency) fs.latency.reset();
+    }
+    stats.latency = all.stats();
+}
+
+bool ViewPortal::syncStats(SyncStats& stats) const {
+    if (!impl_ || !impl_->params.sync_timestamps) return false;
+    std::lock_guard<std::mutex> lock(impl_->sync_mutex);
+    stats = impl_->sync_stats;
+    return true;
+}
+
+bool ViewPortal::startStreaming(const StreamServerParams& params, std::string* error) {
+    if (!impl_) return false;
+#ifdef VIEWPORTAL_WITH_STREAMING
+    stopStreaming();
+    auto server = std::make_shared<StreamServer>(*impl_, params);
+    std::string message;
+    if (!server->start(message)) {
+        if (error) *error = message;
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(impl_->stream_mutex);
+    impl_->stream_server = std::move(server);
+    return true;
+#else
+    (void)params;
+    if (error) *error = "streaming is not available on this platform";
+    return false;
+#endif
+}
+
+void ViewPortal::stopStreaming() {
+    if (!impl_) return;
+    std::shared_ptr<StreamServer> server;
+    {
+        std::lock_guard<std::mutex> lock(impl_->stream_mutex);
+        server = std::move(impl_->stream_server);
+    }
+#ifdef VIEWPORTAL_WITH_STREAMING
+    if (server)
+        server->stop();  // joins its threads; the display thread may still hold a reference briefly
+#endif
+}
+
+bool ViewPortal::attachSharedMemory(size_t viewportIndex, const std::string& ringName) {
+    if (!impl_) return false;
+#ifdef VIEWPORTAL_WITH_SHM
+    std::lock_guard<std::mutex> lock(impl_->shm_mutex);
+    if (!impl_->shm_consumer) {
+        impl_->shm_consumer.reset(new ShmConsumer(
+            [this](size_t index, const FrameData& frame, std::shared_ptr<const void> lease, int slot_count) {
+                impl_->setRingSlots(index, slot_count);
+                updateFrame(index, frame, std::move(lease));
+            }));
+    }
+    impl_->shm_consumer->attach(viewportIndex, ringName);
+    return true;
+#else
+    (void)viewportIndex;
+    (void)ringName;
+    return false;
+#endif
+}
+
+void ViewPortal::detachSharedMemory(size_t viewportIndex) {
+    if (!impl_) return;
+#ifdef VIEWPORTAL_WITH_SHM
+    std::lock_guard<std::mutex> lock(impl_->shm_mutex);
+    if (impl_->shm_consumer)
+        impl_->shm_consumer->detach(viewportIndex);
+    impl_->setRingSlots(viewportIndex, 0);
+#else
+    (void)viewportIndex;
+#endif
+}
+
+void ViewPortal::setHistogramSource(size_t histogramIndex, size_t sourceIndex, size_t max_samples) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> target, source;
+    bool depth = false;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (histogramIndex >= impl_->layout.size() || sourceIndex >= impl_->layout.size()) return;
+        if (impl_->layout[histogramIndex].type != ViewportType::Histogram) return;
+        if (!isImageViewport(impl_->layout[sourceIndex].type) || impl_->layout[sourceIndex].type == ViewportType::Flow) return;
+        target = impl_->layout[histogramIndex].frame_state;
+        source = impl_->layout[sourceIndex].frame_state;
+        depth = impl_->layout[sourceIndex].type == ViewportType::ColoredDepth;
+    }
+    {
+        std::lock_guard<std::mutex> lock(target->mutex);
+        target->stats_source = source;
+    }
+    StatsWorker::Binding binding;
+    binding.key = target.get();
+    binding.sample = [source, max_samples, depth](std::uint64_t last_frame, StatsSample& sample) {
+        return Impl::sampleFrame(*source, max_samples, depth, last_frame, sample);
+    };
+    Impl* impl = impl_;
+    std::weak_ptr<ViewportFrameState> weak_target = target;
+    binding.publish = [impl, weak_target](std::shared_ptr<const ImageStats> stats) {
+        return impl->publishStats(weak_target, std::move(stats));
+    };
+    std::lock_guard<std::mutex> lock(impl_->stats_mutex);
+    if (!impl_->stats_worker)
+        impl_->stats_worker.reset(new StatsWorker());
+    impl_->stats_worker->bind(std::move(binding));
+}
+
+bool ViewPortal::histogramStats(size_t histogramIndex, ImageStats& stats) const {
+    if (!impl_) return false;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (histogramIndex >= impl_->layout.size() || impl_->layout[histogramIndex].type != ViewportType::Histogram)
+            return false;
+        state = impl_->layout[histogramIndex].frame_state;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (!state->stats) return false;
+    stats = *state->stats;
+    return true;
+}
+
+void ViewPortal::setCompareSources(size_t compareIndex, size_t sourceA, size_t sourceB) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> target, a, b;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        const size_t n = impl_->layout.size();
+        if (compareIndex >= n || sourceA >= n || sourceB >= n) return;
+        if (impl_->layout[compareIndex].type != ViewportType::Compare) return;
+        if (!isImageViewport(impl_->layout[sourceA].type) || !isImageViewport(impl_->layout[sourceB].type)) return;
+        target = impl_->layout[compareIndex].frame_state;
+        a = impl_->layout[sourceA].frame_state;
+        b = impl_->layout[sourceB].frame_state;
+    }
+    {
+        std::lock_guard<std::mutex> lock(target->mutex);
+        target->compare_a = a;
+        target->compare_b = b;
+    }
+    impl_->markDirty();
+}
+
+void ViewPortal::setCompareParams(size_t compareIndex, const CompareParams& params) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (compareIndex >= impl_->layout.size() || impl_->layout[compareIndex].type != ViewportType::Compare) return;
+        state = impl_->layout[compareIndex].frame_state;
+    }
+    auto shared = std::make_shared<const CompareParams>(params);
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->compare_params = std::move(shared);
+        ++state->compare_seq;
+    }
+    impl_->markDirty();
 }
 
 bool ViewPortal::shouldQuit() const {
@@ -436,11 +2192,280 @@ bool ViewPortal::checkKey(int key) const {
     return false;
 }
 
+bool ViewPortal::pollEvent(InputEvent& event) {
+    if (!impl_) return false;
+    impl_->input_events_enabled.store(true, std::memory_order_relaxed);
+    return impl_->input_events.pop(event);
+}
+
+std::uint64_t ViewPortal::droppedInputEvents() const {
+    return impl_ ? impl_->input_events_dropped.load(std::memory_order_relaxed) : 0;
+}
+
 void ViewPortal::setKeysToWatch(const std::vector<int>& keys) {
     if (!impl_) return;
     std::lock_guard<std::mutex> lock(impl_->key_mutex);
     impl_->keys_to_watch = keys;
     impl_->keys_to_watch_pending = true;
+    impl_->markDirty();
+}
+
+size_t ViewPortal::addViewport(ViewportType type, const ViewportSpec& spec) {
+    if (!impl_) return 0;
+    if (type == ViewportType::Count)
+        throw std::invalid_argument("ViewPortal: invalid viewport type");
+    size_t index = 0;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        impl_->layout.push_back(makeLayoutEntry(type, spec));
+        ++impl_->layout_version;
+        index = impl_->layout.size() - 1;
+    }
+    impl_->markDirty();
+    return index;
+}
+
+void ViewPortal::removeViewport(size_t viewportIndex) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> state;
+    std::vector<std::shared_ptr<const void>> released;  // dropped after the locks
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        state = impl_->layout[viewportIndex].frame_state;
+        {
+            // The display keeps the state until it applies the layout: let go of leases now
+            std::lock_guard<std::mutex> fs_lock(state->mutex);
+            discardFrames(*state, released);
+        }
+        impl_->layout.erase(impl_->layout.begin() + static_cast<std::ptrdiff_t>(viewportIndex));
+        ++impl_->layout_version;
+    }
+    state->delivery_cv.notify_all();
+    impl_->markDirty();
+}
+
+void ViewPortal::setViewportType(size_t viewportIndex, ViewportType type) {
+    if (!impl_) return;
+    if (type == ViewportType::Count)
+        throw std::invalid_argument("ViewPortal: invalid viewport type");
+    std::shared_ptr<ViewportFrameState> state;
+    std::vector<std::shared_ptr<const void>> released;  // dropped after the locks
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        LayoutEntry& e = impl_->layout[viewportIndex];
+        if (e.type == type) return;
+        e.type = type;
+        state = e.frame_state;
+        {
+            // Frames sent for the old type, shown or queued, may not suit the new one
+            std::lock_guard<std::mutex> fs_lock(state->mutex);
+            discardFrames(*state, released);
+        }
+        ++impl_->layout_version;
+    }
+    state->delivery_cv.notify_all();
+    impl_->markDirty();
+}
+
+size_t ViewPortal::numViewports() const {
+    if (!impl_) return 0;
+    std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+    return impl_->layout.size();
+}
+
+void ViewPortal::updateFrameRegion(size_t viewportIndex, int x, int y, int w, int h, const void* data,
+                                   int row_stride) {
+    if (!impl_) return;
+    if (!data || w <= 0 || h <= 0 || x < 0 || y < 0) return;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        if (!isImageViewport(impl_->layout[viewportIndex].type)) return;
+        state = impl_->layout[viewportIndex].frame_state;
+    }
+
+    ViewportFrameState& fs = *state;
+    std::shared_ptr<const void> replaced;  // released after the lock is dropped
+    std::unique_lock<std::mutex> lock(fs.mutex);
+    if (fs.catch_up) return;  // the frame it patches was skipped while the cell was hidden
+    // The region patches the newest frame, which lives in the read slot: in place
+    // when that buffer is ours, else in a copy in the write slot. Either way not
+    // while the display or the stream encoder still reads the slot written.
+    int ri = 0, t = 0;
+    for (;;) {
+        ri = 1 - fs.write_index.load(std::memory_order_relaxed);
+        t = fs.external[ri] ? 1 - ri : ri;
+        if (fs.pins[t] == 0) break;
+        fs.slot_cv.wait(lock);
+    }
+    if (!fs.hasPixels(ri)) return;
+    const int frame_w = fs.width[ri];
+    const int frame_h = fs.height[ri];
+    if (x + w > frame_w || y + h > frame_h) return;
+    const int bpp = bytesPerPixel(fs.format[ri]);
+    const size_t rect_row = static_cast<size_t>(w) * bpp;
+
+    if (t != ri) {
+        // Bring the write buffer up to the external frame before patching it: it
+        // is copied once, the patched frame is owned
+        PooledBuffer& dst = fs.buffers[t];
+        const size_t cur_span = fs.span(ri);
+        const bool same_layout = !fs.external[t] && !fs.released[t] && dst.size() == cur_span &&
+                                 fs.stride[t] == fs.stride[ri] && fs.width[t] == frame_w && fs.height[t] == frame_h;
+        if (fs.stale_full[t] || !same_layout) {
+            resizeSlot(fs, t, cur_span);
+            std::memcpy(dst.data(), fs.lowest(ri), cur_span);
+        } else {
+            const std::ptrdiff_t step = fs.rowStep(ri);
+            const std::uint8_t* cur_top = fs.topRow(ri);
+            std::uint8_t* dst_top = fs.ownedTopRow(t);
+            for (const DirtyRect& r : fs.stale[t]) {
+                const std::ptrdiff_t off = static_cast<std::ptrdiff_t>(r.x) * bpp;
+                const size_t len = static_cast<size_t>(r.w) * bpp;
+                for (int row = r.y; row < r.y + r.h; ++row)
+                    std::memcpy(dst_top + row * step + off, cur_top + row * step + off, len);
+            }
+        }
+        fs.width[t] = frame_w;
+        fs.height[t] = frame_h;
+        fs.format[t] = fs.format[ri];
+        fs.stride[t] = fs.stride[ri];
+        replaced = std::move(fs.external[t]);
+        fs.released[t] = false;
+        fs.stale_full[t] = false;
+        fs.stale[t].clear();
+    }
+
+    const std::uint8_t* src = static_cast<const std::uint8_t*>(data);
+    const std::ptrdiff_t src_stride = row_stride != 0 ? row_stride : static_cast<std::ptrdiff_t>(rect_row);
+    const std::ptrdiff_t step = fs.rowStep(t);
+    std::uint8_t* dst_top = fs.ownedTopRow(t);
+    for (int row = 0; row < h; ++row)
+        std::memcpy(dst_top + (y + row) * step + static_cast<std::ptrdiff_t>(x) * bpp, src + row * src_stride, rect_row);
+
+    // The other slot now misses the rectangle
+    const int other = 1 - t;
+    const DirtyRect rect{x, y, w, h};
+    if (!fs.stale_full[other]) {
+        if (fs.stale[other].size() >= kMaxStaleRects) {
+            fs.stale_full[other] = true;
+            fs.stale[other].clear();
+        } else {
+            fs.stale[other].push_back(rect);
+        }
+    }
+    if (!fs.pending_full)
+        unionRect(fs.pending_dirty, rect);
+    fs.published_ns = steadyNowNs();
+    fs.write_index.store(other, std::memory_order_release);
+    fs.frame_seq.fetch_add(1, std::memory_order_release);
+    impl_->markDirty();
+}
+
+void ViewPortal::updateOverlay(size_t viewportIndex, const Overlay& overlay) {
+    updateOverlay(viewportIndex, Overlay(overlay));
+}
+
+void ViewPortal::updateOverlay(size_t viewportIndex, Overlay&& overlay) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        if (!isImageViewport(impl_->layout[viewportIndex].type)) return;
+        state = impl_->layout[viewportIndex].frame_state;
+    }
+    auto shared = std::make_shared<const Overlay>(std::move(overlay));
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->overlay = std::move(shared);
+        ++state->overlay_seq;
+    }
+    impl_->markDirty();
+}
+
+void ViewPortal::updateMask(size_t viewportIndex, const MaskData& mask) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        if (!isImageViewport(impl_->layout[viewportIndex].type)) return;
+        state = impl_->layout[viewportIndex].frame_state;
+    }
+
+    std::shared_ptr<MaskFrame> buf;
+    if (mask.data && mask.width > 0 && mask.height > 0) {
+        const size_t bpp = mask.format == MaskFormat::Label16 ? 2 : 1;
+        const size_t row_bytes = static_cast<size_t>(mask.width) * bpp;
+        const std::ptrdiff_t stride = mask.row_stride != 0 ? mask.row_stride : static_cast<std::ptrdiff_t>(row_bytes);
+        if (static_cast<size_t>(stride < 0 ? -stride : stride) < row_bytes) return;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            buf = std::move(state->mask_spare);
+        }
+        if (!buf)
+            buf = std::make_shared<MaskFrame>();
+        buf->width = mask.width;
+        buf->height = mask.height;
+        buf->format = mask.format;
+        buf->data.resize(row_bytes * static_cast<size_t>(mask.height));
+        const std::uint8_t* src = static_cast<const std::uint8_t*>(mask.data);
+        if (stride == static_cast<std::ptrdiff_t>(row_bytes)) {
+            std::memcpy(buf->data.data(), src, buf->data.size());
+        } else {
+            for (int y = 0; y < mask.height; ++y)
+                std::memcpy(buf->data.data() + static_cast<size_t>(y) * row_bytes, src + y * stride, row_bytes);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        // Recycle the previous mask only if the display thread no longer holds it.
+        if (state->mask && state->mask.use_count() == 1)
+            state->mask_spare = std::move(state->mask);
+        state->mask = std::move(buf);
+        ++state->mask_seq;
+    }
+    impl_->markDirty();
+}
+
+void ViewPortal::setMaskPalette(size_t viewportIndex, const MaskPalette& palette) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        if (!isImageViewport(impl_->layout[viewportIndex].type)) return;
+        state = impl_->layout[viewportIndex].frame_state;
+    }
+    auto shared = std::make_shared<const MaskPalette>(palette);
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->mask_palette = std::move(shared);
+        ++state->mask_seq;
+    }
+    impl_->markDirty();
+}
+
+void ViewPortal::setColormap(size_t viewportIndex, const ColormapParams& params) {
+    if (!impl_) return;
+    std::shared_ptr<ViewportFrameState> state;
+    {
+        std::lock_guard<std::mutex> lock(impl_->layout_mutex);
+        if (viewportIndex >= impl_->layout.size()) return;
+        if (impl_->layout[viewportIndex].type != ViewportType::ColoredDepth) return;
+        state = impl_->layout[viewportIndex].frame_state;
+    }
+    auto shared = std::make_shared<const ColormapParams>(params);
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->colormap = std::move(shared);
+        ++state->colormap_seq;
+    }
+    impl_->markDirty();
 }
 
 } // namespace viewportal
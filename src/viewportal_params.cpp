@@ -6,6 +6,8 @@ namespace viewportal {
 
 namespace {
 
+constexpr size_t kMaxViewportSpecs = 4096;  // bounds "viewport.N" keys
+
 std::string trim(const std::string& s) {
     auto start = s.find_first_not_of(" \t\r\n");
     if (start == std::string::npos) return "";
@@ -36,6 +38,81 @@ bool parseInteger(const std::string& s, T& out) {
     }
 }
 
+bool parseFloat(const std::string& s, float& out) {
+    try {
+        size_t pos = 0;
+        float val = std::stof(s, &pos);
+        if (pos != s.size()) return false;
+        out = val;
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+bool parseBool(const std::string& s, bool& out) {
+    if (s == "1" || s == "true" || s == "on") {
+        out = true;
+        return true;
+    }
+    if (s == "0" || s == "false" || s == "off") {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Parse a viewport spec: whitespace-separated WIDTHxHEIGHT, a format (rgb8,
+ * rgba8, g8, float32, float16, float32x2), a colormap (jet, turbo, viridis,
+ * gray), auto (colormap auto-range) and an aspect (W:H or a number), each
+ * optional and in any order.
+ */
+bool parseViewportSpec(const std::string& s, ViewportSpec& out) {
+    ViewportSpec spec;
+    std::istringstream tokens(s);
+    std::string t;
+    while (tokens >> t) {
+        const size_t x = t.find('x');
+        const size_t colon = t.find(':');
+        if (t == "rgb8") {
+            spec.format = ImageFormat::RGB8;
+        } else if (t == "rgba8") {
+            spec.format = ImageFormat::RGBA8;
+        } else if (t == "g8" || t == "luminance8") {
+            spec.format = ImageFormat::Luminance8;
+        } else if (t == "float32") {
+            spec.format = ImageFormat::Float32;
+        } else if (t == "float16") {
+            spec.format = ImageFormat::Float16;
+        } else if (t == "float32x2") {
+            spec.format = ImageFormat::Float32x2;
+        } else if (t == "jet" || t == "turbo" || t == "viridis" || t == "gray") {
+            ColormapParams colormap = spec.colormap ? *spec.colormap : ColormapParams();
+            colormap.colormap = t == "jet" ? Colormap::Jet : t == "turbo" ? Colormap::Turbo
+                              : t == "viridis" ? Colormap::Viridis : Colormap::Gray;
+            spec.colormap = colormap;
+        } else if (t == "auto") {
+            ColormapParams colormap = spec.colormap ? *spec.colormap : ColormapParams();
+            colormap.auto_range = true;
+            spec.colormap = colormap;
+        } else if (x != std::string::npos) {
+            if (!parseInteger(t.substr(0, x), spec.width) || !parseInteger(t.substr(x + 1), spec.height) ||
+                spec.width <= 0 || spec.height <= 0)
+                return false;
+        } else if (colon != std::string::npos) {
+            float w = 0.0f, h = 0.0f;
+            if (!parseFloat(t.substr(0, colon), w) || !parseFloat(t.substr(colon + 1), h) || w <= 0.0f || h <= 0.0f)
+                return false;
+            spec.aspect = w / h;
+        } else if (!parseFloat(t, spec.aspect) || spec.aspect <= 0.0f) {
+            return false;
+        }
+    }
+    out = spec;
+    return true;
+}
+
 } // namespace
 
 LoadedParams loadParams(const std::string& path) {
@@ -58,6 +135,32 @@ LoadedParams loadParams(const std::string& path) {
             parseInteger(value, result.viewportal.window_height);
         } else if (key == "panel_width") {
             parseInteger(value, result.viewportal.panel_width);
+        } else if (key == "gallery_mode") {
+            parseBool(value, result.viewportal.gallery_mode);
+        } else if (key == "gallery_tile_width") {
+            parseInteger(value, result.viewportal.gallery_tile_width);
+        } else if (key == "gallery_tile_height") {
+            parseInteger(value, result.viewportal.gallery_tile_height);
+        } else if (key == "frame_memory_budget_mb") {
+            parseInteger(value, result.viewportal.frame_memory_budget_mb);
+        } else if (key == "sync_timestamps") {
+            parseBool(value, result.viewportal.sync_timestamps);
+        } else if (key == "sync_queue_depth") {
+            parseInteger(value, result.viewportal.sync_queue_depth);
+        } else if (key == "sync_timeout_ms") {
+            parseInteger(value, result.viewportal.sync_timeout_ms);
+        } else if (key == "headless") {
+            parseBool(value, result.viewportal.headless);
+        } else if (key == "prepare_threads") {
+            parseInteger(value, result.viewportal.prepare_threads);
+        } else if (key.compare(0, 9, "viewport.") == 0) {
+            size_t index = 0;
+            ViewportSpec spec;
+            if (parseInteger(key.substr(9), index) && index < kMaxViewportSpecs && parseViewportSpec(value, spec)) {
+                std::vector<ViewportSpec>& specs = result.viewportal.viewport_specs;
+                if (specs.size() <= index) specs.resize(index + 1);
+                specs[index] = spec;
+            }
         }
     }
 
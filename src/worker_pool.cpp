@@ -0,0 +1,101 @@
+#include "worker_pool.h"
+#include "thread_name.h"
+
+namespace viewportal {
+
+WorkerPool::WorkerPool(int threads, const char* thread_name) : thread_name_(thread_name) {
+    const size_t n = threads > 0 ? static_cast<size_t>(threads) : 0;
+    for (size_t i = 0; i <= n; ++i)
+        queues_.push_back(std::make_unique<Queue>());
+    for (size_t i = 1; i <= n; ++i)
+        threads_.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : threads_)
+        t.join();
+}
+
+void WorkerPool::run(const std::vector<std::function<void()>>& tasks) {
+    if (tasks.empty()) return;
+    if (threads_.empty() || tasks.size() == 1) {
+        for (const std::function<void()>& task : tasks)
+            task();
+        return;
+    }
+    remaining_.store(tasks.size(), std::memory_order_relaxed);
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        Queue& q = *queues_[i % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(&tasks[i]);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++batch_;
+    }
+    wake_.notify_all();
+    while (runOne(0)) {
+    }
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return remaining_.load(std::memory_order_acquire) == 0; });
+        error = error_;
+        error_ = nullptr;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void WorkerPool::workerLoop(size_t self) {
+    setThreadName(thread_name_);
+    std::uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&]() { return stop_ || batch_ != seen; });
+            if (stop_) return;
+            seen = batch_;
+        }
+        while (runOne(self)) {
+        }
+    }
+}
+
+bool WorkerPool::runOne(size_t self) {
+    Task task = nullptr;
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+        }
+    }
+    for (size_t k = 1; !task && k < queues_.size(); ++k) {
+        Queue& victim = *queues_[(self + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+        }
+    }
+    if (!task) return false;
+    try {
+        (*task)();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_) error_ = std::current_exception();
+    }
+    if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_.notify_all();
+    }
+    return true;
+}
+
+} // namespace viewportal
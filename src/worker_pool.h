@@ -0,0 +1,72 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace viewportal {
+
+/**
+ * Small work-stealing pool for batches of short CPU tasks. run() deals the
+ * tasks out to one deque per thread, the calling thread included; each thread
+ * takes from the front of its own deque and, once that is empty, steals from
+ * the back of the others, so one slow task does not leave the rest waiting.
+ * run() returns when every task of the batch is done. Batches come from one
+ * thread at a time.
+ */
+class WorkerPool {
+public:
+    /**
+     * \param threads Workers besides the thread calling run(); may be 0.
+     * \param thread_name Name of the workers (see setThreadName()); must outlive the pool.
+     */
+    WorkerPool(int threads, const char* thread_name);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * Run all tasks, in parallel with the calling thread's help. Rethrows the
+     * first exception a task threw, after the whole batch finished.
+     */
+    void run(const std::vector<std::function<void()>>& tasks);
+
+    int threads() const { return static_cast<int>(threads_.size()); }
+
+private:
+    using Task = const std::function<void()>*;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(size_t self);
+
+    /** Run one task from queue self, or stolen from another. \return false if none was left. */
+    bool runOne(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues_;  // [0] belongs to the caller of run()
+    std::atomic<size_t> remaining_{0};            // tasks of the batch not finished yet
+    std::mutex mutex_;
+    std::condition_variable wake_;  // a batch was dealt out, or stop
+    std::condition_variable done_;  // the batch finished
+    std::uint64_t batch_ = 0;
+    bool stop_ = false;
+    std::exception_ptr error_;  // guarded by mutex_
+    const char* thread_name_;
+    std::vector<std::thread> threads_;
+};
+
+} // namespace viewportal
+
+#endif // WORKER_POOL_H